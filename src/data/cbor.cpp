@@ -0,0 +1,509 @@
+#include "data/cbor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+double halfToDouble(uint16_t half) {
+  int exponent = (half >> 10) & 0x1f;
+  int mantissa = half & 0x3ff;
+  double value;
+  if (exponent == 0) {
+    value = std::ldexp(mantissa, -24);
+  } else if (exponent != 31) {
+    value = std::ldexp(mantissa + 1024, exponent - 25);
+  } else {
+    value = mantissa == 0 ? INFINITY : NAN;
+  }
+  return (half & 0x8000) ? -value : value;
+}
+
+void appendEscaped(std::string& out, const uint8_t* data, size_t length) {
+  static const char hex[] = "0123456789abcdef";
+  for (size_t i = 0; i < length; ++i) {
+    unsigned char c = data[i];
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if (c < 0x20) {
+          out += "\\u00";
+          out += hex[c >> 4];
+          out += hex[c & 0xf];
+        } else {
+          out += static_cast<char>(c);
+        }
+    }
+  }
+}
+
+// string content up to max_length bytes, cut on a UTF-8 character boundary
+void appendString(std::string& out, const CborReader& reader, const CborItem& item, size_t max_length) {
+  static const char hex[] = "0123456789abcdef";
+  bool text = item.m_type == CborItem::Type::Text;
+  out += text ? "\"" : "h'";
+
+  size_t budget = max_length;
+  bool cut = false;
+  auto append = [&](size_t offset, size_t length) {
+    if (length > budget) {
+      length = budget;
+      cut = true;
+      while (text && length > 0 && (reader.data()[offset + length] & 0xc0) == 0x80) {
+        --length;
+      }
+    }
+    if (text) {
+      appendEscaped(out, reader.data() + offset, length);
+    } else {
+      for (size_t i = 0; i < length; ++i) {
+        out += hex[reader.data()[offset + i] >> 4];
+        out += hex[reader.data()[offset + i] & 0xf];
+      }
+    }
+    budget -= length;
+  };
+
+  if (!item.m_indefinite) {
+    append(item.m_data, item.m_value);
+  } else {
+    // chunks of definite strings up to the break
+    CborItem chunk;
+    size_t offset = item.m_data;
+    while (!cut && reader.head(offset, chunk) && chunk.m_type == item.m_type && !chunk.m_indefinite) {
+      append(chunk.m_data, chunk.m_value);
+      offset = chunk.m_data + chunk.m_value;
+    }
+  }
+
+  if (cut) {
+    out += "...";
+  }
+  out += text ? "\"" : "'";
+}
+
+struct JsonWriter {
+  const CborReader& m_reader;
+  std::string& m_out;
+
+  void indent(int depth) {
+    m_out += '\n';
+    m_out.append(depth * 2, ' ');
+  }
+
+  // offset past the written item, 0 on malformed input
+  size_t write(size_t offset, int depth) {
+    CborItem item;
+    if (depth > 512 || !m_reader.content(offset, item)) {
+      return 0;
+    }
+
+    bool map = item.m_type == CborItem::Type::Map;
+    if (!map && item.m_type != CborItem::Type::Array) {
+      appendCborScalar(m_out, m_reader, item, ~size_t(0));
+      size_t end;
+      return m_reader.skip(offset, end) ? end : 0;
+    }
+
+    m_out += map ? '{' : '[';
+    size_t pos = item.m_data;
+    uint64_t i = 0;
+    for (; item.m_indefinite || i < item.m_value; ++i) {
+      CborItem next;
+      if (item.m_indefinite && m_reader.head(pos, next) && next.m_type == CborItem::Type::Break) {
+        pos = next.m_data;
+        break;
+      }
+      if (i > 0) {
+        m_out += ',';
+      }
+      indent(depth + 1);
+      if (map) {
+        if ((pos = write(pos, depth + 1)) == 0) {
+          return 0;
+        }
+        m_out += ": ";
+      }
+      if ((pos = write(pos, depth + 1)) == 0) {
+        return 0;
+      }
+    }
+    if (i > 0) {
+      indent(depth);
+    }
+    m_out += map ? '}' : ']';
+    return pos;
+  }
+};
+}  // namespace
+
+bool CborReader::head(size_t offset, CborItem& item) const {
+  if (offset >= m_size) {
+    return false;
+  }
+
+  uint8_t initial = m_data[offset];
+  uint8_t major = initial >> 5;
+  uint8_t info = initial & 0x1f;
+  size_t pos = offset + 1;
+  uint64_t value = info;
+  item.m_indefinite = false;
+
+  if (info >= 24 && info <= 27) {
+    size_t length = size_t(1) << (info - 24);
+    if (m_size - pos < length) {
+      return false;
+    }
+    value = 0;
+    for (size_t i = 0; i < length; ++i) {
+      value = (value << 8) | m_data[pos + i];
+    }
+    pos += length;
+  } else if (info == 31) {
+    if (major == 7) {
+      item.m_type = CborItem::Type::Break;
+      item.m_data = pos;
+      return true;
+    }
+    if (major < 2 || major == 6) {
+      return false;
+    }
+    item.m_indefinite = true;
+  } else if (info > 27) {
+    return false;
+  }
+
+  item.m_value = value;
+  item.m_data = pos;
+  size_t remaining = m_size - pos;
+  switch (major) {
+    case 0:
+      item.m_type = CborItem::Type::Unsigned;
+      return true;
+    case 1:
+      item.m_type = CborItem::Type::Negative;
+      return true;
+    case 2:
+    case 3:
+      item.m_type = major == 2 ? CborItem::Type::Bytes : CborItem::Type::Text;
+      return item.m_indefinite || value <= remaining;
+    case 4:
+      // every element takes at least a byte, which bounds the counts of
+      // well formed containers
+      item.m_type = CborItem::Type::Array;
+      return item.m_indefinite || value <= remaining;
+    case 5:
+      item.m_type = CborItem::Type::Map;
+      return item.m_indefinite || value <= remaining / 2;
+    case 6:
+      item.m_type = CborItem::Type::Tag;
+      return true;
+    default:
+      break;
+  }
+
+  if (info == 25) {
+    item.m_type = CborItem::Type::Float;
+    item.m_float = halfToDouble(static_cast<uint16_t>(value));
+  } else if (info == 26) {
+    uint32_t bits = static_cast<uint32_t>(value);
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    item.m_type = CborItem::Type::Float;
+    item.m_float = f;
+  } else if (info == 27) {
+    item.m_type = CborItem::Type::Float;
+    memcpy(&item.m_float, &value, sizeof(item.m_float));
+  } else {
+    item.m_type = CborItem::Type::Simple;
+  }
+  return true;
+}
+
+bool CborReader::content(size_t offset, CborItem& item, std::string* tags) const {
+  while (head(offset, item)) {
+    if (item.m_type != CborItem::Type::Tag) {
+      return true;
+    }
+    if (tags) {
+      *tags += std::to_string(item.m_value) + "(";
+    }
+    offset = item.m_data;
+  }
+  return false;
+}
+
+bool CborReader::skip(size_t offset, size_t& end, int depth) const {
+  if (depth > kMaxDepth) {
+    return false;
+  }
+
+  // Definite containers just add their elements to the items still to be
+  // read, so only indefinite ones recurse.
+  uint64_t pending = 1;
+  while (pending > 0) {
+    CborItem item;
+    if (!head(offset, item)) {
+      return false;
+    }
+    --pending;
+    offset = item.m_data;
+    switch (item.m_type) {
+      case CborItem::Type::Bytes:
+      case CborItem::Type::Text:
+        if (item.m_indefinite) {
+          if (!skipUntilBreak(offset, offset, depth + 1)) {
+            return false;
+          }
+        } else {
+          offset += item.m_value;
+        }
+        break;
+      case CborItem::Type::Array:
+      case CborItem::Type::Map:
+        if (item.m_indefinite) {
+          if (!skipUntilBreak(offset, offset, depth + 1)) {
+            return false;
+          }
+        } else {
+          pending += item.m_type == CborItem::Type::Map ? item.m_value * 2 : item.m_value;
+          if (pending > m_size - offset) {
+            return false;
+          }
+        }
+        break;
+      case CborItem::Type::Tag:
+        ++pending;
+        break;
+      case CborItem::Type::Break:
+        return false;
+      default:
+        break;
+    }
+  }
+  end = offset;
+  return true;
+}
+
+bool CborReader::skipUntilBreak(size_t offset, size_t& end, int depth) const {
+  CborItem item;
+  while (head(offset, item)) {
+    if (item.m_type == CborItem::Type::Break) {
+      end = item.m_data;
+      return true;
+    }
+    if (!skip(offset, offset, depth)) {
+      return false;
+    }
+  }
+  return false;
+}
+
+void appendCborScalar(std::string& out, const CborReader& reader, const CborItem& item, size_t max_length) {
+  switch (item.m_type) {
+    case CborItem::Type::Unsigned:
+      out += std::to_string(item.m_value);
+      break;
+    case CborItem::Type::Negative:
+      out += '-';
+      out += item.m_value == ~uint64_t(0) ? "18446744073709551616" : std::to_string(item.m_value + 1);
+      break;
+    case CborItem::Type::Bytes:
+    case CborItem::Type::Text:
+      appendString(out, reader, item, max_length);
+      break;
+    case CborItem::Type::Float:
+      appendJsonNumber(out, item.m_float);
+      break;
+    case CborItem::Type::Simple:
+      switch (item.m_value) {
+        case 20:
+          out += "false";
+          break;
+        case 21:
+          out += "true";
+          break;
+        case 22:
+          out += "null";
+          break;
+        case 23:
+          out += "undefined";
+          break;
+        default:
+          out += "simple(" + std::to_string(item.m_value) + ")";
+      }
+      break;
+    case CborItem::Type::Array:
+      out += "[...]";
+      break;
+    case CborItem::Type::Map:
+      out += "{...}";
+      break;
+    case CborItem::Type::Tag:
+    case CborItem::Type::Break:
+      break;
+  }
+}
+
+void appendJsonNumber(std::string& out, double value) {
+  if (!isFiniteDouble(value)) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if (bits & 0x000fffffffffffffull) {
+      out += "NaN";
+    } else {
+      out += bits >> 63 ? "-Infinity" : "Infinity";
+    }
+    return;
+  }
+  // the shortest of the two precisions which reads back the same value
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.15g", value);
+  if (strtod(buf, nullptr) != value) {
+    snprintf(buf, sizeof(buf), "%.17g", value);
+  }
+  out += buf;
+}
+
+void appendJsonString(std::string& out, const uint8_t* data, size_t length, size_t max_length) {
+  bool cut = length > max_length;
+  if (cut) {
+    length = max_length;
+    while (length > 0 && (data[length] & 0xc0) == 0x80) {
+      --length;
+    }
+  }
+  out += '"';
+  appendEscaped(out, data, length);
+  out += cut ? "...\"" : "\"";
+}
+
+bool cborToJson(const uint8_t* data, size_t size, std::string& out) {
+  CborReader reader(data, size);
+  size_t end;
+  if (!reader.skip(0, end) || end != size) {
+    return false;
+  }
+  JsonWriter writer{reader, out};
+  return writer.write(0, 0) == size;
+}
+
+bool CborTree::reset(const uint8_t* data, size_t size) {
+  clear();
+  m_reader = CborReader(data, size);
+  size_t end;
+  if (size == 0 || size > kNone || !m_reader.skip(0, end) || end != size) {
+    return false;
+  }
+
+  Node root;
+  root.m_value = 0;
+  CborItem item;
+  m_reader.content(0, item);
+  root.m_container = item.m_type == CborItem::Type::Array || item.m_type == CborItem::Type::Map;
+  root.m_children = root.m_container && !item.m_indefinite ? static_cast<uint32_t>(item.m_value) : 0;
+  root.m_expanded = true;
+  m_nodes.push_back(root);
+  return true;
+}
+
+void CborTree::clear() {
+  m_nodes.clear();
+  m_reader = CborReader();
+}
+
+uint32_t CborTree::children(uint32_t index) {
+  if (m_nodes[index].m_indexed || !m_nodes[index].m_container) {
+    return m_nodes[index].m_first_child;
+  }
+
+  // reset() checked the whole document, so the walk below can't fail
+  CborItem item;
+  m_reader.content(m_nodes[index].m_value, item);
+  bool map = item.m_type == CborItem::Type::Map;
+  uint32_t first = static_cast<uint32_t>(m_nodes.size());
+  size_t pos = item.m_data;
+  for (uint64_t i = 0; item.m_indefinite || i < item.m_value; ++i) {
+    CborItem next;
+    m_reader.head(pos, next);
+    if (next.m_type == CborItem::Type::Break) {
+      break;
+    }
+
+    Node child;
+    child.m_parent = index;
+    if (map) {
+      child.m_key = static_cast<uint32_t>(pos);
+      m_reader.skip(pos, pos);
+    }
+    child.m_value = static_cast<uint32_t>(pos);
+    m_reader.content(pos, next);
+    child.m_container = next.m_type == CborItem::Type::Array || next.m_type == CborItem::Type::Map;
+    child.m_children = child.m_container && !next.m_indefinite ? static_cast<uint32_t>(next.m_value) : 0;
+    m_reader.skip(pos, pos);
+    m_nodes.push_back(child);
+  }
+
+  Node& node = m_nodes[index];
+  node.m_first_child = first;
+  node.m_children = static_cast<uint32_t>(m_nodes.size() - first);
+  node.m_indexed = true;
+  return first;
+}
+
+bool CborTree::scalarSpan(uint32_t index, size_t& begin, size_t& end) const {
+  const Node& node = m_nodes[index];
+  if (node.m_container) {
+    return false;
+  }
+  begin = node.m_value;
+  return m_reader.skip(node.m_value, end);
+}
+
+std::string CborTree::label(uint32_t index, size_t max_length) const {
+  const Node& node = m_nodes[index];
+  std::string out;
+  CborItem item;
+  if (node.m_key != kNone) {
+    std::string tags;
+    m_reader.content(node.m_key, item, &tags);
+    out += tags;
+    appendCborScalar(out, m_reader, item, max_length);
+    out.append(std::count(tags.begin(), tags.end(), '('), ')');
+    out += ": ";
+  }
+
+  std::string tags;
+  m_reader.content(node.m_value, item, &tags);
+  out += tags;
+  if (!node.m_container) {
+    appendCborScalar(out, m_reader, item, max_length);
+  } else {
+    bool map = item.m_type == CborItem::Type::Map;
+    out += map ? "{" : "[";
+    if (node.m_indexed || !item.m_indefinite) {
+      out += std::to_string(node.m_children) + (map ? " key" : " item") + (node.m_children == 1 ? "" : "s");
+    } else {
+      out += "...";
+    }
+    out += map ? "}" : "]";
+  }
+  out.append(std::count(tags.begin(), tags.end(), '('), ')');
+  return out;
+}
@@ -0,0 +1,136 @@
+#ifndef DMON_CBOR_H
+#define DMON_CBOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Head of a CBOR (RFC 8949) data item.
+struct CborItem {
+  enum class Type : uint8_t {
+    Unsigned,
+    Negative,
+    Bytes,
+    Text,
+    Array,
+    Map,
+    Tag,
+    Simple,
+    Float,
+    Break
+  };
+
+  Type m_type{Type::Simple};
+  bool m_indefinite{false};
+  // integer, string length, element or pair count, tag number or simple
+  // value depending on the type; a negative integer is -1 - m_value
+  uint64_t m_value{0};
+  double m_float{0.0};
+  // offset right after the head: the string content or the first element
+  size_t m_data{0};
+};
+
+// Tokenizes CBOR in place without allocating. Lengths and counts are checked
+// against the remaining bytes, so a malformed or truncated payload fails
+// instead of reading past the end.
+class CborReader {
+ public:
+  CborReader() = default;
+  CborReader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+  const uint8_t* data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+  // reads the head of the item at offset
+  bool head(size_t offset, CborItem& item) const;
+  // like head() but steps over tags, their numbers are appended to tags
+  bool content(size_t offset, CborItem& item, std::string* tags = nullptr) const;
+  // end of the item at offset including its tags and nested items
+  bool skip(size_t offset, size_t& end) const { return skip(offset, end, 0); }
+
+ private:
+  static constexpr int kMaxDepth = 512;
+
+  bool skip(size_t offset, size_t& end, int depth) const;
+  bool skipUntilBreak(size_t offset, size_t& end, int depth) const;
+
+  const uint8_t* m_data{nullptr};
+  size_t m_size{0};
+};
+
+// Appends a scalar item as JSON, strings longer than max_length are cut.
+// Byte strings, undefined and other simple values use the CBOR diagnostic
+// notation since JSON has nothing for them.
+void appendCborScalar(std::string& out, const CborReader& reader, const CborItem& item, size_t max_length);
+
+// False for infinities and NaN. Tested on the exponent bits since release
+// builds use -Ofast, whose -ffinite-math-only folds std::isfinite and
+// std::isnan to constants.
+inline bool isFiniteDouble(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return (bits & 0x7ff0000000000000ull) != 0x7ff0000000000000ull;
+}
+
+// Appends a number the way JSON prints it, NaN and infinities the way the
+// CBOR diagnostic notation does.
+void appendJsonNumber(std::string& out, double value);
+
+// Appends a quoted and escaped JSON string, cut after max_length bytes on a
+// UTF-8 character boundary.
+void appendJsonString(std::string& out, const uint8_t* data, size_t length, size_t max_length);
+
+// The whole document as indented JSON; false when it is not a single well
+// formed item.
+bool cborToJson(const uint8_t* data, size_t size, std::string& out);
+
+// Lazily indexed tree of a single CBOR item. Creating it only checks that
+// the payload is well formed; the children of a container are indexed the
+// first time they are asked for, so a large document costs as much as the
+// part of it that was expanded.
+class CborTree {
+ public:
+  static constexpr uint32_t kRoot = 0;
+  static constexpr uint32_t kNone = ~uint32_t(0);
+
+  struct Node {
+    // offset of the map key, kNone for array elements and the root
+    uint32_t m_key{kNone};
+    // offset of the value, tags included
+    uint32_t m_value{0};
+    uint32_t m_parent{kNone};
+    // children are contiguous once indexed
+    uint32_t m_first_child{kNone};
+    uint32_t m_children{0};
+    bool m_container{false};
+    bool m_indexed{false};
+    bool m_expanded{false};
+  };
+
+  // false and an empty tree unless data holds exactly one well formed item;
+  // data has to stay valid while the tree is used
+  bool reset(const uint8_t* data, size_t size);
+  void clear();
+
+  bool empty() const { return m_nodes.empty(); }
+  const Node& node(uint32_t index) const { return m_nodes[index]; }
+  size_t size() const { return m_nodes.size(); }
+
+  // index of the first child, indexing them on first use; containers only
+  uint32_t children(uint32_t index);
+  void setExpanded(uint32_t index, bool expanded) { m_nodes[index].m_expanded = expanded; }
+
+  // "key: value" for display, containers show their size instead of content
+  std::string label(uint32_t index, size_t max_length) const;
+  // bytes of a scalar value, tags included; false for containers, whose end
+  // is only known after walking their content
+  bool scalarSpan(uint32_t index, size_t& begin, size_t& end) const;
+
+ private:
+  CborReader m_reader;
+  std::vector<Node> m_nodes;
+};
+
+#endif //DMON_CBOR_H
@@ -0,0 +1,80 @@
+#include "data/delta.h"
+
+#include <algorithm>
+
+#include "data/session.h"
+#include "types/topic_types.h"
+
+void DeltaDecoder::split(const char* data, size_t size, std::vector<Span>& fields, std::vector<uint32_t>& records) {
+  fields.clear();
+  records.clear();
+  records.push_back(0);
+  uint32_t begin = 0;
+  for (uint32_t i = 0; i < size; ++i) {
+    if (data[i] == DPT_FIELD_DELIM || data[i] == DPT_RECORD_DELIM) {
+      fields.push_back(Span{begin, i});
+      begin = i + 1;
+      if (data[i] == DPT_RECORD_DELIM) {
+        records.push_back(static_cast<uint32_t>(fields.size()));
+      }
+    }
+  }
+  fields.push_back(Span{begin, static_cast<uint32_t>(size)});
+  records.push_back(static_cast<uint32_t>(fields.size()));
+}
+
+void DeltaDecoder::apply(const std::vector<char>& base, const std::vector<char>& delta, std::vector<char>& out) {
+  split(base.data(), base.size(), m_base_fields, m_base_records);
+  split(delta.data(), delta.size(), m_delta_fields, m_delta_records);
+
+  size_t base_records = m_base_records.size() - 1;
+  size_t delta_records = m_delta_records.size() - 1;
+  out.clear();
+  out.reserve(std::max(base.size(), delta.size()));
+  for (size_t r = 0; r < std::max(base_records, delta_records); ++r) {
+    size_t base_fields = r < base_records ? m_base_records[r + 1] - m_base_records[r] : 0;
+    size_t delta_fields = r < delta_records ? m_delta_records[r + 1] - m_delta_records[r] : 0;
+    if (r > 0) {
+      out.push_back(DPT_RECORD_DELIM);
+    }
+    for (size_t f = 0; f < std::max(base_fields, delta_fields); ++f) {
+      if (f > 0) {
+        out.push_back(DPT_FIELD_DELIM);
+      }
+      if (f < delta_fields) {
+        const Span& d = m_delta_fields[m_delta_records[r] + f];
+        if (d.m_end - d.m_begin == 1 && delta[d.m_begin] == kEmptyField) {
+          continue;
+        }
+        if (d.m_end > d.m_begin) {
+          out.insert(out.end(), delta.begin() + d.m_begin, delta.begin() + d.m_end);
+          continue;
+        }
+      }
+      if (f < base_fields) {
+        const Span& b = m_base_fields[m_base_records[r] + f];
+        out.insert(out.end(), base.begin() + b.m_begin, base.begin() + b.m_end);
+      }
+    }
+  }
+}
+
+bool DeltaDecoder::decode(Topic& topic) {
+  if (topic.m_topic_type != "DELTA") {
+    // assign reuses the stored buffer
+    m_values[topic.m_path].assign(topic.m_buffer.begin(), topic.m_buffer.end());
+    return true;
+  }
+
+  auto it = m_values.find(topic.m_path);
+  if (it == m_values.end()) {
+    m_failed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  apply(it->second, topic.m_buffer, m_scratch);
+  // the old value's buffer becomes the scratch space of the next delta
+  it->second.swap(m_scratch);
+  topic.m_buffer.assign(it->second.begin(), it->second.end());
+  m_applied.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
@@ -0,0 +1,55 @@
+#ifndef DMON_DELTA_H
+#define DMON_DELTA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Topic;
+
+// Keeps the current value of every topic and turns DELTA messages back into
+// full values. A DPT delta has the record and field layout of the value: a
+// field with content replaces the one at its position, an empty field leaves
+// it unchanged and a field holding only kEmptyField clears it; records and
+// fields the delta does not reach stay as they are. Used on the callback
+// thread only, the counters may be read from anywhere.
+class DeltaDecoder {
+ public:
+  // marks a field of a delta which changed to empty
+  static constexpr char kEmptyField = 0x03;
+
+  // Replaces the payload of a DELTA topic with the value it results in and
+  // records the value of a TOPIC_LOAD. false for a delta without a base, the
+  // topic keeps the delta bytes then.
+  bool decode(Topic& topic);
+  void forget(const std::string& path) { m_values.erase(path); }
+
+  uint64_t applied() const { return m_applied.load(std::memory_order_relaxed); }
+  uint64_t failed() const { return m_failed.load(std::memory_order_relaxed); }
+
+ private:
+  struct Span {
+    uint32_t m_begin;
+    uint32_t m_end;
+  };
+
+  // fields of data and the index of the first field of every record, with
+  // one past the last field at the end
+  static void split(const char* data, size_t size, std::vector<Span>& fields, std::vector<uint32_t>& records);
+  void apply(const std::vector<char>& base, const std::vector<char>& delta, std::vector<char>& out);
+
+  std::unordered_map<std::string, std::vector<char>> m_values;
+  // reused for every delta so the steady state does not allocate
+  std::vector<char> m_scratch;
+  std::vector<Span> m_base_fields;
+  std::vector<uint32_t> m_base_records;
+  std::vector<Span> m_delta_fields;
+  std::vector<uint32_t> m_delta_records;
+  std::atomic<uint64_t> m_applied{0};
+  std::atomic<uint64_t> m_failed{0};
+};
+
+#endif //DMON_DELTA_H
@@ -0,0 +1,71 @@
+#include "data/diff.h"
+
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+void add(std::vector<ByteRange>& ranges, size_t begin, size_t end) {
+  if (!ranges.empty() && ranges.back().m_end == begin) {
+    ranges.back().m_end = static_cast<uint32_t>(end);
+  } else {
+    ranges.push_back(ByteRange{static_cast<uint32_t>(begin), static_cast<uint32_t>(end)});
+  }
+}
+
+// adds the runs of set bits of a block's difference mask
+void addMask(std::vector<ByteRange>& ranges, size_t offset, uint64_t mask) {
+  while (mask != 0) {
+    int start = __builtin_ctzll(mask);
+    // the mask is at most 32 bits wide, so the inverse always has a bit set
+    int length = __builtin_ctzll(~(mask >> start));
+    add(ranges, offset + start, offset + start + length);
+    mask &= ~(((uint64_t(1) << length) - 1) << start);
+  }
+}
+}  // namespace
+
+void diffBytes(const uint8_t* before, size_t before_size, const uint8_t* after, size_t after_size,
+               std::vector<ByteRange>& ranges) {
+  ranges.clear();
+  size_t common = std::min(before_size, after_size);
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 32 <= common; i += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(before + i));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(after + i));
+    uint32_t equal = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+    if (equal != 0xffffffffu) {
+      addMask(ranges, i, ~equal);
+    }
+  }
+#elif defined(__SSE2__)
+  for (; i + 16 <= common; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(before + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(after + i));
+    uint32_t equal = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)));
+    if (equal != 0xffffu) {
+      addMask(ranges, i, ~equal & 0xffffu);
+    }
+  }
+#endif
+  for (; i < common; ++i) {
+    if (before[i] != after[i]) {
+      add(ranges, i, i + 1);
+    }
+  }
+  if (after_size > common) {
+    add(ranges, common, after_size);
+  }
+}
+
+bool overlaps(const std::vector<ByteRange>& ranges, size_t begin, size_t end) {
+  // the first range ending after begin is the only candidate
+  auto it = std::upper_bound(ranges.begin(), ranges.end(), begin,
+                             [](size_t offset, const ByteRange& r) { return offset < r.m_end; });
+  return it != ranges.end() && it->m_begin < end;
+}
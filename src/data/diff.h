@@ -0,0 +1,23 @@
+#ifndef DMON_DIFF_H
+#define DMON_DIFF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct ByteRange {
+  uint32_t m_begin;
+  uint32_t m_end;
+};
+
+// Ranges of after whose bytes differ from before at the same offset, in
+// order and merged when adjacent; bytes past the end of before count as
+// changed. 32 (AVX2) or 16 (SSE2) bytes are compared per step and only
+// blocks with a difference are looked into.
+void diffBytes(const uint8_t* before, size_t before_size, const uint8_t* after, size_t after_size,
+               std::vector<ByteRange>& ranges);
+
+// true when [begin, end) overlaps one of the ranges
+bool overlaps(const std::vector<ByteRange>& ranges, size_t begin, size_t end);
+
+#endif //DMON_DIFF_H
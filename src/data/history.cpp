@@ -0,0 +1,181 @@
+#include "data/history.h"
+
+#include <algorithm>
+
+#include "data/diff.h"
+#include "data/session.h"
+#include "data/varint.h"
+
+namespace {
+// unchanged gaps shorter than this cost more as a new range than as bytes
+constexpr uint32_t kMinGap = 3;
+
+// new size, then (gap, length, after ^ before) per changed range
+void encodeDelta(const std::vector<uint8_t>& before, const uint8_t* after, size_t size, std::vector<ByteRange>& ranges,
+                 std::vector<uint8_t>& out) {
+  diffBytes(before.data(), before.size(), after, size, ranges);
+
+  out.clear();
+  putVarint(out, size);
+  size_t pos = 0;
+  for (size_t i = 0; i < ranges.size();) {
+    uint32_t begin = ranges[i].m_begin;
+    uint32_t end = ranges[i].m_end;
+    for (++i; i < ranges.size() && ranges[i].m_begin - end < kMinGap; ++i) {
+      end = ranges[i].m_end;
+    }
+    putVarint(out, begin - pos);
+    putVarint(out, end - begin);
+    for (uint32_t j = begin; j < end; ++j) {
+      out.push_back(after[j] ^ (j < before.size() ? before[j] : 0));
+    }
+    pos = end;
+  }
+}
+
+void applyDelta(std::vector<uint8_t>& value, const std::vector<uint8_t>& delta) {
+  const uint8_t* p = delta.data();
+  const uint8_t* end = p + delta.size();
+  // bytes past the old end were XORed with zero
+  value.resize(getVarint(p));
+  size_t pos = 0;
+  while (p < end) {
+    pos += getVarint(p);
+    size_t length = getVarint(p);
+    for (size_t j = 0; j < length; ++j) {
+      value[pos + j] ^= *p++;
+    }
+    pos += length;
+  }
+}
+}  // namespace
+
+void HistoryStore::record(const Topic& topic) {
+  if (m_options.m_versions == 0) {
+    return;
+  }
+
+  auto it = m_topics.find(topic.m_path);
+  if (it == m_topics.end()) {
+    it = m_topics.emplace(topic.m_path, History()).first;
+    m_lru.push_front(topic.m_path);
+    it->second.m_lru = m_lru.begin();
+  }
+  History& history = it->second;
+  touch(history);
+
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(topic.m_buffer.data());
+  size_t size = topic.m_buffer.size();
+  Version version;
+  version.m_received = topic.m_received;
+  if (!history.m_versions.empty() && history.m_since_keyframe + 1 < m_options.m_keyframe_interval) {
+    encodeDelta(history.m_last, data, size, m_ranges, m_scratch);
+    // a delta as large as the value is no better than a keyframe
+    version.m_keyframe = m_scratch.size() >= size;
+  } else {
+    version.m_keyframe = true;
+  }
+  if (version.m_keyframe) {
+    version.m_data.assign(data, data + size);
+    history.m_since_keyframe = 0;
+  } else {
+    version.m_data.assign(m_scratch.begin(), m_scratch.end());
+    ++history.m_since_keyframe;
+  }
+
+  size_t last_capacity = history.m_last.capacity();
+  history.m_last.assign(data, data + size);
+  size_t added = cost(version) + history.m_last.capacity() - last_capacity;
+  history.m_memory += added;
+  m_memory += added;
+  history.m_versions.push_back(std::move(version));
+
+  auto too_old = [&](const Version& v) {
+    return m_options.m_seconds > 0 && topic.m_received - v.m_received > std::chrono::seconds(m_options.m_seconds);
+  };
+  while (history.m_versions.size() > m_options.m_versions ||
+         (history.m_versions.size() > 1 && too_old(history.m_versions.front()))) {
+    dropOldest(history);
+  }
+  evict();
+}
+
+void HistoryStore::dropOldest(History& history) {
+  // the next version becomes the keyframe the ones after it start from
+  if (history.m_versions.size() > 1 && !history.m_versions[1].m_keyframe) {
+    Version& next = history.m_versions[1];
+    size_t before = cost(next);
+    std::vector<uint8_t> value = history.m_versions.front().m_data;
+    applyDelta(value, next.m_data);
+    next.m_data = std::move(value);
+    next.m_keyframe = true;
+    history.m_memory += cost(next) - before;
+    m_memory += cost(next) - before;
+  }
+  size_t freed = cost(history.m_versions.front());
+  history.m_memory -= freed;
+  m_memory -= freed;
+  history.m_versions.pop_front();
+  ++history.m_first;
+}
+
+void HistoryStore::touch(History& history) {
+  m_lru.splice(m_lru.begin(), m_lru, history.m_lru);
+}
+
+void HistoryStore::evict() {
+  // the topic just recorded is at the front and is never dropped
+  while (m_memory > m_options.m_budget && m_lru.size() > 1) {
+    auto it = m_topics.find(m_lru.back());
+    m_memory -= it->second.m_memory;
+    m_topics.erase(it);
+    m_lru.pop_back();
+  }
+}
+
+void HistoryStore::clear() {
+  m_topics.clear();
+  m_lru.clear();
+  m_memory = 0;
+}
+
+bool HistoryStore::range(const std::string& path, uint64_t& first, uint64_t& end) const {
+  auto it = m_topics.find(path);
+  if (it == m_topics.end() || it->second.m_versions.empty()) {
+    return false;
+  }
+  first = it->second.m_first;
+  end = first + it->second.m_versions.size();
+  return true;
+}
+
+void HistoryStore::restore(const History& history, size_t index, std::vector<uint8_t>& value) const {
+  size_t keyframe = index;
+  while (!history.m_versions[keyframe].m_keyframe) {
+    --keyframe;
+  }
+  value = history.m_versions[keyframe].m_data;
+  for (size_t i = keyframe + 1; i <= index; ++i) {
+    applyDelta(value, history.m_versions[i].m_data);
+  }
+}
+
+bool HistoryStore::load(const std::string& path, uint64_t version, std::vector<char>& value,
+                        Clock::time_point& received) {
+  auto it = m_topics.find(path);
+  if (it == m_topics.end()) {
+    return false;
+  }
+  History& history = it->second;
+  if (version < history.m_first || version >= history.m_first + history.m_versions.size()) {
+    return false;
+  }
+  touch(history);
+
+  size_t index = version - history.m_first;
+  std::vector<uint8_t> bytes;
+  restore(history, index, bytes);
+  value.assign(bytes.begin(), bytes.end());
+  received = history.m_versions[index].m_received;
+  return true;
+}
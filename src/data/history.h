@@ -0,0 +1,88 @@
+#ifndef DMON_HISTORY_H
+#define DMON_HISTORY_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "data/diff.h"
+
+struct Topic;
+
+struct HistoryOptions {
+  // versions kept per topic, 0 turns the history off
+  size_t m_versions{32};
+  // versions older than this are dropped, 0 for no limit
+  long m_seconds{0};
+  // all histories together, the least recently used topics go first
+  size_t m_budget{64 << 20};
+  // a full copy every this many versions bounds the deltas applied to
+  // restore one
+  size_t m_keyframe_interval{16};
+};
+
+// Recent values of every topic, stored as XOR deltas against the version
+// before with a full keyframe every m_keyframe_interval versions. A delta
+// holds only the changed byte ranges found by diffBytes(), so a small change
+// of a large value costs a few bytes. Every topic keeps a bounded ring of
+// versions; when all of them exceed the memory budget the histories of the
+// least recently updated or viewed topics are dropped.
+class HistoryStore {
+ public:
+  using Clock = std::chrono::system_clock;
+
+  explicit HistoryStore(const HistoryOptions& options = HistoryOptions()) : m_options(options) {}
+
+  void record(const Topic& topic);
+  void clear();
+
+  // versions of the topic are numbered from its first one, those kept are
+  // [first, end); false when there are none
+  bool range(const std::string& path, uint64_t& first, uint64_t& end) const;
+  // restores a kept version and marks the topic as used
+  bool load(const std::string& path, uint64_t version, std::vector<char>& value, Clock::time_point& received);
+
+  size_t memory() const { return m_memory; }
+  size_t topics() const { return m_topics.size(); }
+
+ private:
+  struct Version {
+    Clock::time_point m_received;
+    bool m_keyframe{false};
+    // the value for keyframes, changed ranges otherwise
+    std::vector<uint8_t> m_data;
+  };
+
+  struct History {
+    std::deque<Version> m_versions;
+    // number of the oldest kept version
+    uint64_t m_first{0};
+    // latest value, the next delta is taken against it
+    std::vector<uint8_t> m_last;
+    size_t m_since_keyframe{0};
+    size_t m_memory{0};
+    std::list<std::string>::iterator m_lru;
+  };
+
+  static size_t cost(const Version& version) { return sizeof(Version) + version.m_data.capacity(); }
+  void restore(const History& history, size_t index, std::vector<uint8_t>& value) const;
+  void dropOldest(History& history);
+  void touch(History& history);
+  void evict();
+
+  HistoryOptions m_options;
+  std::unordered_map<std::string, History> m_topics;
+  // most recently used first
+  std::list<std::string> m_lru;
+  size_t m_memory{0};
+  // reused for the delta of every update
+  std::vector<ByteRange> m_ranges;
+  std::vector<uint8_t> m_scratch;
+};
+
+#endif //DMON_HISTORY_H
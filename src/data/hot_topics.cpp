@@ -0,0 +1,51 @@
+#include "data/hot_topics.h"
+
+HotTopics::HotTopics()
+    : m_depth(kDefaultDepth),
+      m_topic_messages(kDefaultCapacity),
+      m_topic_bytes(kDefaultCapacity),
+      m_branch_messages(kDefaultCapacity),
+      m_branch_bytes(kDefaultCapacity) {}
+
+void HotTopics::configure(size_t capacity, size_t depth) {
+  std::lock_guard<std::mutex> lk(m_mutex);
+  m_depth = std::max<size_t>(1, depth);
+  m_topic_messages = SpaceSaving(capacity);
+  m_topic_bytes = SpaceSaving(capacity);
+  m_branch_messages = SpaceSaving(capacity);
+  m_branch_bytes = SpaceSaving(capacity);
+}
+
+void HotTopics::record(const std::string& path, size_t bytes) {
+  std::lock_guard<std::mutex> lk(m_mutex);
+
+  // the branch is the path cut after m_depth segments, leading slashes
+  // belong to the first one
+  size_t from = path.find_first_not_of('/');
+  size_t end = from;
+  for (size_t segment = 0; segment < m_depth && end != std::string::npos; ++segment) {
+    end = path.find('/', from);
+    from = end + 1;
+  }
+  m_branch.assign(path, 0, end);
+
+  m_topic_messages.add(path);
+  m_branch_messages.add(m_branch);
+  if (bytes) {
+    m_topic_bytes.add(path, bytes);
+    m_branch_bytes.add(m_branch, bytes);
+  }
+}
+
+HotTopics::Report HotTopics::report(size_t n) const {
+  std::lock_guard<std::mutex> lk(m_mutex);
+  Report r;
+  r.m_messages = m_topic_messages.total();
+  r.m_bytes = m_topic_bytes.total();
+  r.m_depth = m_depth;
+  r.m_topics_by_messages = m_topic_messages.top(n);
+  r.m_topics_by_bytes = m_topic_bytes.top(n);
+  r.m_branches_by_messages = m_branch_messages.top(n);
+  r.m_branches_by_bytes = m_branch_bytes.top(n);
+  return r;
+}
@@ -0,0 +1,47 @@
+#ifndef DMON_HOT_TOPICS_H
+#define DMON_HOT_TOPICS_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "data/space_saving.h"
+
+// Heaviest topics and branches by message count and by bytes, tracked with
+// Space-Saving sketches so memory stays bounded whatever the number of
+// topics. Fed on the callback thread, read from the UI or the headless
+// reporter.
+class HotTopics {
+ public:
+  static constexpr size_t kDefaultCapacity = 1024;
+  static constexpr size_t kDefaultDepth = 2;
+
+  struct Report {
+    uint64_t m_messages{0};
+    uint64_t m_bytes{0};
+    size_t m_depth{0};
+    std::vector<SpaceSaving::Entry> m_topics_by_messages;
+    std::vector<SpaceSaving::Entry> m_topics_by_bytes;
+    std::vector<SpaceSaving::Entry> m_branches_by_messages;
+    std::vector<SpaceSaving::Entry> m_branches_by_bytes;
+  };
+
+  HotTopics();
+
+  // capacity is the number of counters per sketch, depth the number of path
+  // segments a branch is made of; drops everything counted so far
+  void configure(size_t capacity, size_t depth);
+  void record(const std::string& path, size_t bytes);
+  Report report(size_t n) const;
+
+ private:
+  mutable std::mutex m_mutex;
+  size_t m_depth;
+  SpaceSaving m_topic_messages;
+  SpaceSaving m_topic_bytes;
+  SpaceSaving m_branch_messages;
+  SpaceSaving m_branch_bytes;
+  std::string m_branch;
+};
+
+#endif //DMON_HOT_TOPICS_H
@@ -0,0 +1,150 @@
+#include "data/latency.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+LatencyHistogram::LatencyHistogram() : m_counts(new std::atomic<uint64_t>[kBuckets]()) {}
+
+size_t LatencyHistogram::bucket(uint64_t value) {
+  if (value < (uint64_t(1) << kSubBits)) {
+    return value;
+  }
+  int magnitude = 63 - __builtin_clzll(value);
+  if (magnitude >= kMaxBits) {
+    return kBuckets - 1;
+  }
+  int shift = magnitude - kSubBits + 1;
+  return (size_t(1) << kSubBits) + (size_t(magnitude - kSubBits) << (kSubBits - 1)) +
+         ((value >> shift) - (uint64_t(1) << (kSubBits - 1)));
+}
+
+uint64_t LatencyHistogram::lowest(size_t bucket) {
+  if (bucket < (size_t(1) << kSubBits)) {
+    return bucket;
+  }
+  size_t offset = bucket - (size_t(1) << kSubBits);
+  int shift = int(offset >> (kSubBits - 1)) + 1;
+  uint64_t sub = offset & ((size_t(1) << (kSubBits - 1)) - 1);
+  return (sub + (uint64_t(1) << (kSubBits - 1))) << shift;
+}
+
+uint64_t LatencyHistogram::highest(size_t bucket) {
+  if (bucket < (size_t(1) << kSubBits)) {
+    return bucket;
+  }
+  int shift = int((bucket - (size_t(1) << kSubBits)) >> (kSubBits - 1)) + 1;
+  return lowest(bucket) + (uint64_t(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(int64_t nanoseconds) {
+  // a clock step back shows as zero rather than as a huge unsigned value
+  uint64_t value = nanoseconds > 0 ? uint64_t(nanoseconds) : 0;
+  auto& counter = m_counts[bucket(value)];
+  counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  m_count.store(m_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  m_sum.store(m_sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  if (int64_t(value) > m_max.load(std::memory_order_relaxed)) {
+    m_max.store(int64_t(value), std::memory_order_relaxed);
+  }
+}
+
+LatencySummary LatencyHistogram::summary() const {
+  LatencySummary s;
+  // the buckets are summed again rather than read from m_count, so the
+  // percentiles agree with the counts even while the writer goes on
+  forEach([&s](uint64_t, uint64_t n) { s.m_count += n; });
+  if (s.m_count == 0) {
+    return s;
+  }
+  s.m_mean = double(m_sum.load(std::memory_order_relaxed)) / double(count());
+  s.m_max = m_max.load(std::memory_order_relaxed);
+
+  const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+  int64_t* values[] = {&s.m_p50, &s.m_p90, &s.m_p99, &s.m_p999};
+  uint64_t ranks[4];
+  for (size_t i = 0; i < 4; ++i) {
+    ranks[i] = std::max<uint64_t>(1, uint64_t(std::ceil(quantiles[i] * double(s.m_count))));
+  }
+  uint64_t seen = 0;
+  size_t next = 0;
+  double m2 = 0.0;
+  for (size_t i = 0; i < kBuckets && seen < s.m_count; ++i) {
+    uint64_t n = std::min(m_counts[i].load(std::memory_order_relaxed), s.m_count - seen);
+    if (n == 0) {
+      continue;
+    }
+    seen += n;
+    double middle = 0.5 * (double(lowest(i)) + double(highest(i)));
+    m2 += double(n) * (middle - s.m_mean) * (middle - s.m_mean);
+    for (; next < 4 && seen >= ranks[next]; ++next) {
+      *values[next] = int64_t(highest(i));
+    }
+  }
+  s.m_stddev = std::sqrt(m2 / double(s.m_count));
+  // the top bucket reaches past the largest value recorded
+  for (auto value : values) {
+    *value = std::min(*value, s.m_max);
+  }
+  return s;
+}
+
+const char* PipelineLatency::name(LatencyStage stage) {
+  switch (stage) {
+    case LatencyStage::Ingest:
+      return "ingest";
+    case LatencyStage::Handoff:
+      return "hand-off";
+    case LatencyStage::Render:
+      return "render";
+    case LatencyStage::EndToEnd:
+      return "end-to-end";
+  }
+  return "???";
+}
+
+bool PipelineLatency::exportTo(const std::string& prefix, std::string& error) const {
+  char line[128];
+  for (size_t i = 0; i < kStages; ++i) {
+    auto stage = static_cast<LatencyStage>(i);
+    std::string path = prefix + "-" + name(stage) + ".hgrm";
+    std::ofstream out(path);
+    if (!out) {
+      error = path + ": " + strerror(errno);
+      return false;
+    }
+    const auto& histogram = m_stages[i];
+    auto s = histogram.summary();
+    snprintf(line, sizeof(line), "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+    out << line;
+    uint64_t seen = 0;
+    histogram.forEach([&](uint64_t value, uint64_t n) {
+      seen = std::min(seen + n, s.m_count);
+      double percentile = double(seen) / double(s.m_count);
+      auto total = static_cast<unsigned long long>(seen);
+      if (seen < s.m_count) {
+        snprintf(line, sizeof(line), "%12.3f %2.12f %10llu %14.2f\n", value / 1e3, percentile, total,
+                 1.0 / (1.0 - percentile));
+      } else {
+        snprintf(line, sizeof(line), "%12.3f %2.12f %10llu\n", value / 1e3, percentile, total);
+      }
+      out << line;
+    });
+    snprintf(line, sizeof(line), "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", s.m_mean / 1e3, s.m_stddev / 1e3);
+    out << line;
+    snprintf(line, sizeof(line), "#[Max     = %12.3f, Total count    = %12llu]\n", s.m_max / 1e3,
+             static_cast<unsigned long long>(s.m_count));
+    out << line;
+    snprintf(line, sizeof(line), "#[Buckets = %12d, SubBuckets     = %12d]\n",
+             LatencyHistogram::kMaxBits - LatencyHistogram::kSubBits + 1, 1 << LatencyHistogram::kSubBits);
+    out << line;
+    if (!out.flush()) {
+      error = path + ": write failed";
+      return false;
+    }
+  }
+  return true;
+}
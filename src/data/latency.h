@@ -0,0 +1,99 @@
+#ifndef DMON_LATENCY_H
+#define DMON_LATENCY_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// nanoseconds, except the count
+struct LatencySummary {
+  uint64_t m_count{0};
+  double m_mean{0.0};
+  double m_stddev{0.0};
+  int64_t m_p50{0};
+  int64_t m_p90{0};
+  int64_t m_p99{0};
+  int64_t m_p999{0};
+  int64_t m_max{0};
+};
+
+// Latency distribution in the HdrHistogram layout: values below 2^kSubBits ns
+// are counted exactly, above that every power of two is split into
+// 2^(kSubBits - 1) equal buckets, so a value is off by less than 1/128 of it
+// up to 2^kMaxBits ns (about 18 minutes), where it is clamped. Like Counters
+// it has a single writer which only does relaxed loads and stores, so
+// readers on other threads never slow recording down.
+class LatencyHistogram {
+ public:
+  static constexpr int kSubBits = 8;
+  static constexpr int kMaxBits = 40;
+  static constexpr size_t kBuckets = (size_t(1) << kSubBits) + (size_t(kMaxBits - kSubBits) << (kSubBits - 1));
+
+  LatencyHistogram();
+
+  void record(int64_t nanoseconds);
+  uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+  LatencySummary summary() const;
+
+  // calls fn(highest value of the bucket, count) for the buckets with counts
+  template <typename Fn>
+  void forEach(Fn&& fn) const {
+    for (size_t i = 0; i < kBuckets; ++i) {
+      if (uint64_t n = m_counts[i].load(std::memory_order_relaxed)) {
+        fn(highest(i), n);
+      }
+    }
+  }
+
+  static size_t bucket(uint64_t value);
+  // range of the values a bucket counts
+  static uint64_t lowest(size_t bucket);
+  static uint64_t highest(size_t bucket);
+
+ private:
+  std::unique_ptr<std::atomic<uint64_t>[]> m_counts;
+  std::atomic<uint64_t> m_count{0};
+  std::atomic<uint64_t> m_sum{0};
+  std::atomic<int64_t> m_max{0};
+};
+
+// Stages a subscribed message goes through on its way to the screen, each
+// timed on the monotonic clock.
+enum class LatencyStage : size_t {
+  // topic handler called -> queued for the UI, or handed to the headless
+  // callback: counters, sketches, deltas
+  Ingest,
+  // queued -> taken by the UI thread, waiting for the screen to run the post
+  Handoff,
+  // taken by the UI thread -> the first frame showing it painted
+  Render,
+  // topic handler called -> painted
+  EndToEnd,
+};
+
+class PipelineLatency {
+ public:
+  static constexpr size_t kStages = 4;
+
+  static const char* name(LatencyStage stage);
+
+  // Ingest on the session callback thread, the others on the UI thread
+  void record(LatencyStage stage, int64_t nanoseconds) {
+    m_stages[static_cast<size_t>(stage)].record(nanoseconds);
+  }
+  const LatencyHistogram& histogram(LatencyStage stage) const {
+    return m_stages[static_cast<size_t>(stage)];
+  }
+
+  // every stage as a percentile distribution in microseconds, the .hgrm
+  // text HdrHistogram tools plot, to <prefix>-<stage>.hgrm
+  bool exportTo(const std::string& prefix, std::string& error) const;
+
+ private:
+  std::array<LatencyHistogram, kStages> m_stages;
+};
+
+#endif //DMON_LATENCY_H
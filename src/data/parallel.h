@@ -0,0 +1,85 @@
+#ifndef DMON_PARALLEL_H
+#define DMON_PARALLEL_H
+
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+// Inputs smaller than this are processed on the calling thread: spawning
+// workers costs more than it saves.
+constexpr size_t kParallelMinChunk = 1 << 14;
+
+inline size_t parallelWorkers(size_t n, size_t min_chunk = kParallelMinChunk) {
+  size_t hw = std::max(1u, std::thread::hardware_concurrency());
+  return std::max<size_t>(1, std::min(hw, n / std::max<size_t>(1, min_chunk)));
+}
+
+// Calls fn(worker, begin, end) for contiguous slices of [0, n), one slice per
+// worker. Worker 0 runs on the calling thread.
+template <typename Fn>
+void parallelFor(size_t n, Fn&& fn, size_t min_chunk = kParallelMinChunk) {
+  size_t workers = parallelWorkers(n, min_chunk);
+  if (workers == 1) {
+    fn(size_t(0), size_t(0), n);
+    return;
+  }
+
+  std::vector<std::thread> threads;
+  threads.reserve(workers - 1);
+  for (size_t w = 1; w < workers; ++w) {
+    threads.emplace_back([&fn, w, workers, n]() {
+      fn(w, n * w / workers, n * (w + 1) / workers);
+    });
+  }
+  fn(size_t(0), size_t(0), n / workers);
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+// Sorts [first, last): every worker sorts its own run, then neighbouring runs
+// are merged pairwise (again in parallel) until one run is left.
+template <typename It, typename Cmp>
+void parallelSort(It first, It last, Cmp cmp, size_t min_chunk = kParallelMinChunk) {
+  size_t n = std::distance(first, last);
+  size_t workers = parallelWorkers(n, min_chunk);
+  if (workers == 1) {
+    std::sort(first, last, cmp);
+    return;
+  }
+
+  std::vector<size_t> bounds;
+  for (size_t w = 0; w <= workers; ++w) {
+    bounds.push_back(n * w / workers);
+  }
+
+  parallelFor(workers, [&](size_t, size_t begin, size_t end) {
+    for (size_t r = begin; r < end; ++r) {
+      std::sort(first + bounds[r], first + bounds[r + 1], cmp);
+    }
+  }, 1);
+
+  while (bounds.size() > 2) {
+    std::vector<size_t> next;
+    std::vector<std::thread> threads;
+    size_t i = 0;
+    for (; i + 2 < bounds.size(); i += 2) {
+      next.push_back(bounds[i]);
+      threads.emplace_back([first, cmp, lo = bounds[i], mid = bounds[i + 1], hi = bounds[i + 2]]() {
+        std::inplace_merge(first + lo, first + mid, first + hi, cmp);
+      });
+    }
+    // an odd run out waits for the next round as is
+    if (i + 1 < bounds.size()) {
+      next.push_back(bounds[i]);
+    }
+    next.push_back(n);
+    for (auto& t : threads) {
+      t.join();
+    }
+    bounds = std::move(next);
+  }
+}
+
+#endif //DMON_PARALLEL_H
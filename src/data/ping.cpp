@@ -0,0 +1,64 @@
+#include "data/ping.h"
+
+#include <cstdlib>
+
+uint64_t PingProbe::next(int64_t now, int64_t timeout) {
+  uint64_t sequence = m_sequence.load(std::memory_order_relaxed);
+  if (sequence != 0 && m_answered.load(std::memory_order_relaxed) != sequence) {
+    if (now - m_sent_at.load(std::memory_order_relaxed) < timeout) {
+      return 0;
+    }
+    m_lost.store(m_lost.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+  // the only writer, so the version needs no read-modify-write
+  uint64_t version = m_version.load(std::memory_order_relaxed);
+  m_version.store(version + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  m_sent_at.store(now, std::memory_order_relaxed);
+  m_timeout.store(timeout, std::memory_order_relaxed);
+  m_sequence.store(sequence + 1, std::memory_order_relaxed);
+  m_version.store(version + 2, std::memory_order_release);
+  return sequence + 1;
+}
+
+void PingProbe::reply(uint64_t sequence, int64_t now) {
+  int64_t sent_at = 0;
+  int64_t timeout = 0;
+  for (;;) {
+    uint64_t version = m_version.load(std::memory_order_acquire);
+    uint64_t current = m_sequence.load(std::memory_order_relaxed);
+    sent_at = m_sent_at.load(std::memory_order_relaxed);
+    timeout = m_timeout.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if ((version & 1) == 0 && m_version.load(std::memory_order_relaxed) == version) {
+      // a ping given up on has been replaced by the next one
+      if (current != sequence) {
+        return;
+      }
+      break;
+    }
+  }
+  // counted lost, or about to be, before its replacement is sent
+  if (now - sent_at >= timeout) {
+    return;
+  }
+  int64_t rtt = now - sent_at;
+  m_rtt.record(rtt);
+  int64_t last = m_last.load(std::memory_order_relaxed);
+  if (last != 0) {
+    int64_t jitter = m_jitter.load(std::memory_order_relaxed);
+    m_jitter.store(jitter + (std::llabs(rtt - last) - jitter) / kJitterGain, std::memory_order_relaxed);
+  }
+  m_last.store(rtt, std::memory_order_relaxed);
+  m_answered.store(sequence, std::memory_order_relaxed);
+}
+
+PingSummary PingProbe::summary() const {
+  PingSummary s;
+  s.m_rtt = m_rtt.summary();
+  s.m_last = m_last.load(std::memory_order_relaxed);
+  s.m_jitter = m_jitter.load(std::memory_order_relaxed);
+  s.m_sent = m_sequence.load(std::memory_order_relaxed);
+  s.m_lost = m_lost.load(std::memory_order_relaxed);
+  return s;
+}
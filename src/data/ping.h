@@ -0,0 +1,51 @@
+#ifndef DMON_PING_H
+#define DMON_PING_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "data/latency.h"
+
+// nanoseconds, except the counts
+struct PingSummary {
+  LatencySummary m_rtt;
+  int64_t m_last{0};
+  // smoothed difference of consecutive round trips, as RFC 3550 does it
+  int64_t m_jitter{0};
+  uint64_t m_sent{0};
+  uint64_t m_lost{0};
+};
+
+// Round trip times of pings to the server, one in flight at a time so a slow
+// server is not piled up with them. Every ping carries a sequence number in
+// its context; a reply to a ping that was given up on is not counted.
+// Pings are sent from the prober thread and their replies arrive on the
+// session callback thread, each side only stores what it owns.
+class PingProbe {
+ public:
+  // sequence number of the next ping to send, 0 while the last one is in
+  // flight for less than timeout; a ping outstanding longer is counted lost
+  uint64_t next(int64_t now, int64_t timeout);
+  void reply(uint64_t sequence, int64_t now);
+
+  PingSummary summary() const;
+  const LatencyHistogram& rtt() const { return m_rtt; }
+
+ private:
+  static constexpr int kJitterGain = 16;
+
+  // prober thread; the sequence number and its send time are written under
+  // a seqlock, m_version is odd while they are
+  std::atomic<uint64_t> m_version{0};
+  std::atomic<uint64_t> m_sequence{0};
+  std::atomic<int64_t> m_sent_at{0};
+  std::atomic<int64_t> m_timeout{0};
+  std::atomic<uint64_t> m_lost{0};
+  // callback thread
+  LatencyHistogram m_rtt;
+  std::atomic<uint64_t> m_answered{0};
+  std::atomic<int64_t> m_last{0};
+  std::atomic<int64_t> m_jitter{0};
+};
+
+#endif //DMON_PING_H
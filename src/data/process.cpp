@@ -0,0 +1,70 @@
+#include "data/process.h"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#ifdef DMON_COUNT_ALLOCATIONS
+namespace {
+std::atomic<uint64_t> allocations{0};
+
+void* allocate(std::size_t size) noexcept {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size == 0 ? 1 : size);
+}
+}  // namespace
+
+// the array forms call these ones
+void* operator new(std::size_t size) {
+  if (void* p = allocate(size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+#endif
+
+bool allocationsCounted() {
+#ifdef DMON_COUNT_ALLOCATIONS
+  return true;
+#else
+  return false;
+#endif
+}
+
+ProcessUsage processUsage() {
+  ProcessUsage usage;
+  rusage ru{};
+  if (getrusage(RUSAGE_SELF, &ru) == 0) {
+    usage.m_cpu_seconds = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 + ru.ru_stime.tv_sec +
+                          ru.ru_stime.tv_usec * 1e-6;
+  }
+  // size and resident pages
+  if (FILE* statm = fopen("/proc/self/statm", "r")) {
+    unsigned long long size = 0;
+    unsigned long long resident = 0;
+    if (fscanf(statm, "%llu %llu", &size, &resident) == 2) {
+      usage.m_rss_bytes = resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    }
+    fclose(statm);
+  }
+#ifdef DMON_COUNT_ALLOCATIONS
+  usage.m_allocations = allocations.load(std::memory_order_relaxed);
+#endif
+  return usage;
+}
@@ -0,0 +1,22 @@
+#ifndef DMON_PROCESS_H
+#define DMON_PROCESS_H
+
+#include <cstdint>
+
+struct ProcessUsage {
+  // user and system time of all threads since the process started
+  double m_cpu_seconds{0.0};
+  uint64_t m_rss_bytes{0};
+  // heap allocations so far, 0 unless they are counted
+  uint64_t m_allocations{0};
+};
+
+// getrusage for the CPU time, /proc/self/statm for the resident set
+ProcessUsage processUsage();
+
+// Built with DMON_COUNT_ALLOCATIONS the global operator new is replaced by
+// one which counts every call with a relaxed atomic increment, otherwise
+// allocations are not counted at all.
+bool allocationsCounted();
+
+#endif //DMON_PROCESS_H
@@ -0,0 +1,658 @@
+#include "data/protobuf.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "data/cbor.h"
+
+namespace {
+// groups nest by recursion, deeper ones are taken as malformed
+constexpr int kMaxGroupDepth = 64;
+// nested messages shown as text deeper than this are shown collapsed, a
+// message type may contain itself
+constexpr int kMaxTextDepth = 100;
+
+bool readVarint(const uint8_t* data, size_t size, size_t& pos, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && pos < size; shift += 7) {
+    uint8_t byte = data[pos++];
+    value |= uint64_t(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint64_t readLittleEndian(const uint8_t* data, size_t bytes) {
+  uint64_t value = 0;
+  for (size_t i = bytes; i > 0; --i) {
+    value = (value << 8) | data[i - 1];
+  }
+  return value;
+}
+
+bool readField(const uint8_t* data, size_t size, size_t pos, ProtoWireField& field, int depth) {
+  uint64_t tag;
+  if (depth > kMaxGroupDepth || !readVarint(data, size, pos, tag)) {
+    return false;
+  }
+  uint64_t number = tag >> 3;
+  if (number == 0 || number > 0x1fffffff) {
+    return false;
+  }
+  field.m_number = static_cast<uint32_t>(number);
+  field.m_wire = static_cast<WireType>(tag & 7);
+  field.m_offset = pos;
+
+  switch (field.m_wire) {
+    case WireType::Varint:
+      if (!readVarint(data, size, pos, field.m_value)) {
+        return false;
+      }
+      field.m_length = pos - field.m_offset;
+      break;
+    case WireType::Fixed64:
+    case WireType::Fixed32:
+      field.m_length = field.m_wire == WireType::Fixed64 ? 8 : 4;
+      if (size - pos < field.m_length) {
+        return false;
+      }
+      field.m_value = readLittleEndian(data + pos, field.m_length);
+      pos += field.m_length;
+      break;
+    case WireType::Length: {
+      uint64_t length;
+      if (!readVarint(data, size, pos, length) || length > size - pos) {
+        return false;
+      }
+      field.m_offset = pos;
+      field.m_length = length;
+      pos += length;
+      break;
+    }
+    case WireType::StartGroup: {
+      // a group ends with the end tag of the same number
+      ProtoWireField inner;
+      while (true) {
+        if (!readField(data, size, pos, inner, depth + 1)) {
+          return false;
+        }
+        if (inner.m_wire == WireType::EndGroup) {
+          if (inner.m_number != field.m_number) {
+            return false;
+          }
+          field.m_length = pos - field.m_offset;
+          pos = inner.m_end;
+          break;
+        }
+        pos = inner.m_end;
+      }
+      break;
+    }
+    case WireType::EndGroup:
+      field.m_length = 0;
+      break;
+    default:
+      return false;
+  }
+  field.m_end = pos;
+  return true;
+}
+
+bool isText(const uint8_t* data, size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    if (data[i] < 0x20 && data[i] != '\t' && data[i] != '\n' && data[i] != '\r') {
+      return false;
+    }
+  }
+  return length > 0;
+}
+
+bool isPackable(ProtoType type) {
+  return type != ProtoType::String && type != ProtoType::Bytes && type != ProtoType::Message &&
+         type != ProtoType::Group;
+}
+
+// the wire type the field's type is encoded with when it isn't packed
+WireType wireOf(ProtoType type) {
+  switch (type) {
+    case ProtoType::Double:
+    case ProtoType::Fixed64:
+    case ProtoType::Sfixed64:
+      return WireType::Fixed64;
+    case ProtoType::Float:
+    case ProtoType::Fixed32:
+    case ProtoType::Sfixed32:
+      return WireType::Fixed32;
+    case ProtoType::String:
+    case ProtoType::Bytes:
+    case ProtoType::Message:
+      return WireType::Length;
+    case ProtoType::Group:
+      return WireType::StartGroup;
+    default:
+      break;
+  }
+  return WireType::Varint;
+}
+
+std::string readString(const uint8_t* data, const ProtoWireField& field) {
+  return std::string(reinterpret_cast<const char*>(data + field.m_offset), field.m_length);
+}
+
+void appendHex(std::string& out, const uint8_t* data, size_t length, size_t max_length) {
+  static const char hex[] = "0123456789abcdef";
+  out += "h'";
+  for (size_t i = 0; i < length && i < max_length; ++i) {
+    out += hex[data[i] >> 4];
+    out += hex[data[i] & 0xf];
+  }
+  out += length > max_length ? "...'" : "'";
+}
+}  // namespace
+
+bool readProtoField(const uint8_t* data, size_t size, size_t pos, ProtoWireField& field) {
+  return readField(data, size, pos, field, 0);
+}
+
+bool isProtoMessage(const uint8_t* data, size_t begin, size_t end) {
+  ProtoWireField field;
+  for (size_t pos = begin; pos < end; pos = field.m_end) {
+    if (!readField(data, end, pos, field, 0) || field.m_wire == WireType::EndGroup) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const ProtoField* ProtoMessage::field(uint32_t number) const {
+  auto it = std::lower_bound(m_fields.begin(), m_fields.end(), number,
+                             [](const ProtoField& f, uint32_t n) { return f.m_number < n; });
+  return it != m_fields.end() && it->m_number == number ? &*it : nullptr;
+}
+
+bool ProtoSchema::load(const std::string& path, std::string& error) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    error = "can't open " + path;
+    return false;
+  }
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  // FileDescriptorSet: repeated FileDescriptorProto file = 1
+  ProtoWireField field;
+  for (size_t pos = 0; pos < data.size(); pos = field.m_end) {
+    if (!readProtoField(data.data(), data.size(), pos, field)) {
+      error = path + " is not a FileDescriptorSet";
+      return false;
+    }
+    if (field.m_number == 1 && field.m_wire == WireType::Length &&
+        !loadFile(data.data(), field.m_offset, field.m_offset + field.m_length)) {
+      error = path + " has a malformed FileDescriptorProto";
+      return false;
+    }
+  }
+  resolve();
+  return true;
+}
+
+bool ProtoSchema::loadFile(const uint8_t* data, size_t begin, size_t end) {
+  // FileDescriptorProto: package = 2, message_type = 4, enum_type = 5; the
+  // package is looked up first since it scopes the others
+  std::string scope;
+  ProtoWireField field;
+  for (size_t pos = begin; pos < end; pos = field.m_end) {
+    if (!readProtoField(data, end, pos, field)) {
+      return false;
+    }
+    if (field.m_number == 2 && field.m_wire == WireType::Length) {
+      scope = "." + readString(data, field);
+    }
+  }
+  for (size_t pos = begin; pos < end; pos = field.m_end) {
+    readProtoField(data, end, pos, field);
+    if (field.m_wire != WireType::Length) {
+      continue;
+    }
+    if (field.m_number == 4 && !loadMessage(data, field.m_offset, field.m_offset + field.m_length, scope)) {
+      return false;
+    }
+    if (field.m_number == 5 && !loadEnum(data, field.m_offset, field.m_offset + field.m_length, scope)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ProtoSchema::loadMessage(const uint8_t* data, size_t begin, size_t end, const std::string& scope) {
+  // DescriptorProto: name = 1, field = 2, nested_type = 3, enum_type = 4
+  std::string name;
+  ProtoWireField field;
+  for (size_t pos = begin; pos < end; pos = field.m_end) {
+    if (!readProtoField(data, end, pos, field)) {
+      return false;
+    }
+    if (field.m_number == 1 && field.m_wire == WireType::Length) {
+      name = scope + "." + readString(data, field);
+    }
+  }
+
+  // a descriptor without a name can't be referred to
+  if (name.size() <= scope.size()) {
+    return false;
+  }
+
+  // deque elements stay where they are while more are added
+  m_messages.emplace_back();
+  ProtoMessage& message = m_messages.back();
+  message.m_name = name.substr(1);
+  m_message_index[name] = &message;
+
+  for (size_t pos = begin; pos < end; pos = field.m_end) {
+    readProtoField(data, end, pos, field);
+    if (field.m_wire != WireType::Length) {
+      continue;
+    }
+    size_t content_end = field.m_offset + field.m_length;
+    if (field.m_number == 3 && !loadMessage(data, field.m_offset, content_end, name)) {
+      return false;
+    }
+    if (field.m_number == 4 && !loadEnum(data, field.m_offset, content_end, name)) {
+      return false;
+    }
+    if (field.m_number != 2) {
+      continue;
+    }
+
+    // FieldDescriptorProto: name = 1, number = 3, label = 4, type = 5,
+    // type_name = 6
+    ProtoField f;
+    ProtoWireField attribute;
+    for (size_t p = field.m_offset; p < content_end; p = attribute.m_end) {
+      if (!readProtoField(data, content_end, p, attribute)) {
+        return false;
+      }
+      switch (attribute.m_number) {
+        case 1:
+          f.m_name = readString(data, attribute);
+          break;
+        case 3:
+          f.m_number = static_cast<uint32_t>(attribute.m_value);
+          break;
+        case 4:
+          f.m_repeated = attribute.m_value == 3;
+          break;
+        case 5:
+          f.m_type = static_cast<ProtoType>(attribute.m_value);
+          break;
+        case 6:
+          f.m_type_name = readString(data, attribute);
+          break;
+        default:
+          break;
+      }
+    }
+    message.m_fields.push_back(std::move(f));
+  }
+
+  std::sort(message.m_fields.begin(), message.m_fields.end(),
+            [](const ProtoField& a, const ProtoField& b) { return a.m_number < b.m_number; });
+  return true;
+}
+
+bool ProtoSchema::loadEnum(const uint8_t* data, size_t begin, size_t end, const std::string& scope) {
+  // EnumDescriptorProto: name = 1, value = 2 { name = 1, number = 2 }
+  m_enums.emplace_back();
+  ProtoEnum& e = m_enums.back();
+  ProtoWireField field;
+  for (size_t pos = begin; pos < end; pos = field.m_end) {
+    if (!readProtoField(data, end, pos, field)) {
+      return false;
+    }
+    if (field.m_number == 1 && field.m_wire == WireType::Length) {
+      e.m_name = scope + "." + readString(data, field);
+    }
+    if (field.m_number != 2 || field.m_wire != WireType::Length) {
+      continue;
+    }
+    std::string name;
+    int32_t number = 0;
+    ProtoWireField value;
+    size_t value_end = field.m_offset + field.m_length;
+    for (size_t p = field.m_offset; p < value_end; p = value.m_end) {
+      if (!readProtoField(data, value_end, p, value)) {
+        return false;
+      }
+      if (value.m_number == 1) {
+        name = readString(data, value);
+      } else if (value.m_number == 2) {
+        number = static_cast<int32_t>(value.m_value);
+      }
+    }
+    e.m_values[number] = std::move(name);
+  }
+  if (e.m_name.size() <= scope.size()) {
+    return false;
+  }
+  m_enum_index[e.m_name] = &e;
+  e.m_name = e.m_name.substr(1);
+  return true;
+}
+
+void ProtoSchema::resolve() {
+  for (auto& message : m_messages) {
+    for (auto& field : message.m_fields) {
+      // protoc writes fully qualified names with a leading dot
+      std::string name = !field.m_type_name.empty() && field.m_type_name[0] != '.' ? "." + field.m_type_name
+                                                                                  : field.m_type_name;
+      auto m = m_message_index.find(name);
+      field.m_message = m != m_message_index.end() ? m->second : nullptr;
+      auto e = m_enum_index.find(name);
+      field.m_enum = e != m_enum_index.end() ? e->second : nullptr;
+    }
+  }
+}
+
+bool ProtoSchema::bind(const std::string& bindings, std::string& error) {
+  size_t begin = 0;
+  while (begin < bindings.size()) {
+    size_t end = std::min(bindings.find(',', begin), bindings.size());
+    std::string binding = bindings.substr(begin, end - begin);
+    begin = end + 1;
+
+    size_t eq = binding.find('=');
+    if (eq == std::string::npos) {
+      error = "expected prefix=package.Message, got " + binding;
+      return false;
+    }
+    const ProtoMessage* type = message(binding.substr(eq + 1));
+    if (!type) {
+      error = "unknown message type " + binding.substr(eq + 1);
+      return false;
+    }
+    m_bindings.emplace_back(binding.substr(0, eq), type);
+  }
+
+  std::stable_sort(m_bindings.begin(), m_bindings.end(),
+                   [](const auto& a, const auto& b) { return a.first.size() > b.first.size(); });
+  return true;
+}
+
+const ProtoMessage* ProtoSchema::message(const std::string& name) const {
+  auto it = m_message_index.find(!name.empty() && name[0] == '.' ? name : "." + name);
+  return it != m_message_index.end() ? it->second : nullptr;
+}
+
+const ProtoMessage* ProtoSchema::messageFor(const std::string& path) const {
+  for (const auto& binding : m_bindings) {
+    if (path.compare(0, binding.first.size(), binding.first) == 0) {
+      return binding.second;
+    }
+  }
+  return nullptr;
+}
+
+bool ProtoTree::reset(const uint8_t* data, size_t size, const ProtoMessage* type) {
+  clear();
+  // without a type an empty payload says nothing about being protobuf
+  if ((size == 0 && !type) || size >= kNone || !isProtoMessage(data, 0, size)) {
+    return false;
+  }
+
+  m_data = data;
+  m_size = size;
+  m_type = type;
+  Node root;
+  root.m_length = static_cast<uint32_t>(size);
+  root.m_message = type;
+  root.m_container = true;
+  root.m_expanded = true;
+  m_nodes.push_back(root);
+  return true;
+}
+
+void ProtoTree::clear() {
+  m_data = nullptr;
+  m_size = 0;
+  m_type = nullptr;
+  m_nodes.clear();
+}
+
+uint32_t ProtoTree::children(uint32_t index) {
+  if (m_nodes[index].m_indexed || !m_nodes[index].m_container) {
+    return m_nodes[index].m_first_child;
+  }
+
+  uint32_t first = static_cast<uint32_t>(m_nodes.size());
+  const Node node = m_nodes[index];
+  if (node.m_field && node.m_wire == WireType::Length && isPackable(node.m_field->m_type)) {
+    indexPacked(index);
+  } else {
+    indexFields(index, node.m_offset, node.m_offset + node.m_length, node.m_message);
+  }
+
+  Node& indexed = m_nodes[index];
+  indexed.m_first_child = first;
+  indexed.m_children = static_cast<uint32_t>(m_nodes.size() - first);
+  indexed.m_indexed = true;
+  return first;
+}
+
+void ProtoTree::indexFields(uint32_t index, size_t begin, size_t end, const ProtoMessage* type) {
+  ProtoWireField field;
+  for (size_t pos = begin; pos < end; pos = field.m_end) {
+    // the content was checked before it became a container
+    readProtoField(m_data, end, pos, field);
+
+    Node child;
+    child.m_number = field.m_number;
+    child.m_wire = field.m_wire;
+    child.m_value = field.m_value;
+    child.m_offset = static_cast<uint32_t>(field.m_offset);
+    child.m_length = static_cast<uint32_t>(field.m_length);
+    child.m_parent = index;
+    child.m_field = type ? type->field(field.m_number) : nullptr;
+
+    size_t content_end = field.m_offset + field.m_length;
+    const uint8_t* content = m_data + field.m_offset;
+    const ProtoField* f = child.m_field;
+    if (field.m_wire == WireType::StartGroup) {
+      child.m_container = true;
+      child.m_message = f ? f->m_message : nullptr;
+    } else if (field.m_wire == WireType::Length) {
+      if (f && f->m_type == ProtoType::Message) {
+        child.m_message = f->m_message;
+        child.m_container = isProtoMessage(m_data, field.m_offset, content_end);
+      } else if (f && isPackable(f->m_type)) {
+        child.m_container = true;
+      } else if (!f) {
+        // untyped: readable text stays a string, anything else which
+        // parses as fields is taken for a nested message
+        child.m_container = field.m_length > 0 && !isText(content, field.m_length) &&
+                            isProtoMessage(m_data, field.m_offset, content_end);
+      }
+    }
+    m_nodes.push_back(child);
+  }
+}
+
+void ProtoTree::indexPacked(uint32_t index) {
+  const Node node = m_nodes[index];
+  WireType wire = wireOf(node.m_field->m_type);
+  size_t end = node.m_offset + node.m_length;
+  size_t pos = node.m_offset;
+  while (pos < end) {
+    Node element;
+    element.m_number = node.m_number;
+    element.m_wire = wire;
+    element.m_field = node.m_field;
+    element.m_packed = true;
+    element.m_parent = index;
+    element.m_offset = static_cast<uint32_t>(pos);
+    if (wire == WireType::Varint) {
+      if (!readVarint(m_data, end, pos, element.m_value)) {
+        break;
+      }
+    } else {
+      size_t width = wire == WireType::Fixed64 ? 8 : 4;
+      if (end - pos < width) {
+        break;
+      }
+      element.m_value = readLittleEndian(m_data + pos, width);
+      pos += width;
+    }
+    element.m_length = static_cast<uint32_t>(pos - element.m_offset);
+    m_nodes.push_back(element);
+  }
+}
+
+void ProtoTree::appendValue(std::string& out, const Node& node, size_t max_length) const {
+  const ProtoField* f = node.m_field;
+  const uint8_t* content = m_data + node.m_offset;
+
+  if (node.m_container) {
+    bool packed = f && node.m_wire == WireType::Length && isPackable(f->m_type);
+    out += packed ? "[" : "{";
+    if (node.m_indexed) {
+      out += std::to_string(node.m_children) + (packed ? " item" : " field") + (node.m_children == 1 ? "" : "s");
+    } else {
+      out += "...";
+    }
+    out += packed ? "]" : "}";
+    return;
+  }
+
+  // a field whose wire type doesn't fit its declared type is shown raw
+  if (f && (wireOf(f->m_type) == node.m_wire || (node.m_packed && isPackable(f->m_type)))) {
+    uint64_t v = node.m_value;
+    switch (f->m_type) {
+      case ProtoType::Double: {
+        double d;
+        memcpy(&d, &v, sizeof(d));
+        appendJsonNumber(out, d);
+        return;
+      }
+      case ProtoType::Float: {
+        uint32_t bits = static_cast<uint32_t>(v);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        appendJsonNumber(out, value);
+        return;
+      }
+      case ProtoType::Int64:
+      case ProtoType::Sfixed64:
+        out += std::to_string(static_cast<int64_t>(v));
+        return;
+      case ProtoType::Int32:
+        out += std::to_string(static_cast<int32_t>(v));
+        return;
+      case ProtoType::Sfixed32:
+        out += std::to_string(static_cast<int32_t>(static_cast<uint32_t>(v)));
+        return;
+      case ProtoType::Uint32:
+        out += std::to_string(static_cast<uint32_t>(v));
+        return;
+      case ProtoType::Sint32:
+      case ProtoType::Sint64:
+        out += std::to_string(static_cast<int64_t>((v >> 1) ^ (~(v & 1) + 1)));
+        return;
+      case ProtoType::Bool:
+        out += v ? "true" : "false";
+        return;
+      case ProtoType::Enum: {
+        if (f->m_enum) {
+          auto it = f->m_enum->m_values.find(static_cast<int32_t>(v));
+          if (it != f->m_enum->m_values.end()) {
+            out += it->second;
+            return;
+          }
+        }
+        out += std::to_string(static_cast<int32_t>(v));
+        return;
+      }
+      case ProtoType::String:
+        appendJsonString(out, content, node.m_length, max_length);
+        return;
+      case ProtoType::Bytes:
+        appendHex(out, content, node.m_length, max_length / 2);
+        return;
+      default:
+        out += std::to_string(v);
+        return;
+    }
+  }
+
+  if (node.m_wire == WireType::Length) {
+    if (isText(content, node.m_length) || node.m_length == 0) {
+      appendJsonString(out, content, node.m_length, max_length);
+    } else {
+      appendHex(out, content, node.m_length, max_length / 2);
+    }
+    return;
+  }
+  out += std::to_string(node.m_value);
+  // fixed width fields are often floating point, show that reading too
+  if (node.m_wire == WireType::Fixed64 || node.m_wire == WireType::Fixed32) {
+    double d;
+    if (node.m_wire == WireType::Fixed64) {
+      memcpy(&d, &node.m_value, sizeof(d));
+    } else {
+      uint32_t bits = static_cast<uint32_t>(node.m_value);
+      float value;
+      memcpy(&value, &bits, sizeof(value));
+      d = value;
+    }
+    out += " (";
+    appendJsonNumber(out, d);
+    out += ")";
+  }
+}
+
+std::string ProtoTree::label(uint32_t index, size_t max_length) const {
+  const Node& node = m_nodes[index];
+  std::string out;
+  if (index == kRoot) {
+    out = m_type ? m_type->m_name : std::string("message");
+    out += ' ';
+  } else if (!node.m_packed) {
+    out = node.m_field ? node.m_field->m_name : std::to_string(node.m_number);
+    out += ": ";
+  }
+  appendValue(out, node, max_length);
+  return out;
+}
+
+std::string ProtoTree::text() {
+  std::string out;
+  if (!empty()) {
+    appendText(out, kRoot, 0);
+  }
+  return out;
+}
+
+void ProtoTree::appendText(std::string& out, uint32_t index, int depth) {
+  out.append(depth * 2, ' ');
+  const Node& node = m_nodes[index];
+  if (!node.m_container || depth >= kMaxTextDepth) {
+    out += label(index, ~size_t(0) / 2);
+    out += '\n';
+    return;
+  }
+
+  if (index == kRoot) {
+    out += m_type ? m_type->m_name : std::string("message");
+  } else if (!node.m_packed) {
+    out += node.m_field ? node.m_field->m_name : std::to_string(node.m_number);
+  }
+  bool packed = node.m_field && node.m_wire == WireType::Length && isPackable(node.m_field->m_type);
+  out += packed ? " [\n" : " {\n";
+  uint32_t first = children(index);
+  for (uint32_t i = 0; i < m_nodes[index].m_children; ++i) {
+    appendText(out, first + i, depth + 1);
+  }
+  out.append(depth * 2, ' ');
+  out += packed ? "]\n" : "}\n";
+}
@@ -0,0 +1,181 @@
+#ifndef DMON_PROTOBUF_H
+#define DMON_PROTOBUF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Field types as numbered by FieldDescriptorProto.Type.
+enum class ProtoType : int {
+  Double = 1,
+  Float = 2,
+  Int64 = 3,
+  Uint64 = 4,
+  Int32 = 5,
+  Fixed64 = 6,
+  Fixed32 = 7,
+  Bool = 8,
+  String = 9,
+  Group = 10,
+  Message = 11,
+  Bytes = 12,
+  Uint32 = 13,
+  Enum = 14,
+  Sfixed32 = 15,
+  Sfixed64 = 16,
+  Sint32 = 17,
+  Sint64 = 18
+};
+
+enum class WireType : uint8_t {
+  Varint = 0,
+  Fixed64 = 1,
+  Length = 2,
+  StartGroup = 3,
+  EndGroup = 4,
+  Fixed32 = 5
+};
+
+// A field as it is on the wire: for varints m_value is the value, for
+// length delimited fields and groups [m_offset, m_offset + m_length) is the
+// content, and the fixed width ones start at m_offset.
+struct ProtoWireField {
+  uint32_t m_number{0};
+  WireType m_wire{WireType::Varint};
+  uint64_t m_value{0};
+  size_t m_offset{0};
+  size_t m_length{0};
+  // offset of the next field
+  size_t m_end{0};
+};
+
+// Reads the field at pos without allocating; false when it is malformed or
+// runs past size.
+bool readProtoField(const uint8_t* data, size_t size, size_t pos, ProtoWireField& field);
+// true when [begin, end) is a sequence of well formed fields
+bool isProtoMessage(const uint8_t* data, size_t begin, size_t end);
+
+struct ProtoEnum {
+  std::string m_name;
+  std::unordered_map<int32_t, std::string> m_values;
+};
+
+struct ProtoMessage;
+
+struct ProtoField {
+  std::string m_name;
+  uint32_t m_number{0};
+  ProtoType m_type{ProtoType::Bytes};
+  bool m_repeated{false};
+  // fully qualified name of a message or enum type, resolved after loading
+  std::string m_type_name;
+  const ProtoMessage* m_message{nullptr};
+  const ProtoEnum* m_enum{nullptr};
+};
+
+struct ProtoMessage {
+  std::string m_name;
+  // ordered by number
+  std::vector<ProtoField> m_fields;
+
+  const ProtoField* field(uint32_t number) const;
+};
+
+// Message types of a compiled FileDescriptorSet (protoc --include_imports
+// --descriptor_set_out) and which topics carry them. The descriptors are
+// read with the same wire decoder as the payloads, so no generated code or
+// protobuf library is needed.
+class ProtoSchema {
+ public:
+  bool load(const std::string& path, std::string& error);
+  // comma separated prefix=package.Message pairs, the longest matching
+  // topic path prefix wins
+  bool bind(const std::string& bindings, std::string& error);
+
+  bool empty() const { return m_messages.empty(); }
+  // by full name, with or without the leading dot
+  const ProtoMessage* message(const std::string& name) const;
+  // nullptr unless the topic path is bound to a type
+  const ProtoMessage* messageFor(const std::string& path) const;
+
+ private:
+  bool loadFile(const uint8_t* data, size_t begin, size_t end);
+  bool loadMessage(const uint8_t* data, size_t begin, size_t end, const std::string& scope);
+  bool loadEnum(const uint8_t* data, size_t begin, size_t end, const std::string& scope);
+  void resolve();
+
+  // deques keep the addresses the fields point at
+  std::deque<ProtoMessage> m_messages;
+  std::deque<ProtoEnum> m_enums;
+  std::unordered_map<std::string, const ProtoMessage*> m_message_index;
+  std::unordered_map<std::string, const ProtoEnum*> m_enum_index;
+  std::vector<std::pair<std::string, const ProtoMessage*>> m_bindings;
+};
+
+// Lazily decoded field tree of a protobuf message, with or without its type.
+// Creating it walks the top level fields only; a nested message, packed
+// array or group is decoded the first time its children are asked for and
+// kept from then on. Without a type a length delimited field counts as a
+// nested message when its content parses as one.
+class ProtoTree {
+ public:
+  static constexpr uint32_t kRoot = 0;
+  static constexpr uint32_t kNone = ~uint32_t(0);
+
+  struct Node {
+    uint32_t m_number{0};
+    WireType m_wire{WireType::Length};
+    uint64_t m_value{0};
+    uint32_t m_offset{0};
+    uint32_t m_length{0};
+    // schema of the field, nullptr when unknown
+    const ProtoField* m_field{nullptr};
+    // type of the content of the root and nested messages
+    const ProtoMessage* m_message{nullptr};
+    // element of a packed array, decoded as m_field's scalar type
+    bool m_packed{false};
+    uint32_t m_parent{kNone};
+    // children are contiguous once indexed
+    uint32_t m_first_child{kNone};
+    uint32_t m_children{0};
+    bool m_container{false};
+    bool m_indexed{false};
+    bool m_expanded{false};
+  };
+
+  // false and an empty tree unless the top level fields are well formed;
+  // data has to stay valid while the tree is used
+  bool reset(const uint8_t* data, size_t size, const ProtoMessage* type);
+  void clear();
+
+  bool empty() const { return m_nodes.empty(); }
+  const ProtoMessage* type() const { return m_type; }
+  const Node& node(uint32_t index) const { return m_nodes[index]; }
+  size_t size() const { return m_nodes.size(); }
+
+  // index of the first child, decoding them on first use; containers only
+  uint32_t children(uint32_t index);
+  void setExpanded(uint32_t index, bool expanded) { m_nodes[index].m_expanded = expanded; }
+
+  // "name: value" for display, containers show their size instead of content
+  std::string label(uint32_t index, size_t max_length) const;
+  // the whole message as indented text, decoding what is not decoded yet
+  std::string text();
+
+ private:
+  void indexFields(uint32_t index, size_t begin, size_t end, const ProtoMessage* type);
+  void indexPacked(uint32_t index);
+  void appendValue(std::string& out, const Node& node, size_t max_length) const;
+  void appendText(std::string& out, uint32_t index, int depth);
+
+  const uint8_t* m_data{nullptr};
+  size_t m_size{0};
+  const ProtoMessage* m_type{nullptr};
+  std::vector<Node> m_nodes;
+};
+
+#endif //DMON_PROTOBUF_H
@@ -0,0 +1,38 @@
+#ifndef DMON_RATE_H
+#define DMON_RATE_H
+
+#include <chrono>
+#include <cmath>
+
+// Exponentially decaying event rate. Every hit adds amount/tau and the sum
+// decays with time constant tau, so reading it gives a per second rate over
+// roughly the last tau seconds without keeping any history.
+class DecayingRate {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  void hit(Clock::time_point now, double amount = 1.0) {
+    m_value = decayed(now) + amount / kTau;
+    m_stamp = now;
+  }
+
+  double perSecond(Clock::time_point now) const {
+    return decayed(now);
+  }
+
+ private:
+  static constexpr double kTau = 5.0;
+
+  double decayed(Clock::time_point now) const {
+    if (m_value == 0.0) {
+      return 0.0;
+    }
+    double dt = std::chrono::duration<double>(now - m_stamp).count();
+    return dt > 0 ? m_value * std::exp(-dt / kTau) : m_value;
+  }
+
+  double m_value{0.0};
+  Clock::time_point m_stamp{};
+};
+
+#endif //DMON_RATE_H
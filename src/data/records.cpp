@@ -0,0 +1,107 @@
+#include "data/records.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "types/topic_types.h"
+
+namespace {
+constexpr uint8_t kRecordDelim = DPT_RECORD_DELIM;
+constexpr uint8_t kFieldDelim = DPT_FIELD_DELIM;
+
+bool isText(uint8_t c) {
+  return c >= 0x20 || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Calls delimiter(offset) for every delimiter in order; false as soon as a
+// control byte other than the delimiters and whitespace shows up.
+template <typename Delimiter>
+bool scan(const uint8_t* data, size_t size, Delimiter&& delimiter) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  // 16 bytes per step: one mask of the delimiters and one of the other
+  // control bytes; record data rarely has any, so most steps are two
+  // compares and a branch
+  const __m128i record = _mm_set1_epi8(kRecordDelim);
+  const __m128i field = _mm_set1_epi8(kFieldDelim);
+  const __m128i space = _mm_set1_epi8(0x1f);
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i lf = _mm_set1_epi8('\n');
+  const __m128i cr = _mm_set1_epi8('\r');
+  for (; i + 16 <= size; i += 16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(bytes, space), bytes);
+    if (_mm_movemask_epi8(control) == 0) {
+      continue;
+    }
+    __m128i delims = _mm_or_si128(_mm_cmpeq_epi8(bytes, record), _mm_cmpeq_epi8(bytes, field));
+    __m128i whitespace = _mm_or_si128(_mm_cmpeq_epi8(bytes, tab),
+                                      _mm_or_si128(_mm_cmpeq_epi8(bytes, lf), _mm_cmpeq_epi8(bytes, cr)));
+    if (_mm_movemask_epi8(_mm_andnot_si128(_mm_or_si128(delims, whitespace), control)) != 0) {
+      return false;
+    }
+    for (unsigned mask = _mm_movemask_epi8(delims); mask != 0; mask &= mask - 1) {
+      delimiter(i + __builtin_ctz(mask));
+    }
+  }
+#endif
+  for (; i < size; ++i) {
+    if (data[i] == kRecordDelim || data[i] == kFieldDelim) {
+      delimiter(i);
+    } else if (!isText(data[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+bool RecordIndex::reset(const char* data, size_t size) {
+  clear();
+  if (size == 0 || size > ~uint32_t(0)) {
+    return false;
+  }
+
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  m_field_begin.push_back(0);
+  m_record_begin.push_back(0);
+  bool text = scan(bytes, size, [this, bytes](size_t offset) {
+    m_field_begin.push_back(static_cast<uint32_t>(offset + 1));
+    if (bytes[offset] == kRecordDelim) {
+      m_record_begin.push_back(static_cast<uint32_t>(m_field_begin.size() - 1));
+    }
+  });
+  if (!text || m_field_begin.size() == 1) {
+    clear();
+    return false;
+  }
+  m_record_begin.push_back(static_cast<uint32_t>(m_field_begin.size()));
+
+  m_data = data;
+  m_size = size;
+  for (size_t record = 0; record < records(); ++record) {
+    m_columns = std::max(m_columns, fields(record));
+  }
+  return true;
+}
+
+void RecordIndex::clear() {
+  m_data = nullptr;
+  m_size = 0;
+  m_columns = 0;
+  m_field_begin.clear();
+  m_record_begin.clear();
+}
+
+std::string_view RecordIndex::field(size_t record, size_t field) const {
+  if (field >= fields(record)) {
+    return std::string_view();
+  }
+  size_t index = m_record_begin[record] + field;
+  size_t begin = m_field_begin[index];
+  size_t end = index + 1 < m_field_begin.size() ? m_field_begin[index + 1] - 1 : m_size;
+  return std::string_view(m_data + begin, end - begin);
+}
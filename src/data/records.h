@@ -0,0 +1,40 @@
+#ifndef DMON_RECORDS_H
+#define DMON_RECORDS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Records and fields of a Diffusion record topic payload, delimited by
+// DPT_RECORD_DELIM and DPT_FIELD_DELIM. The delimiters are found in one
+// vectorized pass and the offset of every field is kept, so any field of any
+// record is reached in constant time afterwards.
+class RecordIndex {
+ public:
+  // false and an empty index unless the payload looks like record data: it
+  // has delimiters and no control bytes besides them and whitespace; data
+  // has to stay valid while the index is used
+  bool reset(const char* data, size_t size);
+  void clear();
+
+  bool empty() const { return m_record_begin.empty(); }
+  size_t records() const { return m_record_begin.empty() ? 0 : m_record_begin.size() - 1; }
+  size_t fields(size_t record) const { return m_record_begin[record + 1] - m_record_begin[record]; }
+  // the most fields any record has
+  size_t columns() const { return m_columns; }
+
+  // empty past the last field of the record
+  std::string_view field(size_t record, size_t field) const;
+
+ private:
+  const char* m_data{nullptr};
+  size_t m_size{0};
+  size_t m_columns{0};
+  // offset of every field, a field ends one byte before the next one starts
+  std::vector<uint32_t> m_field_begin;
+  // index of the first field of every record and one past the last field
+  std::vector<uint32_t> m_record_begin;
+};
+
+#endif //DMON_RECORDS_H
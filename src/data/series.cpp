@@ -0,0 +1,452 @@
+#include "data/series.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "data/cbor.h"
+#include "data/session.h"
+#include "data/varint.h"
+
+namespace {
+// longest text taken for a number, single values are short
+constexpr size_t kMaxNumberText = 63;
+// a CBOR number is its initial byte and at most 8 bytes of argument
+constexpr size_t kMaxCborNumber = 9;
+constexpr int kMaxScale = 9;
+constexpr double kPow10[kMaxScale + 1] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+// fixed point values have to stay exact as doubles
+constexpr double kMaxFixed = 9007199254740992.0;
+
+bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+// [-+]digits[.digits][(e|E)[-+]digits], surrounding spaces allowed
+bool decodeText(const char* data, size_t size, double& value, int& decimals) {
+  size_t begin = 0;
+  size_t end = size;
+  while (begin < end && isSpace(data[begin])) {
+    ++begin;
+  }
+  while (end > begin && isSpace(data[end - 1])) {
+    --end;
+  }
+  if (begin == end || end - begin > kMaxNumberText) {
+    return false;
+  }
+
+  size_t i = begin;
+  if (data[i] == '-' || data[i] == '+') {
+    ++i;
+  }
+  size_t digits = 0;
+  for (; i < end && isDigit(data[i]); ++i) {
+    ++digits;
+  }
+  int fraction = 0;
+  if (i < end && data[i] == '.') {
+    for (++i; i < end && isDigit(data[i]); ++i) {
+      ++fraction;
+    }
+  }
+  if (digits + fraction == 0) {
+    return false;
+  }
+  bool exponent = false;
+  if (i < end && (data[i] == 'e' || data[i] == 'E')) {
+    ++i;
+    if (i < end && (data[i] == '-' || data[i] == '+')) {
+      ++i;
+    }
+    size_t first = i;
+    for (; i < end && isDigit(data[i]); ++i) {
+    }
+    if (i == first) {
+      return false;
+    }
+    exponent = true;
+  }
+  if (i != end) {
+    return false;
+  }
+
+  char text[kMaxNumberText + 1];
+  std::memcpy(text, data + begin, end - begin);
+  text[end - begin] = '\0';
+  value = std::strtod(text, nullptr);
+  decimals = exponent ? -1 : fraction;
+  return isFiniteDouble(value);
+}
+
+bool decodeCbor(const char* data, size_t size, double& value, int& decimals) {
+  if (size > kMaxCborNumber) {
+    return false;
+  }
+  // printable text is never taken for CBOR, where most of it would still be
+  // a small negative integer
+  if (std::all_of(data, data + size, [](char c) { return c >= 0x20 && c < 0x7f; })) {
+    return false;
+  }
+  CborReader reader(reinterpret_cast<const uint8_t*>(data), size);
+  CborItem item;
+  if (!reader.content(0, item) || item.m_data != size) {
+    return false;
+  }
+  switch (item.m_type) {
+    case CborItem::Type::Unsigned:
+      value = static_cast<double>(item.m_value);
+      decimals = 0;
+      return true;
+    case CborItem::Type::Negative:
+      value = -1.0 - static_cast<double>(item.m_value);
+      decimals = 0;
+      return true;
+    case CborItem::Type::Float:
+      value = item.m_float;
+      decimals = -1;
+      return isFiniteDouble(value);
+    default:
+      return false;
+  }
+}
+
+double fromFixed(uint64_t value, int scale) {
+  return static_cast<double>(static_cast<int64_t>(value)) / kPow10[scale];
+}
+
+// smallest scale at which every value is a fixed point number, -1 when there
+// is none. Release builds use -Ofast, which divides by multiplying with the
+// reciprocal, so decoding may be an ulp off the parsed value.
+int fixedScale(const std::vector<double>& values, int decimals) {
+  for (int scale = std::max(decimals, 0); scale <= kMaxScale; ++scale) {
+    double p = kPow10[scale];
+    bool exact = std::all_of(values.begin(), values.end(), [p, scale](double v) {
+      double scaled = v * p;
+      return std::fabs(scaled) < kMaxFixed &&
+             std::fabs(fromFixed(static_cast<uint64_t>(std::llround(scaled)), scale) - v) <=
+                 std::fabs(v) * 2 * DBL_EPSILON;
+    });
+    if (exact) {
+      return scale;
+    }
+  }
+  return -1;
+}
+}  // namespace
+
+bool decodeNumber(const char* data, size_t size, double& value, int& decimals) {
+  return decodeText(data, size, value, decimals) || decodeCbor(data, size, value, decimals);
+}
+
+void NumericSeries::Summary::add(const Summary& other) {
+  if (other.m_count == 0) {
+    return;
+  }
+  if (m_count == 0) {
+    *this = other;
+    return;
+  }
+  double n = static_cast<double>(m_count + other.m_count);
+  double delta = other.m_mean - m_mean;
+  m_mean += delta * other.m_count / n;
+  m_m2 += other.m_m2 + delta * delta * (static_cast<double>(m_count) * other.m_count / n);
+  m_min = std::min(m_min, other.m_min);
+  m_max = std::max(m_max, other.m_max);
+  m_count += other.m_count;
+}
+
+NumericSeries::Summary NumericSeries::summarize(const double* values, size_t n) {
+  Summary s;
+  if (n == 0) {
+    return s;
+  }
+  // branch free reductions over a plain array, the compiler turns them into
+  // SIMD min/max/add
+  double lo = values[0];
+  double hi = values[0];
+  double sum = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    double v = values[i];
+    lo = v < lo ? v : lo;
+    hi = v > hi ? v : hi;
+    sum += v;
+  }
+  double mean = sum / n;
+  double m2 = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    double d = values[i] - mean;
+    m2 += d * d;
+  }
+  s.m_count = n;
+  s.m_min = lo;
+  s.m_max = hi;
+  s.m_mean = mean;
+  s.m_m2 = m2;
+  return s;
+}
+
+void NumericSeries::append(int64_t time, double value, int decimals) {
+  m_times.push_back(time);
+  m_values.push_back(value);
+  m_last = value;
+  ++m_appended;
+  if (decimals < 0 || m_decimals < 0) {
+    m_decimals = -1;
+  } else {
+    m_decimals = std::max(m_decimals, decimals);
+  }
+  if (m_times.size() == kBlockSize) {
+    seal();
+  }
+}
+
+void NumericSeries::seal() {
+  Block block;
+  block.m_count = static_cast<uint32_t>(m_times.size());
+  block.m_scale = static_cast<int8_t>(fixedScale(m_values, m_decimals));
+  block.m_summary = summarize(m_values.data(), m_values.size());
+  block.m_bytes.reserve(m_times.size() * 4);
+
+  uint64_t previous_time = 0;
+  uint64_t previous_value = 0;
+  for (size_t i = 0; i < m_times.size(); ++i) {
+    uint64_t time = static_cast<uint64_t>(m_times[i]);
+    uint64_t value;
+    if (block.m_scale >= 0) {
+      value = static_cast<uint64_t>(std::llround(m_values[i] * kPow10[block.m_scale]));
+    } else {
+      std::memcpy(&value, &m_values[i], sizeof(value));
+    }
+    putVarint(block.m_bytes, zigzag(time - previous_time));
+    putVarint(block.m_bytes, zigzag(value - previous_value));
+    previous_time = time;
+    previous_value = value;
+  }
+  block.m_bytes.shrink_to_fit();
+
+  m_block_memory += sizeof(Block) + block.m_bytes.capacity();
+  m_sealed.add(block.m_summary);
+  m_blocks.push_back(std::move(block));
+  m_times.clear();
+  m_values.clear();
+  m_decimals = 0;
+
+  if (m_blocks.size() > kMaxBlocks) {
+    m_block_memory -= sizeof(Block) + m_blocks.front().m_bytes.capacity();
+    m_blocks.erase(m_blocks.begin());
+    m_sealed = Summary();
+    for (const auto& b : m_blocks) {
+      m_sealed.add(b.m_summary);
+    }
+  }
+}
+
+void NumericSeries::decode(const Block& block, std::vector<int64_t>& times, std::vector<double>& values) const {
+  times.resize(block.m_count);
+  values.resize(block.m_count);
+  const uint8_t* p = block.m_bytes.data();
+  uint64_t time = 0;
+  uint64_t value = 0;
+  for (uint32_t i = 0; i < block.m_count; ++i) {
+    time += unzigzag(getVarint(p));
+    value += unzigzag(getVarint(p));
+    times[i] = static_cast<int64_t>(time);
+    if (block.m_scale >= 0) {
+      values[i] = fromFixed(value, block.m_scale);
+    } else {
+      std::memcpy(&values[i], &value, sizeof(value));
+    }
+  }
+}
+
+SeriesStats NumericSeries::stats() const {
+  Summary s = m_sealed;
+  s.add(summarize(m_values.data(), m_values.size()));
+
+  SeriesStats stats;
+  stats.m_count = s.m_count;
+  if (s.m_count == 0) {
+    return stats;
+  }
+  stats.m_min = s.m_min;
+  stats.m_max = s.m_max;
+  stats.m_mean = s.m_mean;
+  stats.m_stddev = std::sqrt(s.m_m2 / s.m_count);
+  stats.m_last = m_last;
+  return stats;
+}
+
+void lttb(const SeriesPoint* points, size_t n, size_t threshold, std::vector<SeriesPoint>& out) {
+  out.clear();
+  if (threshold >= n || threshold < 3) {
+    out.assign(points, points + n);
+    return;
+  }
+  out.reserve(threshold);
+
+  // times relative to the first point keep their precision as doubles
+  int64_t origin = points[0].m_time;
+  auto x = [&](size_t i) { return static_cast<double>(points[i].m_time - origin); };
+  double every = static_cast<double>(n - 2) / (threshold - 2);
+  size_t a = 0;
+  out.push_back(points[0]);
+  for (size_t bucket = 0; bucket + 2 < threshold; ++bucket) {
+    size_t begin = static_cast<size_t>(bucket * every) + 1;
+    size_t end = static_cast<size_t>((bucket + 1) * every) + 1;
+    size_t next_end = std::min(static_cast<size_t>((bucket + 2) * every) + 1, n);
+
+    double avg_x = 0.0;
+    double avg_y = 0.0;
+    for (size_t i = end; i < next_end; ++i) {
+      avg_x += x(i);
+      avg_y += points[i].m_value;
+    }
+    size_t next = std::max<size_t>(next_end - end, 1);
+    avg_x /= next;
+    avg_y /= next;
+
+    double ax = x(a);
+    double ay = points[a].m_value;
+    double max_area = -1.0;
+    size_t chosen = begin;
+    for (size_t i = begin; i < end; ++i) {
+      double area = std::fabs((ax - avg_x) * (points[i].m_value - ay) - (ax - x(i)) * (avg_y - ay));
+      if (area > max_area) {
+        max_area = area;
+        chosen = i;
+      }
+    }
+    out.push_back(points[chosen]);
+    a = chosen;
+  }
+  out.push_back(points[n - 1]);
+}
+
+void SeriesOverview::reset() {
+  m_level.clear();
+  m_ready.clear();
+  m_pending.clear();
+  m_bucket = 1;
+  m_next = 0;
+}
+
+void SeriesOverview::update(const NumericSeries& series) {
+  // dropped by the store and started over
+  if (series.end() < m_next) {
+    reset();
+  }
+  series.forEachFrom(m_next, [this](int64_t time, double value) { push({time, value}); });
+  m_next = series.end();
+}
+
+void SeriesOverview::push(const SeriesPoint& point) {
+  m_pending.push_back(point);
+  if (m_pending.size() < m_bucket) {
+    return;
+  }
+
+  if (!m_ready.empty()) {
+    if (m_level.empty()) {
+      m_level.push_back(m_ready.front());
+    } else {
+      double avg_x = 0.0;
+      double avg_y = 0.0;
+      int64_t origin = m_level.back().m_time;
+      for (const auto& p : m_pending) {
+        avg_x += static_cast<double>(p.m_time - origin);
+        avg_y += p.m_value;
+      }
+      avg_x /= m_pending.size();
+      avg_y /= m_pending.size();
+
+      double ay = m_level.back().m_value;
+      double max_area = -1.0;
+      const SeriesPoint* chosen = &m_ready.front();
+      for (const auto& p : m_ready) {
+        double area = std::fabs(-avg_x * (p.m_value - ay) + static_cast<double>(p.m_time - origin) * (avg_y - ay));
+        if (area > max_area) {
+          max_area = area;
+          chosen = &p;
+        }
+      }
+      m_level.push_back(*chosen);
+    }
+  }
+  m_ready.swap(m_pending);
+  m_pending.clear();
+
+  if (m_level.size() >= 2 * kLevelPoints) {
+    std::vector<SeriesPoint> half;
+    lttb(m_level.data(), m_level.size(), kLevelPoints, half);
+    m_level.swap(half);
+    m_bucket *= 2;
+  }
+}
+
+void SeriesOverview::downsample(size_t width, std::vector<SeriesPoint>& out) const {
+  std::vector<SeriesPoint> points;
+  points.reserve(m_level.size() + m_ready.size() + m_pending.size());
+  points.insert(points.end(), m_level.begin(), m_level.end());
+  points.insert(points.end(), m_ready.begin(), m_ready.end());
+  points.insert(points.end(), m_pending.begin(), m_pending.end());
+  lttb(points.data(), points.size(), width, out);
+}
+
+void SeriesStore::update(const Topic& topic) {
+  double value;
+  int decimals;
+  if (!decodeNumber(topic.m_buffer.data(), topic.m_buffer.size(), value, decimals)) {
+    return;
+  }
+  auto time = std::chrono::duration_cast<std::chrono::microseconds>(topic.m_received.time_since_epoch());
+  auto it = m_series.find(topic.m_path);
+  if (it == m_series.end()) {
+    it = m_series.emplace(topic.m_path, Entry()).first;
+    m_lru.push_front(topic.m_path);
+    it->second.m_lru = m_lru.begin();
+  } else {
+    m_lru.splice(m_lru.begin(), m_lru, it->second.m_lru);
+  }
+  NumericSeries& series = it->second.m_series;
+  size_t before = series.memory();
+  series.append(time.count(), value, decimals);
+  m_memory = m_memory - before + series.memory();
+  evict();
+}
+
+void SeriesStore::evict() {
+  // the topic just updated is at the front and is never dropped
+  while (m_memory > m_budget && m_lru.size() > 1) {
+    auto it = m_series.find(m_lru.back());
+    m_memory -= it->second.m_series.memory();
+    m_series.erase(it);
+    m_lru.pop_back();
+  }
+}
+
+void SeriesStore::clear() {
+  m_series.clear();
+  m_lru.clear();
+  m_memory = 0;
+}
+
+const NumericSeries* SeriesStore::find(const std::string& path) const {
+  auto it = m_series.find(path);
+  return it == m_series.end() ? nullptr : &it->second.m_series;
+}
+
+const NumericSeries* SeriesStore::use(const std::string& path) {
+  auto it = m_series.find(path);
+  if (it == m_series.end()) {
+    return nullptr;
+  }
+  m_lru.splice(m_lru.begin(), m_lru, it->second.m_lru);
+  return &it->second.m_series;
+}
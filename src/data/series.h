@@ -0,0 +1,187 @@
+#ifndef DMON_SERIES_H
+#define DMON_SERIES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Topic;
+
+// Value of a single value topic: a CBOR number as INT64 and DOUBLE topics
+// carry it, or a number as text. decimals is the number of digits after the
+// point when the payload tells it, -1 otherwise.
+bool decodeNumber(const char* data, size_t size, double& value, int& decimals);
+
+struct SeriesPoint {
+  // microseconds since the epoch
+  int64_t m_time{0};
+  double m_value{0.0};
+};
+
+struct SeriesStats {
+  uint64_t m_count{0};
+  double m_min{0.0};
+  double m_max{0.0};
+  double m_mean{0.0};
+  double m_stddev{0.0};
+  double m_last{0.0};
+};
+
+// Update history of a numeric topic as (time, value) columns. The newest
+// points are kept as plain arrays; every kBlockSize of them are sealed into a
+// block of delta encoded varints, with the values as fixed point integers at
+// the block's decimal scale, or as raw IEEE bits when they have none. Every
+// block keeps a summary computed when it is sealed, so the statistics of the
+// whole history only combine summaries and scan the open tail.
+class NumericSeries {
+ public:
+  static constexpr size_t kBlockSize = 1024;
+  // oldest blocks are dropped past this, about 4M points
+  static constexpr size_t kMaxBlocks = 4096;
+
+  // time in microseconds since the epoch
+  void append(int64_t time, double value, int decimals);
+
+  size_t size() const { return m_sealed.m_count + m_times.size(); }
+  // number of points ever appended, the index the next one gets
+  uint64_t end() const { return m_appended; }
+  SeriesStats stats() const;
+  // encoded bytes plus the open tail
+  size_t memory() const { return m_block_memory + (m_times.capacity() + m_values.capacity()) * sizeof(double); }
+
+  // calls fn(time, value) for every point, oldest first
+  template <typename Fn>
+  void forEach(Fn&& fn) const {
+    forEachFrom(0, fn);
+  }
+  // same for the points from index on, blocks before it are not decoded
+  template <typename Fn>
+  void forEachFrom(uint64_t index, Fn&& fn) const;
+
+ private:
+  // count, mean and sum of squared deviations, combined with Chan's formula
+  // so the variance stays exact where sum/sum of squares would cancel out
+  struct Summary {
+    uint64_t m_count{0};
+    double m_min{0.0};
+    double m_max{0.0};
+    double m_mean{0.0};
+    double m_m2{0.0};
+
+    void add(const Summary& other);
+  };
+
+  struct Block {
+    std::vector<uint8_t> m_bytes;
+    uint32_t m_count{0};
+    // decimal scale of the fixed point values, -1 for raw bits
+    int8_t m_scale{-1};
+    Summary m_summary;
+  };
+
+  static Summary summarize(const double* values, size_t n);
+  void seal();
+  void decode(const Block& block, std::vector<int64_t>& times, std::vector<double>& values) const;
+
+  std::vector<Block> m_blocks;
+  size_t m_block_memory{0};
+  // summary of all blocks
+  Summary m_sealed;
+  std::vector<int64_t> m_times;
+  std::vector<double> m_values;
+  double m_last{0.0};
+  uint64_t m_appended{0};
+  // most decimals of the tail values, -1 once one of them is unknown
+  int m_decimals{0};
+};
+
+template <typename Fn>
+void NumericSeries::forEachFrom(uint64_t index, Fn&& fn) const {
+  std::vector<int64_t> times;
+  std::vector<double> values;
+  uint64_t first = m_appended - size();
+  for (const auto& block : m_blocks) {
+    if (first + block.m_count > index) {
+      decode(block, times, values);
+      for (size_t i = first < index ? index - first : 0; i < times.size(); ++i) {
+        fn(times[i], values[i]);
+      }
+    }
+    first += block.m_count;
+  }
+  for (size_t i = first < index ? index - first : 0; i < m_times.size(); ++i) {
+    fn(m_times[i], m_values[i]);
+  }
+}
+
+// Largest-Triangle-Three-Buckets: the first and last point and from each of
+// threshold - 2 buckets in between the one spanning the largest triangle with
+// the point chosen before it and the average of the next bucket. Keeps the
+// peaks a plain average would flatten.
+void lttb(const SeriesPoint* points, size_t n, size_t threshold, std::vector<SeriesPoint>& out);
+
+// Downsampled view of a series kept up to date point by point, for charts of
+// long histories. Points are bucketed as they arrive and every full bucket is
+// reduced to its LTTB point, so the cached level holds between kLevelPoints
+// and twice as many; when it is full it is downsampled by half and buckets
+// double in size. Drawing then only downsamples the level and the buckets in
+// progress, whatever the length of the history.
+class SeriesOverview {
+ public:
+  static constexpr size_t kLevelPoints = 4096;
+
+  void reset();
+  // takes the points appended to series since the last call
+  void update(const NumericSeries& series);
+  // the whole history in at most width points
+  void downsample(size_t width, std::vector<SeriesPoint>& out) const;
+  bool empty() const { return m_level.empty() && m_ready.empty() && m_pending.empty(); }
+
+ private:
+  void push(const SeriesPoint& point);
+
+  std::vector<SeriesPoint> m_level;
+  // full bucket waiting for the average of the next one
+  std::vector<SeriesPoint> m_ready;
+  std::vector<SeriesPoint> m_pending;
+  size_t m_bucket{1};
+  uint64_t m_next{0};
+};
+
+// Series of the topics whose payloads are numbers, fed with every update.
+// A topic gets a series with its first numeric value. When all series
+// together exceed the memory budget those of the least recently updated or
+// charted topics are dropped.
+class SeriesStore {
+ public:
+  explicit SeriesStore(size_t budget = 64 << 20) : m_budget(budget) {}
+
+  void update(const Topic& topic);
+  void clear();
+
+  // nullptr unless the topic had numeric values
+  const NumericSeries* find(const std::string& path) const;
+  // same and marks the topic as used
+  const NumericSeries* use(const std::string& path);
+  size_t size() const { return m_series.size(); }
+  size_t memory() const { return m_memory; }
+
+ private:
+  struct Entry {
+    NumericSeries m_series;
+    std::list<std::string>::iterator m_lru;
+  };
+
+  void evict();
+
+  size_t m_budget;
+  std::unordered_map<std::string, Entry> m_series;
+  // most recently used first
+  std::list<std::string> m_lru;
+  size_t m_memory{0};
+};
+
+#endif //DMON_SERIES_H
@@ -2,13 +2,19 @@
 // Created by apavlov on 25.01.25.
 //
 
+#include <algorithm>
 #include <mutex>
+#include <utility>
 #include <vector>
 #include <memory>
 #include "session.h"
 #include "spdlog/spdlog.h"
 #include "hexdump.h"
 
+extern "C" {
+#include "protocol-dpt.h"
+}
+
 std::string getSessionIdAsString(const SESSION_ID_T* session_id)
 {
     using unique_cstr_t = std::unique_ptr<char, decltype(&free)>;
@@ -132,7 +138,7 @@ std::string gen_random(const int len) {
 }
 
 
-Topic::Topic(const std::string& type, const std::string& path, const char* ptr, size_t len): m_topic_type(type), m_path(path) {
+Topic::Topic(const std::string& type, const std::string& path, const char* ptr, size_t len): m_topic_type(type), m_path(path), m_received(std::chrono::system_clock::now()) {
     m_buffer.reserve(len);
     if (ptr) {
         std::copy(ptr, ptr + len, std::back_inserter(m_buffer));
@@ -188,6 +194,10 @@ static void on_session_state_changed (
         const SESSION_STATE_T new_state)
 {
     spdlog::info("session {} changed state from {} to {}", getSessionIdAsString(session->id), state2String(old_state), state2String(new_state));
+    // no context yet while the session is being created
+    if (session->user_context) {
+        static_cast<Session*>(session->user_context)->onStateChanged(old_state, new_state);
+    }
 }
 
 static void on_session_handle_error() {
@@ -259,12 +269,16 @@ static int on_fetch_discard(struct session_s *session, void *context)
 /*
  * When a subscribed message is received, this callback is invoked.
  */
+template <size_t Selector>
 static int on_subscribe_topic_message(SESSION_T *session, const TOPIC_MESSAGE_T *message)
 {
+    int64_t arrived = monotonicNow();
     if (message) {
         spdlog::debug("session {} fetch topic {}", getSessionIdAsString(session->id), message->name);
         SES
-        ses->onSubscribeTopic(Topic(topicType2Str(message->type), message->name, message->payload->data, message->payload->len));
+        Topic topic(topicType2Str(message->type), message->name, message->payload->data, message->payload->len);
+        topic.m_arrived = arrived;
+        ses->onSubscribeTopic(Selector, std::move(topic));
         return HANDLER_SUCCESS;
     } else {
         spdlog::warn("session {} fetch topic without message", getSessionIdAsString(session->id));
@@ -272,6 +286,13 @@ static int on_subscribe_topic_message(SESSION_T *session, const TOPIC_MESSAGE_T
     return HANDLER_FAILURE;
 }
 
+template <size_t... Selectors>
+static constexpr std::array<TOPIC_HANDLER_T, sizeof...(Selectors)> topicHandlers(std::index_sequence<Selectors...>) {
+    return {&on_subscribe_topic_message<Selectors>...};
+}
+
+static constexpr auto subscribe_topic_handlers = topicHandlers(std::make_index_sequence<Session::kMaxSelectors>());
+
 /*
  * This callback is fired when Diffusion responds to say that a topic
  * subscription request has been received and processed.
@@ -348,6 +369,163 @@ static int on_subscribe_discard(struct session_s *session, void *context)
 }
 
 
+// ======== PING
+
+static int on_ping_response(SESSION_T *session, void *context)
+{
+    SES
+    ses->onPingResponse(reinterpret_cast<uintptr_t>(context));
+    return HANDLER_SUCCESS;
+}
+
+static int on_ping_error(SESSION_T *session, const DIFFUSION_ERROR_T *error)
+{
+    if (error != nullptr) {
+        spdlog::debug("session {} ping error {} message {}", getSessionIdAsString(session->id), error2Str(error->code), error->message);
+    }
+    return HANDLER_SUCCESS;
+}
+
+static int on_ping_discard(SESSION_T *session, void *context)
+{
+    spdlog::debug("session {} ping discard", getSessionIdAsString(session->id));
+    return HANDLER_SUCCESS;
+}
+
+// ======== TOPIC CONTROL AND UPDATES
+
+static int on_topic_added(SESSION_T *session, const SVC_ADD_TOPIC_RESPONSE_T *response, void *context)
+{
+    static_cast<Session*>(context)->onControlResult(true, std::string());
+    return HANDLER_SUCCESS;
+}
+
+static int on_topic_add_failed(SESSION_T *session, const SVC_ADD_TOPIC_RESPONSE_T *response, void *context)
+{
+    bool exists = response && response->reason == ADD_TOPIC_FAILURE_REASON_EXISTS;
+    static_cast<Session*>(context)->onControlResult(
+        exists, exists ? std::string() : "add topic failed, reason " + std::to_string(response ? response->reason : -1));
+    return HANDLER_SUCCESS;
+}
+
+static int on_topics_removed(SESSION_T *session, const SVC_REMOVE_TOPICS_RESPONSE_T *response, void *context)
+{
+    static_cast<Session*>(context)->onControlResult(true, std::string());
+    return HANDLER_SUCCESS;
+}
+
+static int on_control_error(SESSION_T *session, const DIFFUSION_ERROR_T *error)
+{
+    SES
+    ses->onControlResult(false, error ? error2Str(error->code) + ": " + error->message : std::string("error"));
+    return HANDLER_SUCCESS;
+}
+
+static int on_control_discard(SESSION_T *session, void *context)
+{
+    static_cast<Session*>(context)->onControlResult(false, "discarded");
+    return HANDLER_SUCCESS;
+}
+
+static int on_update_source_active(SESSION_T *session, const CONVERSATION_ID_T *updater_id,
+                                   const SVC_UPDATE_REGISTRATION_RESPONSE_T *response, void *context)
+{
+    static_cast<Session*>(context)->onControlResult(true, std::string());
+    return HANDLER_SUCCESS;
+}
+
+static int on_update_source_standby(SESSION_T *session, const CONVERSATION_ID_T *updater_id,
+                                    const SVC_UPDATE_REGISTRATION_RESPONSE_T *response, void *context)
+{
+    static_cast<Session*>(context)->onControlResult(false, "another update source is active");
+    return HANDLER_SUCCESS;
+}
+
+static int on_update_source_closed(SESSION_T *session, const CONVERSATION_ID_T *updater_id,
+                                   const SVC_UPDATE_REGISTRATION_RESPONSE_T *response, void *context)
+{
+    static_cast<Session*>(context)->onControlResult(false, "update source closed");
+    return HANDLER_SUCCESS;
+}
+
+static int on_update_success(SESSION_T *session, const CONVERSATION_ID_T *updater_id,
+                             const SVC_UPDATE_RESPONSE_T *response, void *context)
+{
+    return HANDLER_SUCCESS;
+}
+
+static int on_update_failure(SESSION_T *session, const CONVERSATION_ID_T *updater_id,
+                             const SVC_UPDATE_RESPONSE_T *response, void *context)
+{
+    static_cast<Session*>(context)->onUpdateFailed();
+    return HANDLER_SUCCESS;
+}
+
+static int on_update_error(SESSION_T *session, const DIFFUSION_ERROR_T *error)
+{
+    SES
+    ses->onUpdateFailed();
+    return HANDLER_SUCCESS;
+}
+
+static int on_update_discard(SESSION_T *session, void *context)
+{
+    static_cast<Session*>(context)->onUpdateFailed();
+    return HANDLER_SUCCESS;
+}
+
+// ======== MESSAGING
+
+static int on_msg_sent(SESSION_T *session, void *context)
+{
+    return HANDLER_SUCCESS;
+}
+
+static int on_msg_error(SESSION_T *session, const DIFFUSION_ERROR_T *error)
+{
+    SES
+    ses->onMessageFailed();
+    return HANDLER_SUCCESS;
+}
+
+static int on_msg_discard(SESSION_T *session, void *context)
+{
+    static_cast<Session*>(context)->onMessageFailed();
+    return HANDLER_SUCCESS;
+}
+
+static int on_echo_registered(SESSION_T *session, void *context)
+{
+    static_cast<Session*>(context)->onControlResult(true, std::string());
+    return HANDLER_SUCCESS;
+}
+
+// sends a message received by the handler back to the session it came from
+static int on_echo_message(SESSION_T *session, const SVC_SEND_RECEIVER_CLIENT_REQUEST_T *request, void *context)
+{
+    if (!request || !request->content) {
+        return HANDLER_FAILURE;
+    }
+    send_msg_to_session(session, (SEND_MSG_TO_SESSION_PARAMS_T){
+                                     .on_send = on_msg_sent,
+                                     .on_error = on_msg_error,
+                                     .on_discard = on_msg_discard,
+                                     .topic_path = request->topic_path,
+                                     .content = *request->content,
+                                     .options = request->send_options,
+                                     .session_id = request->session_id,
+                                     .context = context});
+    return HANDLER_SUCCESS;
+}
+
+static int on_msg_received(SESSION_T *session, const STREAM_MESSAGE_T *message, void *context)
+{
+    if (message && message->content.data) {
+        static_cast<Session*>(context)->onMessage(message->content.data->data, message->content.data->len);
+    }
+    return HANDLER_SUCCESS;
+}
+
 // ======== UNSUBSCRIBE
 
 /*
@@ -387,6 +565,7 @@ Session::Session() : m_session(nullptr)
       , m_fetch_error_callback(nullptr)
       , m_fetch_in_progress(false)
       , m_subscribe_in_progress(false)
+      , m_selector_sketches(kMaxSelectors)
 {
 
 }
@@ -395,11 +574,24 @@ Session::~Session()
 {
     spdlog::info("close session handler");
 
+    if (m_ping_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lk(m_ping_mutex);
+            m_ping_stop = true;
+        }
+        m_ping_cv.notify_one();
+        m_ping_thread.join();
+    }
+
     if (m_credentials) {
         spdlog::info("close session {} free credentials", m_session?getSessionIdAsString(m_session->id):"???");
         credentials_free(m_credentials);
     }
 
+    if (m_updater_id) {
+        conversation_id_free(m_updater_id);
+    }
+
     if (m_session) {
         spdlog::info("close session {}", getSessionIdAsString(m_session->id));
         DIFFUSION_ERROR_T error;
@@ -433,6 +625,7 @@ bool Session::connect(const std::string& url, const std::string& principal, cons
         session->global_topic_handler = on_unexpected_topic_message;
         session->global_service_error_handler = on_global_error;
         session->user_context = this;
+        m_state.store(session_state_get(session), std::memory_order_relaxed);
         spdlog::info("session connected {}", getSessionIdAsString(session->id));
     }
     else {
@@ -444,6 +637,13 @@ bool Session::connect(const std::string& url, const std::string& principal, cons
     return m_session != nullptr;
 }
 
+void Session::onStateChanged(SESSION_STATE_T old_state, SESSION_STATE_T new_state) {
+    if (new_state == RECOVERING_RECONNECT && old_state != RECOVERING_RECONNECT) {
+        m_reconnects.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_state.store(new_state, std::memory_order_relaxed);
+}
+
 bool Session::fetch(const std::string& selector)
 {
     // for testing purposes only
@@ -486,6 +686,192 @@ bool Session::fetch(const std::string& selector)
 }
 
 
+void Session::startPing(std::chrono::milliseconds interval, std::chrono::milliseconds timeout) {
+    if (!m_session || m_ping_thread.joinable()) {
+        return;
+    }
+    m_ping_thread = std::thread([this, interval, timeout]() {
+        int64_t timeout_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+        std::unique_lock<std::mutex> lk(m_ping_mutex);
+        while (!m_ping_cv.wait_for(lk, interval, [this] { return m_ping_stop; })) {
+            uint64_t sequence = m_ping.next(monotonicNow(), timeout_ns);
+            if (sequence != 0) {
+                PING_USER_PARAMS_T params{};
+                params.on_ping_response = &on_ping_response;
+                params.on_error = &on_ping_error;
+                params.on_discard = &on_ping_discard;
+                params.context = reinterpret_cast<void*>(static_cast<uintptr_t>(sequence));
+                ping_user(m_session, params);
+            }
+        }
+    });
+}
+
+void Session::onPingResponse(uint64_t sequence) {
+    m_ping.reply(sequence, monotonicNow());
+}
+
+bool Session::addTopic(const std::string& path, ControlCallback&& callback) {
+    if (!m_session) {
+        return false;
+    }
+    m_control_callback = std::move(callback);
+    TOPIC_DETAILS_T* details = create_topic_details_single_value(M_DATA_TYPE_STRING);
+    ADD_TOPIC_PARAMS_T params{};
+    params.on_topic_added = &on_topic_added;
+    params.on_topic_add_failed = &on_topic_add_failed;
+    params.on_error = &on_control_error;
+    params.on_discard = &on_control_discard;
+    params.topic_path = path.c_str();
+    params.details = details;
+    params.context = this;
+    ::add_topic(m_session, params);
+    topic_details_free(details);
+    return true;
+}
+
+bool Session::removeTopics(const std::string& selector, ControlCallback&& callback) {
+    if (!m_session) {
+        return false;
+    }
+    m_control_callback = std::move(callback);
+    REMOVE_TOPICS_PARAMS_T params{};
+    params.on_removed = &on_topics_removed;
+    params.on_error = &on_control_error;
+    params.on_discard = &on_control_discard;
+    params.topic_selector = selector.c_str();
+    params.context = this;
+    ::remove_topics(m_session, params);
+    return true;
+}
+
+bool Session::registerUpdateSource(const std::string& path, ControlCallback&& callback) {
+    if (!m_session || m_updater_id) {
+        return false;
+    }
+    m_control_callback = std::move(callback);
+    UPDATE_SOURCE_REGISTRATION_PARAMS_T params{};
+    params.on_active = &on_update_source_active;
+    params.on_standby = &on_update_source_standby;
+    params.on_close = &on_update_source_closed;
+    params.on_error = &on_control_error;
+    params.on_discard = &on_control_discard;
+    params.topic_path = path.c_str();
+    params.context = this;
+    m_updater_id = ::register_update_source(m_session, params);
+    return m_updater_id != nullptr;
+}
+
+bool Session::update(const std::string& path, const char* data, size_t size) {
+    if (!m_session || !m_updater_id) {
+        return false;
+    }
+    BUF_T* buf = buf_create();
+    buf_write_bytes(buf, data, size);
+    CONTENT_T* content = content_create(CONTENT_ENCODING_NONE, buf);
+    UPDATE_T* upd = update_create(UPDATE_ACTION_REFRESH, UPDATE_TYPE_CONTENT, content);
+    UPDATE_SOURCE_PARAMS_T params{};
+    params.on_success = &on_update_success;
+    params.on_failure = &on_update_failure;
+    params.on_error = &on_update_error;
+    params.on_discard = &on_update_discard;
+    params.updater_id = m_updater_id;
+    params.topic_path = path.c_str();
+    params.update = upd;
+    params.context = this;
+    ::update(m_session, params);
+    update_free(upd);
+    content_free(content);
+    buf_free(buf);
+    return true;
+}
+
+bool Session::registerEcho(const std::string& path, ControlCallback&& callback) {
+    if (!m_session) {
+        return false;
+    }
+    m_control_callback = std::move(callback);
+    MSG_RECEIVER_REGISTRATION_PARAMS_T params{};
+    params.on_registered = &on_echo_registered;
+    params.on_message = &on_echo_message;
+    params.on_error = &on_control_error;
+    params.on_discard = &on_control_discard;
+    params.topic_path = path.c_str();
+    params.context = this;
+    register_msg_handler(m_session, params);
+    return true;
+}
+
+void Session::setMessageListener(const std::string& path, MessageCallback&& callback) {
+    m_message_callback = std::move(callback);
+    if (m_session) {
+        register_msg_listener(m_session, (MSG_LISTENER_REGISTRATION_PARAMS_T){
+                                             .topic_path = path.c_str(),
+                                             .listener = on_msg_received,
+                                             .context = this});
+    }
+}
+
+bool Session::sendMessage(const std::string& path, const char* data, size_t size) {
+    if (!m_session) {
+        return false;
+    }
+    // the payload is only read while the message is queued
+    send_msg(m_session, (SEND_MSG_PARAMS_T){
+                            .on_send = on_msg_sent,
+                            .on_error = on_msg_error,
+                            .on_discard = on_msg_discard,
+                            .topic_path = path.c_str(),
+                            .payload = BUF_T{const_cast<char*>(data), size},
+                            .headers = nullptr,
+                            .priority = CLIENT_SEND_PRIORITY_NORMAL,
+                            .context = this});
+    return true;
+}
+
+bool Session::usesDummyTransport() const {
+    if (m_session == nullptr || m_session->transport == nullptr) {
+        return false;
+    }
+    TRANSPORT_T dummy;
+    memset(&dummy, 0, sizeof(dummy));
+    dummy_transport_create(&dummy);
+    const TRANSPORT_T* transport = m_session->transport;
+    bool same = transport->connect == dummy.connect && transport->start == dummy.start &&
+                transport->close == dummy.close && transport->notify_data_to_send == dummy.notify_data_to_send;
+    if (dummy.impl_free) {
+        dummy.impl_free(&dummy);
+    }
+    return same;
+}
+
+bool Session::route(MESSAGE_TYPE_T type, const std::string& header, const char* data, size_t size) {
+    if (!m_session) {
+        return false;
+    }
+    MESSAGE_T* message = dpt_message_create(type);
+    if (message->headers == nullptr) {
+        message->headers = list_create();
+    }
+    list_append_last(message->headers, strdup(header.c_str()));
+    if (message->payload == nullptr) {
+        message->payload = buf_create();
+    }
+    buf_write_bytes(message->payload, data, size);
+    route_message(m_session, message);
+    dpt_message_free(message);
+    return true;
+}
+
+void Session::onControlResult(bool ok, std::string&& error) {
+    // an error may be followed by a discard of the same request
+    ControlCallback callback = std::move(m_control_callback);
+    m_control_callback = nullptr;
+    if (callback) {
+        callback(ok, std::move(error));
+    }
+}
+
 bool Session::subscribe(const std::string& selector)
 {
     // for testing purposes only
@@ -504,7 +890,7 @@ bool Session::subscribe(const std::string& selector)
     if (m_session  && !m_fetch_in_progress) {
         SUBSCRIPTION_PARAMS_T params;
         params.on_subscribe = &on_subscribe;
-        params.on_topic_message = &on_subscribe_topic_message;
+        params.on_topic_message = subscribe_topic_handlers[selectorSlot(selector)];
         params.topic_selector = selector.c_str();
         params.on_error = &on_subscribe_error;
         params.on_discard = &on_subscribe_discard;
@@ -555,6 +941,7 @@ bool Session::notify() {
 
 
 void Session::onFetchTopic(Topic&& t) {
+  t.m_stats_slot = m_topic_stats.find(t.m_path);
   std::lock_guard<std::mutex> lk(m_operationMutex);
   m_topics.push_back(std::move(t));
 }
@@ -624,23 +1011,95 @@ void Session::setOnTopicSubscriptionEvent(TopicSubscriptionEvent&& tse) {
 }
 
 void Session::onTopicSubscriptionEvent(SubscriptionNotification&& ts) {
+    if (ts.m_reason != REASON_SUBSCRIBE) {
+      // a later subscription starts with a TOPIC_LOAD again
+      m_deltas.forget(ts.m_path);
+    }
     m_topic_subscription_events.push_back(std::move(ts));
     if (m_topic_subscription_event) {
       m_topic_subscription_event();
     }
 }
 
-void Session::onSubscribeTopic(Topic&& t) {
-    std::string sel;
+void Session::onSubscribeTopic(size_t selector, Topic&& t) {
+    auto now = monotonicNow();
+    m_selector_counters[selector].record(t.m_buffer.size(), now);
+    m_hot_topics.record(t.m_path, t.m_buffer.size());
+    {
+      uint64_t hash = hashPath(t.m_path);
+      std::lock_guard<std::mutex> lk(m_sketch_mutex);
+      m_sketches.record(hash, t.m_buffer.size(), now);
+      m_selector_sketches[selector].record(hash, t.m_buffer.size(), now);
+    }
+    // rates and sizes above count what came over the wire, everything below
+    // sees full values
+    if (!m_headless || m_topic_callback) {
+      m_deltas.decode(t);
+    }
+    if (m_headless) {
+      // nothing is queued without a UI, ingest ends with the bookkeeping
+      m_latency.record(LatencyStage::Ingest, monotonicNow() - t.m_arrived);
+      if (m_topic_callback) {
+        m_topic_callback(t);
+      }
+      return;
+    }
+
+    t.m_stats_slot = m_topic_stats.slot(t.m_path);
+    if (auto counters = m_topic_stats.counters(t.m_stats_slot)) {
+      counters->record(t.m_buffer.size(), now);
+    }
+
+    t.m_queued = monotonicNow();
+    m_latency.record(LatencyStage::Ingest, t.m_queued - t.m_arrived);
+    bool announce;
     {
       std::lock_guard<std::mutex> lk(m_operationMutex);
-      m_subscrube_topics.push_back(std::move(t));
-      //sel = std::move(m_selector);
-      //m_selector.clear();
+      auto& updates = m_subscrube_topics.m_updates;
+      auto& latest = m_subscrube_topics.m_latest;
+      uint32_t index = static_cast<uint32_t>(updates.size());
+      uint32_t slot = t.m_stats_slot;
+      if (slot != TopicStats::kNoSlot && slot >= m_batch_slots.size()) {
+        m_batch_slots.resize(slot + 1);
+      }
+      // a topic updated again within the batch: the new update stands for
+      // the earlier ones too
+      BatchSlot* batched = slot != TopicStats::kNoSlot ? &m_batch_slots[slot] : nullptr;
+      if (batched && batched->m_batch == m_batch_number) {
+        t.m_updates += updates[latest[batched->m_latest]].m_updates;
+        latest[batched->m_latest] = index;
+      } else {
+        if (batched) {
+          *batched = BatchSlot{m_batch_number, static_cast<uint32_t>(latest.size())};
+        }
+        latest.push_back(index);
+      }
+      updates.push_back(std::move(t));
+      m_queue_depth.store(updates.size(), std::memory_order_relaxed);
+      if (updates.size() > m_queue_peak.load(std::memory_order_relaxed)) {
+        m_queue_peak.store(updates.size(), std::memory_order_relaxed);
+      }
+      // once per batch, whoever takes it takes the updates queued until
+      // then; a subscription in progress hands them over when it completes
+      announce = !m_batch_announced && !m_subscribe_in_progress;
+      m_batch_announced = m_batch_announced || announce;
+    }
+    if (announce && m_subscribe_batch_callback) {
+      m_subscribe_batch_callback();
     }
-    if (!isSubscribtionInProgress() && m_subscribe_completed_callback) {
-      m_subscribe_completed_callback(std::move(sel)); // call to append new elements
+}
+
+size_t Session::selectorSlot(const std::string& selector) {
+    auto it = std::find(m_selectors.begin(), m_selectors.end(), selector);
+    if (it != m_selectors.end()) {
+      return it - m_selectors.begin();
+    }
+    if (m_selectors.size() < kMaxSelectors) {
+      m_selectors.push_back(selector);
+    } else if (m_selectors.back().find(" (+others)") == std::string::npos) {
+      m_selectors.back() += " (+others)";
     }
+    return m_selectors.size() - 1;
 }
 
 void Session::onSubscribeCompleted() {
@@ -669,4 +1128,8 @@ void Session::onSubscribeError(Error error) {
 
 void Session::setSubscribeCompletedCallback(SubscribeCompleted&& cb) {
     m_subscribe_completed_callback = std::move(cb);
+}
+
+void Session::setSubscribeBatchCallback(SubscribeBatch&& cb) {
+    m_subscribe_batch_callback = std::move(cb);
 }
\ No newline at end of file
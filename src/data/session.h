@@ -5,14 +5,25 @@
 #ifndef DMON_SESSION_H
 #define DMON_SESSION_H
 
+#include <array>
+#include <atomic>
 #include <string>
+#include <chrono>
 #include <functional>
 #include <mutex>
 #include <condition_variable>
+#include <thread>
 
 #include "diffusion.h"
+#include "data/delta.h"
+#include "data/hot_topics.h"
+#include "data/latency.h"
+#include "data/ping.h"
+#include "data/sketches.h"
+#include "data/topic_stats.h"
 
 std::string error2Str(ERROR_CODE_T ec);
+std::string state2String(SESSION_STATE_T st);
 
 enum SubscriptionReason : int {
   REASON_SUBSCRIBE = 100500,
@@ -59,10 +70,34 @@ struct Topic {
   std::string m_topic_type;
   std::string m_path;
   std::vector<char> m_buffer;
+  std::chrono::system_clock::time_point m_received;
+  uint64_t m_updates{1};
+  uint32_t m_stats_slot{TopicStats::kNoSlot};
+  // filled from the sampled counters of m_stats_slot
+  float m_msg_rate{0.0f};
+  float m_byte_rate{0.0f};
+  // monotonicNow() when the topic handler got the message and when it was
+  // queued for the UI, 0 for fetched topics
+  int64_t m_arrived{0};
+  int64_t m_queued{0};
   Topic(const std::string& type, const std::string& path, const char* ptr, size_t len);
   Topic(const Topic&) = default;
   Topic() =default;
   Topic(Topic&&) = default;
+  Topic& operator=(Topic&&) = default;
+};
+
+// Subscribed updates handed to the UI together. Every update is kept for
+// what needs all of them, the latency, the series and the history; the topic
+// list and the tree only need the latest value of a topic, which carries the
+// number of updates of the topic in the batch.
+struct SubscriptionBatch {
+  std::vector<Topic> m_updates;
+  // indices into m_updates of the latest update of every topic, in the order
+  // the topics first came
+  std::vector<uint32_t> m_latest;
+
+  bool empty() const { return m_updates.empty(); }
 };
 
 struct SubscriptionNotification {
@@ -73,11 +108,22 @@ struct SubscriptionNotification {
 
 class Session {
 public:
+  // Topic handlers get no context, so every subscribed selector gets its own
+  // handler instance which knows the selector it counts for. Selectors past
+  // this limit share the last one.
+  static constexpr size_t kMaxSelectors = 32;
+
   using FetchCompleted = std::function<void(std::string&&)>;
   using ErrorCallback = std::function<void(Error)>;
   using FetchStart = std::function<void()>;
   using TopicSubscriptionEvent = std::function<void()>;
+  // with the selector when a subscription completes
   using SubscribeCompleted = std::function<void(std::string&&)>;
+  // when the first update of a batch is queued, see getSubscribeTopics()
+  using SubscribeBatch = std::function<void()>;
+  using TopicCallback = std::function<void(const Topic&)>;
+  using ControlCallback = std::function<void(bool, std::string&&)>;
+  using MessageCallback = std::function<void(const char*, size_t)>;
 
   Session();
 
@@ -100,6 +146,18 @@ public:
   void setSubscribeErrorCallback(ErrorCallback&&);
 
 
+  // the state listener runs on the library's threads, readers anywhere
+  void onStateChanged(SESSION_STATE_T old_state, SESSION_STATE_T new_state);
+
+  SESSION_STATE_T getState() const {
+    return m_state.load(std::memory_order_relaxed);
+  }
+
+  // recoveries started after the connection was lost
+  uint64_t getReconnects() const {
+    return m_reconnects.load(std::memory_order_relaxed);
+  }
+
   std::string getAddress() const {
     return m_principal + "@" + m_url;
   }
@@ -119,11 +177,25 @@ public:
   bool notify();
 
 
-  std::vector<Topic> getSubscribeTopics() {
+  // the updates since the last call, a new batch starts
+  SubscriptionBatch getSubscribeTopics() {
     std::lock_guard<std::mutex> lk(m_operationMutex);
+    m_queue_depth.store(0, std::memory_order_relaxed);
+    ++m_batch_number;
+    m_batch_announced = false;
     return std::move(m_subscrube_topics);
   }
 
+  // subscribed topics queued for the UI and the most there ever were; the
+  // queue is not bounded, nothing is dropped from it
+  size_t getQueueDepth() const {
+    return m_queue_depth.load(std::memory_order_relaxed);
+  }
+
+  size_t getQueuePeak() const {
+    return m_queue_peak.load(std::memory_order_relaxed);
+  }
+
   std::vector<Topic> getFetchTopics() {
     std::lock_guard<std::mutex> lk(m_operationMutex);
     return std::move(m_topics);
@@ -133,9 +205,10 @@ public:
     m_subscribe_start_callback = std::move(ssc);
   }
 
-  void onSubscribeTopic(Topic&&);
+  void onSubscribeTopic(size_t selector, Topic&&);
   void onSubscribeCompleted();
   void setSubscribeCompletedCallback(SubscribeCompleted&&);
+  void setSubscribeBatchCallback(SubscribeBatch&&);
 
   void setOnTopicSubscriptionEvent(TopicSubscriptionEvent&&);
   void onTopicSubscriptionEvent(SubscriptionNotification&&);
@@ -145,17 +218,135 @@ public:
     return m_subscribe_in_progress;
   }
 
+  const TopicStats& getTopicStats() const {
+    return m_topic_stats;
+  }
+
+  std::vector<std::string> getSelectors() {
+    std::lock_guard<std::mutex> lk(m_operationMutex);
+    return m_selectors;
+  }
+
+  const Counters& getSelectorCounters(size_t selector) const {
+    return m_selector_counters[selector];
+  }
+
+  // approximate statistics of all subscribed messages
+  StreamSummary getStreamSummary() {
+    std::lock_guard<std::mutex> lk(m_sketch_mutex);
+    return m_sketches.summary();
+  }
+
+  StreamSummary getSelectorSummary(size_t selector) {
+    std::lock_guard<std::mutex> lk(m_sketch_mutex);
+    return m_selector_sketches[selector].summary();
+  }
+
+  HotTopics& getHotTopics() {
+    return m_hot_topics;
+  }
+
+  // deltas turned into full values and deltas which came without a value
+  const DeltaDecoder& getDeltas() const {
+    return m_deltas;
+  }
+
+  // stages of subscribed messages from the topic handler to the screen
+  PipelineLatency& getLatency() {
+    return m_latency;
+  }
+
+  // Pings the server every interval from a thread of its own until the
+  // session is destroyed; a ping without a reply for timeout is lost.
+  void startPing(std::chrono::milliseconds interval, std::chrono::milliseconds timeout);
+  void onPingResponse(uint64_t sequence);
+
+  const PingProbe& getPing() const {
+    return m_ping;
+  }
+
+  // Topic control and updates for the benchmarks, one request at a time; its
+  // outcome, true or false and an error, goes to the callback on the
+  // callback thread. An existing topic is fine to add, an update source is
+  // registered once it is active.
+  bool addTopic(const std::string& path, ControlCallback&& callback);
+  bool removeTopics(const std::string& selector, ControlCallback&& callback);
+  bool registerUpdateSource(const std::string& path, ControlCallback&& callback);
+  // sets the value of a topic below the active update source
+  bool update(const std::string& path, const char* data, size_t size);
+  // Messaging for the benchmarks: messages sent to the path by any session
+  // are sent back to their sender once the echo is registered, messages
+  // sent to this session on the path go to the listener
+  bool registerEcho(const std::string& path, ControlCallback&& callback);
+  void setMessageListener(const std::string& path, MessageCallback&& callback);
+  bool sendMessage(const std::string& path, const char* data, size_t size);
+  // Hands a DPT message to the client library as if the transport had read
+  // it, for in-process benchmarks over the dummy transport; the handlers of
+  // subscriptions and fetches run on the calling thread.
+  bool route(MESSAGE_TYPE_T type, const std::string& header, const char* data, size_t size);
+  // whether the client library put the session on its dummy transport, which
+  // sends and reads nothing: its functions are the ones
+  // dummy_transport_create sets up
+  bool usesDummyTransport() const;
+
+  void onMessage(const char* data, size_t size) {
+    if (m_message_callback) {
+      m_message_callback(data, size);
+    }
+  }
+  void onMessageFailed() {
+    m_message_failures.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  uint64_t getMessageFailures() const {
+    return m_message_failures.load(std::memory_order_relaxed);
+  }
+
+  void onControlResult(bool ok, std::string&& error);
+  void onUpdateFailed() {
+    m_update_failures.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  uint64_t getUpdateFailures() const {
+    return m_update_failures.load(std::memory_order_relaxed);
+  }
+
+  // Without a UI nothing takes the subscribed topics away, so they are not
+  // kept, and exact per topic counters are replaced by the hot topics sketch.
+  void setHeadless(bool headless) {
+    m_headless = headless;
+  }
+
+  // sees every subscribed message in headless mode, on the callback thread
+  void setTopicCallback(TopicCallback&& callback) {
+    m_topic_callback = std::move(callback);
+  }
+
   ~Session();
   Session(const Session&) = delete;
   Session& operator=(const Session) = delete;
  private:
+  size_t selectorSlot(const std::string& selector);
+
   std::string m_url;
   std::string m_principal;
   std::string m_password;
   SESSION_T* m_session;
   CREDENTIALS_T *m_credentials;
+  std::atomic<SESSION_STATE_T> m_state{SESSION_STATE_UNKNOWN};
+  std::atomic<uint64_t> m_reconnects{0};
   std::vector<Topic> m_topics;
-  std::vector<Topic> m_subscrube_topics;
+  SubscriptionBatch m_subscrube_topics;
+  // by stats slot, where the topic is in m_latest if it is in the batch
+  struct BatchSlot {
+    uint64_t m_batch{0};
+    uint32_t m_latest{0};
+  };
+  std::vector<BatchSlot> m_batch_slots;
+  uint64_t m_batch_number{1};
+  bool m_batch_announced{false};
+  std::atomic<size_t> m_queue_depth{0};
+  std::atomic<size_t> m_queue_peak{0};
   FetchCompleted m_fetch_completed_callback;
   ErrorCallback m_fetch_error_callback;
   ErrorCallback m_subscribe_error_callback;
@@ -170,7 +361,30 @@ public:
   TopicSubscriptionEvent m_topic_subscription_event;
   std::vector<SubscriptionNotification> m_topic_subscription_events;
   SubscribeCompleted m_subscribe_completed_callback;
+  SubscribeBatch m_subscribe_batch_callback;
   std::function<void()> m_subscribe_start_callback;
+  // written on the callback thread only
+  TopicStats m_topic_stats;
+  std::vector<std::string> m_selectors;
+  std::array<Counters, kMaxSelectors> m_selector_counters;
+  HotTopics m_hot_topics;
+  DeltaDecoder m_deltas;
+  PipelineLatency m_latency;
+  std::mutex m_sketch_mutex;
+  StreamSketches m_sketches;
+  std::vector<StreamSketches> m_selector_sketches;
+  bool m_headless{false};
+  TopicCallback m_topic_callback;
+  ControlCallback m_control_callback;
+  CONVERSATION_ID_T* m_updater_id{nullptr};
+  std::atomic<uint64_t> m_update_failures{0};
+  MessageCallback m_message_callback;
+  std::atomic<uint64_t> m_message_failures{0};
+  PingProbe m_ping;
+  std::thread m_ping_thread;
+  std::mutex m_ping_mutex;
+  std::condition_variable m_ping_cv;
+  bool m_ping_stop{false};
 };
 
 #endif //DMON_SESSION_H
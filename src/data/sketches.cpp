@@ -0,0 +1,136 @@
+#include "data/sketches.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+double HyperLogLog::estimate() const {
+  constexpr double m = kRegisters;
+  double sum = 0.0;
+  size_t zeros = 0;
+  for (auto r : m_registers) {
+    sum += std::ldexp(1.0, -r);
+    zeros += r == 0;
+  }
+
+  double alpha = 0.7213 / (1.0 + 1.079 / m);
+  double e = alpha * m * m / sum;
+  // linear counting is more precise while many registers are still empty
+  if (e <= 2.5 * m && zeros != 0) {
+    e = m * std::log(m / zeros);
+  }
+  return e;
+}
+
+DDSketch::DDSketch(double relative_accuracy)
+    : m_gamma((1.0 + relative_accuracy) / (1.0 - relative_accuracy)),
+      m_inv_log_gamma(1.0 / std::log(m_gamma)) {}
+
+int DDSketch::index(double value) const {
+  return static_cast<int>(std::ceil(std::log(value) * m_inv_log_gamma));
+}
+
+double DDSketch::lowerBound(int index) const {
+  // the value returned for a bucket is the one with the smallest relative
+  // error to anything in (gamma^(i-1), gamma^i]
+  return 2.0 * std::pow(m_gamma, index) / (m_gamma + 1.0);
+}
+
+void DDSketch::add(double value) {
+  if (m_count == 0) {
+    m_min = m_max = value;
+  } else {
+    m_min = std::min(m_min, value);
+    m_max = std::max(m_max, value);
+  }
+  ++m_count;
+
+  if (value <= kMinValue) {
+    ++m_zero;
+    return;
+  }
+
+  int i = index(value);
+  if (m_empty) {
+    // room in both directions until the range of values is known
+    m_offset = i - kBuckets / 2;
+    m_highest = i;
+    m_empty = false;
+  }
+
+  if (i < m_offset) {
+    if (m_highest - i < kBuckets) {
+      // slide the window down, nothing has to be collapsed
+      int shift = m_offset - i;
+      memmove(&m_counts[shift], &m_counts[0], (kBuckets - shift) * sizeof(m_counts[0]));
+      memset(&m_counts[0], 0, shift * sizeof(m_counts[0]));
+      m_offset = i;
+    } else {
+      i = m_offset;
+    }
+  } else if (i >= m_offset + kBuckets) {
+    // slide the window up, collapsing the buckets falling off its bottom
+    int shift = i - (m_offset + kBuckets - 1);
+    if (shift >= kBuckets) {
+      uint64_t all = 0;
+      for (auto c : m_counts) {
+        all += c;
+      }
+      m_counts.fill(0);
+      m_counts[0] = all;
+    } else {
+      uint64_t collapsed = 0;
+      for (int b = 0; b <= shift; ++b) {
+        collapsed += m_counts[b];
+      }
+      memmove(&m_counts[0], &m_counts[shift], (kBuckets - shift) * sizeof(m_counts[0]));
+      memset(&m_counts[kBuckets - shift], 0, shift * sizeof(m_counts[0]));
+      m_counts[0] = collapsed;
+    }
+    m_offset += shift;
+  }
+
+  m_highest = std::max(m_highest, i);
+  ++m_counts[i - m_offset];
+}
+
+double DDSketch::quantile(double q) const {
+  if (m_count == 0) {
+    return 0.0;
+  }
+
+  double rank = std::clamp(q, 0.0, 1.0) * (m_count - 1);
+  if (rank < m_zero) {
+    return std::max(0.0, m_min);
+  }
+
+  uint64_t seen = m_zero;
+  for (int b = 0; b < kBuckets; ++b) {
+    seen += m_counts[b];
+    if (seen > rank) {
+      return std::clamp(lowerBound(m_offset + b), m_min, m_max);
+    }
+  }
+  return m_max;
+}
+
+void StreamSketches::record(uint64_t path_hash, size_t bytes, int64_t now_ns) {
+  m_topics.add(path_hash);
+  m_sizes.add(static_cast<double>(bytes));
+  if (m_last_arrival != 0) {
+    m_gaps.add((now_ns - m_last_arrival) / 1e9);
+  }
+  m_last_arrival = now_ns;
+}
+
+StreamSummary StreamSketches::summary() const {
+  StreamSummary s;
+  s.m_messages = m_sizes.count();
+  s.m_distinct_topics = s.m_messages ? m_topics.estimate() : 0.0;
+  s.m_size_p50 = m_sizes.quantile(0.5);
+  s.m_size_p99 = m_sizes.quantile(0.99);
+  s.m_size_max = m_sizes.max();
+  s.m_gap_p50 = m_gaps.quantile(0.5);
+  s.m_gap_p99 = m_gaps.quantile(0.99);
+  return s;
+}
@@ -0,0 +1,105 @@
+#ifndef DMON_SKETCHES_H
+#define DMON_SKETCHES_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+// splitmix64 finalizer, spreads std::hash output over all 64 bits
+inline uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+inline uint64_t hashPath(const std::string& path) {
+  return mix64(std::hash<std::string>()(path));
+}
+
+// HyperLogLog distinct count estimate (Flajolet et al.) with 2^12 one byte
+// registers: 4 KB, about 1.6% standard error.
+class HyperLogLog {
+ public:
+  static constexpr int kPrecision = 12;
+  static constexpr size_t kRegisters = size_t(1) << kPrecision;
+
+  void add(uint64_t hash) {
+    size_t index = hash >> (64 - kPrecision);
+    // the marker bit bounds the rank when the remaining bits are all zero
+    uint64_t rest = (hash << kPrecision) | (uint64_t(1) << (kPrecision - 1));
+    uint8_t rank = static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+    if (rank > m_registers[index]) {
+      m_registers[index] = rank;
+    }
+  }
+
+  double estimate() const;
+
+ private:
+  std::array<uint8_t, kRegisters> m_registers{};
+};
+
+// DDSketch quantile sketch (Masson, Rim, Lee) with a fixed dense store of
+// 1024 64 bit counters, 8 KB. Quantiles are within the relative accuracy as long as
+// the values span less than gamma^1024; beyond that the lowest buckets are
+// collapsed, trading accuracy of the smallest values for a fixed size.
+class DDSketch {
+ public:
+  explicit DDSketch(double relative_accuracy = 0.01);
+
+  void add(double value);
+  double quantile(double q) const;
+  uint64_t count() const { return m_count; }
+  double min() const { return m_min; }
+  double max() const { return m_max; }
+
+ private:
+  static constexpr int kBuckets = 1024;
+  // smaller values count as zero
+  static constexpr double kMinValue = 1e-9;
+
+  int index(double value) const;
+  double lowerBound(int index) const;
+
+  double m_gamma;
+  double m_inv_log_gamma;
+  std::array<uint64_t, kBuckets> m_counts{};
+  // bucket index of m_counts[0] and the highest index stored
+  int m_offset{0};
+  int m_highest{0};
+  bool m_empty{true};
+  uint64_t m_zero{0};
+  uint64_t m_count{0};
+  double m_min{0.0};
+  double m_max{0.0};
+};
+
+struct StreamSummary {
+  uint64_t m_messages{0};
+  double m_distinct_topics{0.0};
+  double m_size_p50{0.0};
+  double m_size_p99{0.0};
+  double m_size_max{0.0};
+  // seconds between consecutive messages
+  double m_gap_p50{0.0};
+  double m_gap_p99{0.0};
+};
+
+// Fixed size approximate statistics of one message stream: distinct topics,
+// payload sizes and inter-arrival times.
+class StreamSketches {
+ public:
+  void record(uint64_t path_hash, size_t bytes, int64_t now_ns);
+  StreamSummary summary() const;
+
+ private:
+  HyperLogLog m_topics;
+  DDSketch m_sizes;
+  DDSketch m_gaps;
+  int64_t m_last_arrival{0};
+};
+
+#endif //DMON_SKETCHES_H
@@ -0,0 +1,130 @@
+#ifndef DMON_SPACE_SAVING_H
+#define DMON_SPACE_SAVING_H
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Space-Saving heavy hitters sketch (Metwally, Agrawal, El Abbadi). It keeps
+// at most `capacity` counters; an unseen key takes over the smallest counter
+// and inherits its count as the error bound. Any key heavier than
+// total / capacity is guaranteed to be among the counters and every count
+// overestimates the true one by at most its error.
+class SpaceSaving {
+ public:
+  struct Entry {
+    std::string m_key;
+    uint64_t m_count{0};
+    uint64_t m_error{0};
+  };
+
+  explicit SpaceSaving(size_t capacity) : m_capacity(std::max<size_t>(1, capacity)) {
+    m_entries.reserve(m_capacity);
+    m_heap.reserve(m_capacity);
+    m_index.reserve(m_capacity);
+  }
+
+  void add(const std::string& key, uint64_t weight = 1) {
+    m_total += weight;
+    auto it = m_index.find(key);
+    if (it != m_index.end()) {
+      m_entries[it->second].m_count += weight;
+      siftDown(m_heap_pos[it->second]);
+      return;
+    }
+
+    if (m_entries.size() < m_capacity) {
+      uint32_t index = static_cast<uint32_t>(m_entries.size());
+      m_entries.push_back(Entry{key, weight, 0});
+      m_heap.push_back(index);
+      m_heap_pos.push_back(index);
+      m_index.emplace(key, index);
+      siftUp(m_heap.size() - 1);
+      return;
+    }
+
+    // replace the smallest counter, it sits at the top of the min-heap
+    uint32_t index = m_heap.front();
+    Entry& e = m_entries[index];
+    m_index.erase(e.m_key);
+    e.m_key = key;
+    e.m_error = e.m_count;
+    e.m_count += weight;
+    m_index.emplace(key, index);
+    siftDown(0);
+  }
+
+  // the n heaviest keys, heaviest first
+  std::vector<Entry> top(size_t n) const {
+    std::vector<Entry> result(m_entries);
+    n = std::min(n, result.size());
+    std::partial_sort(result.begin(), result.begin() + n, result.end(),
+                      [](const Entry& a, const Entry& b) { return a.m_count > b.m_count; });
+    result.resize(n);
+    return result;
+  }
+
+  uint64_t total() const { return m_total; }
+  size_t capacity() const { return m_capacity; }
+
+  void clear() {
+    m_entries.clear();
+    m_heap.clear();
+    m_heap_pos.clear();
+    m_index.clear();
+    m_total = 0;
+  }
+
+ private:
+  bool less(size_t a, size_t b) const {
+    return m_entries[m_heap[a]].m_count < m_entries[m_heap[b]].m_count;
+  }
+
+  void swap(size_t a, size_t b) {
+    std::swap(m_heap[a], m_heap[b]);
+    m_heap_pos[m_heap[a]] = static_cast<uint32_t>(a);
+    m_heap_pos[m_heap[b]] = static_cast<uint32_t>(b);
+  }
+
+  void siftUp(size_t pos) {
+    while (pos > 0) {
+      size_t parent = (pos - 1) / 2;
+      if (!less(pos, parent)) {
+        break;
+      }
+      swap(pos, parent);
+      pos = parent;
+    }
+  }
+
+  // counts only ever grow, so an entry can only sink
+  void siftDown(size_t pos) {
+    while (true) {
+      size_t smallest = pos;
+      size_t left = 2 * pos + 1;
+      size_t right = left + 1;
+      if (left < m_heap.size() && less(left, smallest)) {
+        smallest = left;
+      }
+      if (right < m_heap.size() && less(right, smallest)) {
+        smallest = right;
+      }
+      if (smallest == pos) {
+        break;
+      }
+      swap(pos, smallest);
+      pos = smallest;
+    }
+  }
+
+  size_t m_capacity;
+  uint64_t m_total{0};
+  std::vector<Entry> m_entries;
+  // min-heap of entry indices by count and the heap position of each entry
+  std::vector<uint32_t> m_heap;
+  std::vector<uint32_t> m_heap_pos;
+  std::unordered_map<std::string, uint32_t> m_index;
+};
+
+#endif //DMON_SPACE_SAVING_H
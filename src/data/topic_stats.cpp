@@ -0,0 +1,56 @@
+#include "data/topic_stats.h"
+
+#include "spdlog/spdlog.h"
+
+TopicStats::TopicStats() : m_blocks(new std::atomic<Counters*>[kMaxBlocks]) {
+  for (size_t i = 0; i < kMaxBlocks; ++i) {
+    m_blocks[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+TopicStats::~TopicStats() {
+  for (size_t i = 0; i < kMaxBlocks; ++i) {
+    delete[] m_blocks[i].load(std::memory_order_relaxed);
+  }
+}
+
+uint32_t TopicStats::slot(const std::string& path) {
+  auto it = m_slots.find(path);
+  if (it != m_slots.end()) {
+    return it->second;
+  }
+
+  size_t slot = m_size.load(std::memory_order_relaxed);
+  size_t block = slot >> kBlockBits;
+  if (block >= kMaxBlocks) {
+    static bool reported = false;
+    if (!reported) {
+      spdlog::warn("topic statistics are full, {} topics are counted", slot);
+      reported = true;
+    }
+    return kNoSlot;
+  }
+
+  if (m_blocks[block].load(std::memory_order_relaxed) == nullptr) {
+    m_blocks[block].store(new Counters[kBlockSize], std::memory_order_release);
+  }
+  m_slots.emplace(path, static_cast<uint32_t>(slot));
+  m_size.store(slot + 1, std::memory_order_release);
+  return static_cast<uint32_t>(slot);
+}
+
+uint32_t TopicStats::find(const std::string& path) const {
+  auto it = m_slots.find(path);
+  return it == m_slots.end() ? kNoSlot : it->second;
+}
+
+const Counters* TopicStats::counters(uint32_t slot) const {
+  if (slot >= size()) {
+    return nullptr;
+  }
+  return m_blocks[slot >> kBlockBits].load(std::memory_order_acquire) + (slot & (kBlockSize - 1));
+}
+
+Counters* TopicStats::counters(uint32_t slot) {
+  return const_cast<Counters*>(static_cast<const TopicStats*>(this)->counters(slot));
+}
@@ -0,0 +1,126 @@
+#ifndef DMON_TOPIC_STATS_H
+#define DMON_TOPIC_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+inline int64_t monotonicNow() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+struct CountersSnapshot {
+  uint64_t m_messages{0};
+  uint64_t m_bytes{0};
+  // monotonicNow() of the last message, 0 when there was none
+  int64_t m_last_update{0};
+};
+
+// Message counters of a topic or a subscription. There is a single writer,
+// the session callback thread, so plain relaxed loads and stores are enough
+// and no read-modify-write is paid per message; readers on other threads may
+// see a slightly stale but never torn value.
+struct alignas(32) Counters {
+  std::atomic<uint64_t> m_messages{0};
+  std::atomic<uint64_t> m_bytes{0};
+  std::atomic<int64_t> m_last_update{0};
+
+  void record(size_t bytes, int64_t now) {
+    m_messages.store(m_messages.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    m_bytes.store(m_bytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+    m_last_update.store(now, std::memory_order_relaxed);
+  }
+
+  CountersSnapshot load() const {
+    return CountersSnapshot{m_messages.load(std::memory_order_relaxed),
+                            m_bytes.load(std::memory_order_relaxed),
+                            m_last_update.load(std::memory_order_relaxed)};
+  }
+};
+
+// Per topic counters in fixed size blocks which never move once allocated,
+// so readers index them without locking while the writer appends new slots.
+class TopicStats {
+ public:
+  static constexpr uint32_t kNoSlot = ~uint32_t(0);
+
+  TopicStats();
+  ~TopicStats();
+  TopicStats(const TopicStats&) = delete;
+  TopicStats& operator=(const TopicStats&) = delete;
+
+  // writer thread only: slot of the path, allocated on first use
+  uint32_t slot(const std::string& path);
+  // writer thread only: slot of the path or kNoSlot if it has none yet
+  uint32_t find(const std::string& path) const;
+
+  // nullptr for kNoSlot and slots not published yet
+  const Counters* counters(uint32_t slot) const;
+  Counters* counters(uint32_t slot);
+
+  size_t size() const { return m_size.load(std::memory_order_acquire); }
+
+ private:
+  static constexpr size_t kBlockBits = 12;
+  static constexpr size_t kBlockSize = size_t(1) << kBlockBits;
+  static constexpr size_t kMaxBlocks = 4096;
+
+  std::unique_ptr<std::atomic<Counters*>[]> m_blocks;
+  std::atomic<size_t> m_size{0};
+  std::unordered_map<std::string, uint32_t> m_slots;
+};
+
+// Turns counters into per second rates by differencing them between samples
+// taken at most once per period.
+class RateSampler {
+ public:
+  struct Rates {
+    float m_messages{0.0f};
+    float m_bytes{0.0f};
+  };
+
+  // load(i) returns the CountersSnapshot of slot i < n; returns true when a
+  // new sample was taken
+  template <typename Load>
+  bool sample(size_t n, Load&& load, std::chrono::steady_clock::time_point now) {
+    if (now - m_sampled_at < kPeriod) {
+      return false;
+    }
+
+    double dt = std::chrono::duration<double>(now - m_sampled_at).count();
+    bool first = m_sampled_at == std::chrono::steady_clock::time_point();
+    m_sampled_at = now;
+    m_messages.resize(n, 0);
+    m_bytes.resize(n, 0);
+    m_rates.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+      CountersSnapshot c = load(i);
+      if (!first) {
+        m_rates[i].m_messages = float((c.m_messages - m_messages[i]) / dt);
+        m_rates[i].m_bytes = float((c.m_bytes - m_bytes[i]) / dt);
+      }
+      m_messages[i] = c.m_messages;
+      m_bytes[i] = c.m_bytes;
+    }
+    return true;
+  }
+
+  Rates rates(uint32_t slot) const {
+    return slot < m_rates.size() ? m_rates[slot] : Rates();
+  }
+
+ private:
+  static constexpr auto kPeriod = std::chrono::seconds(1);
+
+  std::chrono::steady_clock::time_point m_sampled_at{};
+  std::vector<uint64_t> m_messages;
+  std::vector<uint64_t> m_bytes;
+  std::vector<Rates> m_rates;
+};
+
+#endif //DMON_TOPIC_STATS_H
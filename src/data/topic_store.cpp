@@ -0,0 +1,317 @@
+#include "data/topic_store.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#include "data/parallel.h"
+
+namespace {
+constexpr uint32_t kUnplaced = ~uint32_t(0);
+
+template <typename T>
+int compare(const T& a, const T& b) {
+  return a < b ? -1 : (b < a ? 1 : 0);
+}
+
+// the bits of a non negative float order the same as the float
+uint64_t floatKey(float value) {
+  uint32_t bits;
+  static_assert(sizeof(bits) == sizeof(value), "32 bit float expected");
+  memcpy(&bits, &value, sizeof(bits));
+  return value > 0.0f ? bits : 0;
+}
+}  // namespace
+
+bool TopicStore::less(uint32_t a, uint32_t b) const {
+  const Topic& x = m_topics[a];
+  const Topic& y = m_topics[b];
+  int c = 0;
+  switch (m_column) {
+    case SortColumn::Arrival:
+      break;
+    case SortColumn::Type:
+      c = x.m_topic_type.compare(y.m_topic_type);
+      break;
+    case SortColumn::Size:
+      c = compare(x.m_buffer.size(), y.m_buffer.size());
+      break;
+    case SortColumn::Path:
+      c = x.m_path.compare(y.m_path);
+      break;
+    case SortColumn::Updates:
+      c = compare(x.m_updates, y.m_updates);
+      break;
+    case SortColumn::LastUpdate:
+      c = compare(x.m_received, y.m_received);
+      break;
+    case SortColumn::MessageRate:
+      c = compare(floatKey(x.m_msg_rate), floatKey(y.m_msg_rate));
+      break;
+    case SortColumn::ByteRate:
+      c = compare(floatKey(x.m_byte_rate), floatKey(y.m_byte_rate));
+      break;
+  }
+
+  if (c != 0) {
+    return m_descending ? c > 0 : c < 0;
+  }
+
+  // equal keys keep arrival order which makes the order total, so binary
+  // searches over it always find a single place for a row
+  return (m_descending && m_column == SortColumn::Arrival) ? a > b : a < b;
+}
+
+void TopicStore::assign(std::vector<Topic>&& topics) {
+  clear();
+  m_topics.reserve(topics.size());
+  m_index.reserve(topics.size());
+  for (auto& t : topics) {
+    auto it = m_index.find(t.m_path);
+    if (it == m_index.end()) {
+      m_index.emplace(t.m_path, static_cast<uint32_t>(m_topics.size()));
+      m_topics.push_back(std::move(t));
+    } else {
+      m_topics[it->second] = std::move(t);
+    }
+  }
+  sort();
+}
+
+void TopicStore::merge(std::vector<Topic>&& topics) {
+  std::vector<uint32_t> touched;
+  touched.reserve(topics.size());
+  for (auto& t : topics) {
+    auto it = m_index.find(t.m_path);
+    if (it == m_index.end()) {
+      uint32_t index = static_cast<uint32_t>(m_topics.size());
+      m_index.emplace(t.m_path, index);
+      m_topics.push_back(std::move(t));
+      m_position.push_back(kUnplaced);
+      touched.push_back(index);
+      continue;
+    }
+
+    Topic& topic = m_topics[it->second];
+    topic.m_topic_type = std::move(t.m_topic_type);
+    topic.m_buffer = std::move(t.m_buffer);
+    topic.m_received = t.m_received;
+    topic.m_updates += t.m_updates;
+    if (t.m_stats_slot != TopicStats::kNoSlot) {
+      topic.m_stats_slot = t.m_stats_slot;
+    }
+    if (m_position[it->second] != kUnplaced) {
+      touched.push_back(it->second);
+    }
+  }
+  reorder(touched);
+}
+
+void TopicStore::clear() {
+  m_topics.clear();
+  m_index.clear();
+  m_order.clear();
+  m_position.clear();
+}
+
+void TopicStore::refreshRates(const RateSampler& sampler) {
+  for (auto& t : m_topics) {
+    auto rates = sampler.rates(t.m_stats_slot);
+    t.m_msg_rate = rates.m_messages;
+    t.m_byte_rate = rates.m_bytes;
+  }
+  if (m_column == SortColumn::MessageRate || m_column == SortColumn::ByteRate) {
+    sort();
+  }
+}
+
+void TopicStore::sortBy(SortColumn column, bool descending) {
+  if (column == m_column && descending == m_descending) {
+    return;
+  }
+  m_column = column;
+  m_descending = descending;
+  sort();
+}
+
+void TopicStore::sort() {
+  size_t n = m_topics.size();
+  m_order.resize(n);
+  std::iota(m_order.begin(), m_order.end(), 0);
+  m_position.resize(n);
+
+  if (m_column == SortColumn::Arrival) {
+    if (m_descending) {
+      std::reverse(m_order.begin(), m_order.end());
+    }
+    renumber(0, n);
+    return;
+  }
+
+  // Sorting indices through less() chases a pointer per comparison, so the
+  // full sort works on compact keys instead: the column value itself for
+  // numbers and the first 8 bytes after the common prefix for strings, the
+  // strings are compared in full only when those bytes are equal.
+  std::vector<SortKey> keys(n);
+  bool by_string = m_column == SortColumn::Type || m_column == SortColumn::Path;
+  size_t skip = by_string ? commonPrefix() : 0;
+  parallelFor(n, [&](size_t, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      keys[i] = SortKey{key(m_topics[i], skip), static_cast<uint32_t>(i)};
+    }
+  });
+
+  auto sort_keys = [&](auto cmp) {
+    parallelSort(keys.begin(), keys.end(), cmp);
+  };
+  auto compare_keys = [this](const SortKey& a, const SortKey& b) {
+    if (a.m_key != b.m_key) {
+      return a.m_key < b.m_key ? -1 : 1;
+    }
+    if (m_column == SortColumn::Type) {
+      return m_topics[a.m_index].m_topic_type.compare(m_topics[b.m_index].m_topic_type);
+    }
+    if (m_column == SortColumn::Path) {
+      return m_topics[a.m_index].m_path.compare(m_topics[b.m_index].m_path);
+    }
+    return 0;
+  };
+  if (m_descending) {
+    sort_keys([&compare_keys](const SortKey& a, const SortKey& b) {
+      int c = compare_keys(a, b);
+      return c != 0 ? c > 0 : a.m_index < b.m_index;
+    });
+  } else {
+    sort_keys([&compare_keys](const SortKey& a, const SortKey& b) {
+      int c = compare_keys(a, b);
+      return c != 0 ? c < 0 : a.m_index < b.m_index;
+    });
+  }
+
+  for (size_t row = 0; row < n; ++row) {
+    m_order[row] = keys[row].m_index;
+  }
+  renumber(0, n);
+}
+
+size_t TopicStore::commonPrefix() const {
+  // the common prefix of all strings is the one of the smallest and the
+  // biggest of them
+  auto field = [this](const Topic& t) -> const std::string& {
+    return m_column == SortColumn::Type ? t.m_topic_type : t.m_path;
+  };
+  if (m_topics.empty()) {
+    return 0;
+  }
+  const std::string* lo = &field(m_topics.front());
+  const std::string* hi = lo;
+  for (const auto& t : m_topics) {
+    const std::string& s = field(t);
+    if (s < *lo) {
+      lo = &s;
+    } else if (*hi < s) {
+      hi = &s;
+    }
+  }
+  return std::mismatch(lo->begin(), lo->end(), hi->begin(), hi->end()).first - lo->begin();
+}
+
+uint64_t TopicStore::key(const Topic& t, size_t skip) const {
+  auto prefix = [skip](const std::string& s) {
+    uint64_t k = 0;
+    for (size_t i = 0; i < 8; ++i) {
+      k <<= 8;
+      if (skip + i < s.size()) {
+        k |= static_cast<unsigned char>(s[skip + i]);
+      }
+    }
+    return k;
+  };
+
+  switch (m_column) {
+    case SortColumn::Type:
+      return prefix(t.m_topic_type);
+    case SortColumn::Path:
+      return prefix(t.m_path);
+    case SortColumn::Size:
+      return t.m_buffer.size();
+    case SortColumn::Updates:
+      return t.m_updates;
+    case SortColumn::LastUpdate:
+      // flipping the sign bit keeps signed tick counts ordered as unsigned
+      return static_cast<uint64_t>(t.m_received.time_since_epoch().count()) ^ (uint64_t(1) << 63);
+    case SortColumn::MessageRate:
+      return floatKey(t.m_msg_rate);
+    case SortColumn::ByteRate:
+      return floatKey(t.m_byte_rate);
+    case SortColumn::Arrival:
+      break;
+  }
+  return 0;
+}
+
+void TopicStore::reorder(std::vector<uint32_t>& touched) {
+  if (touched.empty()) {
+    return;
+  }
+
+  auto cmp = [this](uint32_t a, uint32_t b) { return less(a, b); };
+
+  // a merge is linear in the store size, past this point sorting anew wins
+  if (touched.size() > m_topics.size() / 4) {
+    sort();
+    return;
+  }
+
+  if (touched.size() == 1) {
+    uint32_t index = touched.front();
+    if (m_position[index] != kUnplaced) {
+      reposition(index);
+      return;
+    }
+    auto it = std::upper_bound(m_order.begin(), m_order.end(), index, cmp);
+    size_t pos = it - m_order.begin();
+    m_order.insert(it, index);
+    renumber(pos, m_order.size());
+    return;
+  }
+
+  // pull the touched rows out, order them and merge them back in one pass
+  std::sort(touched.begin(), touched.end());
+  touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+  for (auto index : touched) {
+    m_position[index] = kUnplaced;
+  }
+  m_order.erase(std::remove_if(m_order.begin(), m_order.end(),
+                               [this](uint32_t index) {
+                                 return m_position[index] == kUnplaced;
+                               }),
+                m_order.end());
+  std::sort(touched.begin(), touched.end(), cmp);
+  size_t middle = m_order.size();
+  m_order.insert(m_order.end(), touched.begin(), touched.end());
+  std::inplace_merge(m_order.begin(), m_order.begin() + middle, m_order.end(), cmp);
+  renumber(0, m_order.size());
+}
+
+void TopicStore::reposition(uint32_t index) {
+  auto cmp = [this](uint32_t a, uint32_t b) { return less(a, b); };
+  size_t pos = m_position[index];
+  auto current = m_order.begin() + pos;
+
+  if (pos > 0 && less(index, m_order[pos - 1])) {
+    auto it = std::upper_bound(m_order.begin(), current, index, cmp);
+    std::rotate(it, current, current + 1);
+    renumber(it - m_order.begin(), pos + 1);
+  } else if (pos + 1 < m_order.size() && less(m_order[pos + 1], index)) {
+    auto it = std::lower_bound(current + 1, m_order.end(), index, cmp);
+    std::rotate(current, current + 1, it);
+    renumber(pos, it - m_order.begin());
+  }
+}
+
+void TopicStore::renumber(size_t from, size_t to) {
+  for (size_t row = from; row < to; ++row) {
+    m_position[m_order[row]] = static_cast<uint32_t>(row);
+  }
+}
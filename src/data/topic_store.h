@@ -0,0 +1,72 @@
+#ifndef DMON_TOPIC_STORE_H
+#define DMON_TOPIC_STORE_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "data/session.h"
+
+enum class SortColumn : int {
+  Arrival,
+  Type,
+  Size,
+  Path,
+  Updates,
+  LastUpdate,
+  MessageRate,
+  ByteRate
+};
+
+// Topics keyed by path together with the order they are displayed in.
+// Rows keep their arrival index for their whole life, the display order is a
+// permutation of those indices which is fully sorted only when the sort key
+// changes; incoming updates are merged into the existing order.
+class TopicStore {
+ public:
+  size_t size() const { return m_order.size(); }
+  bool empty() const { return m_order.empty(); }
+
+  // row in display order
+  const Topic& operator[](size_t row) const { return m_topics[m_order[row]]; }
+
+  // all rows in arrival order
+  const std::vector<Topic>& topics() const { return m_topics; }
+
+  // replaces the whole content, e.g. by a fetch result
+  void assign(std::vector<Topic>&& topics);
+  // inserts new paths and updates existing ones in place
+  void merge(std::vector<Topic>&& topics);
+  void clear();
+
+  // copies freshly sampled rates into the rows, resorting if they are the
+  // sort key
+  void refreshRates(const RateSampler& sampler);
+
+  void sortBy(SortColumn column, bool descending);
+  SortColumn sortColumn() const { return m_column; }
+  bool descending() const { return m_descending; }
+
+ private:
+  struct SortKey {
+    uint64_t m_key;
+    uint32_t m_index;
+  };
+
+  bool less(uint32_t a, uint32_t b) const;
+  void sort();
+  size_t commonPrefix() const;
+  uint64_t key(const Topic& t, size_t skip) const;
+  void reorder(std::vector<uint32_t>& touched);
+  void reposition(uint32_t index);
+  void renumber(size_t from, size_t to);
+
+  std::vector<Topic> m_topics;
+  std::unordered_map<std::string, uint32_t> m_index;
+  std::vector<uint32_t> m_order;
+  std::vector<uint32_t> m_position;
+  SortColumn m_column{SortColumn::Arrival};
+  bool m_descending{false};
+};
+
+#endif //DMON_TOPIC_STORE_H
@@ -0,0 +1,369 @@
+#include "data/topic_tree.h"
+
+#include <algorithm>
+
+#include "data/parallel.h"
+#include "data/series.h"
+
+namespace {
+// hash of the first two segments as update() splits the path, every topic
+// of a second level branch hashes the same
+size_t branchHash(std::string_view path) {
+  size_t hash = 0;
+  for (int depth = 0; depth < 2 && !path.empty();) {
+    size_t slash = path.find('/');
+    std::string_view segment = path.substr(0, slash);
+    if (!segment.empty()) {
+      hash = hash * 0x9e3779b97f4a7c15ull ^ std::hash<std::string_view>()(segment);
+      ++depth;
+    }
+    path = slash == std::string_view::npos ? std::string_view() : path.substr(slash + 1);
+  }
+  return hash;
+}
+}  // namespace
+
+TopicTree::TopicTree() {
+  clear();
+}
+
+void TopicTree::clear() {
+  m_nodes.clear();
+  m_names.clear();
+  m_spliced_names.clear();
+  m_lookup.assign(kLookupShards, Lookup());
+  m_nodes.emplace_back();
+  m_nodes.front().m_expanded = true;
+  ++m_layout_version;
+  ++m_generation;
+}
+
+uint32_t TopicTree::child(uint32_t parent, std::string_view name) {
+  ChildKey key{parent, name};
+  Lookup& lookup = m_lookup[ChildKeyHash()(key) % kLookupShards];
+  auto it = lookup.find(key);
+  if (it != lookup.end()) {
+    return it->second;
+  }
+
+  uint32_t index = static_cast<uint32_t>(m_nodes.size());
+  std::string_view stored = m_names.emplace_back(name);
+  m_nodes.emplace_back();
+  m_nodes.back().m_name = stored;
+  m_nodes.back().m_parent = parent;
+  lookup.emplace(ChildKey{parent, stored}, index);
+
+  Node& p = m_nodes[parent];
+  p.m_children.push_back(index);
+  p.m_sorted = p.m_children.size() == 1;
+  if (p.m_expanded) {
+    ++m_layout_version;
+  }
+  return index;
+}
+
+void TopicTree::update(const Topic& topic, bool count_rate) {
+  uint32_t index = kRoot;
+  std::string_view path = topic.m_path;
+  while (!path.empty()) {
+    size_t slash = path.find('/');
+    std::string_view segment = path.substr(0, slash);
+    if (!segment.empty()) {
+      index = child(index, segment);
+    }
+    path = slash == std::string_view::npos ? std::string_view() : path.substr(slash + 1);
+  }
+
+  Node& leaf = m_nodes[index];
+  uint64_t added = leaf.m_topic ? 0 : 1;
+  uint64_t size = topic.m_buffer.size();
+  // wraps around for shrinking payloads, adding it back wraps again
+  uint64_t delta = size - leaf.m_own_bytes;
+  leaf.m_topic = true;
+  leaf.m_own_bytes = size;
+
+  bool had = leaf.m_numeric;
+  double old_value = leaf.m_value;
+  double value = 0.0;
+  int decimals;
+  bool has = decodeNumber(topic.m_buffer.data(), topic.m_buffer.size(), value, decimals);
+  leaf.m_numeric = has;
+  leaf.m_value = has ? value : 0.0;
+  // the extreme leaving a node can only be found again among its children
+  bool retract_min = had && !(has && value <= old_value);
+  bool retract_max = had && !(has && value >= old_value);
+  double sum_delta = (has ? value : 0.0) - (had ? old_value : 0.0);
+
+  auto now = DecayingRate::Clock::now();
+  while (true) {
+    Node& n = m_nodes[index];
+    n.m_topics += added;
+    n.m_bytes += delta;
+    n.m_updates += topic.m_updates;
+    if (count_rate) {
+      n.m_rate.hit(now, static_cast<double>(topic.m_updates));
+    }
+    if (had || has) {
+      uint64_t before = n.m_numbers;
+      n.m_numbers = n.m_numbers - had + has;
+      n.m_sum = n.m_numbers ? n.m_sum + sum_delta : 0.0;
+      n.m_sum_updates = n.m_numbers ? n.m_sum_updates + 1 : 0;
+      if (n.m_numbers == 0 || before == 0) {
+        n.m_min = n.m_max = value;
+        n.m_extremes_stale = false;
+      } else if (!n.m_extremes_stale) {
+        if ((retract_min && old_value <= n.m_min) || (retract_max && old_value >= n.m_max)) {
+          n.m_extremes_stale = true;
+        } else if (has) {
+          n.m_min = std::min(n.m_min, value);
+          n.m_max = std::max(n.m_max, value);
+        }
+      }
+    }
+    if (index == kRoot) {
+      break;
+    }
+    index = n.m_parent;
+  }
+}
+
+void TopicTree::rebuild(const std::vector<Topic>& fetched, const std::vector<Topic>& subscribed) {
+  clear();
+  size_t total = fetched.size() + subscribed.size();
+  size_t workers = parallelWorkers(total);
+  if (workers == 1) {
+    // roughly a node per topic, most paths share their parents
+    m_nodes.reserve(total + 1);
+    for (const auto& t : fetched) {
+      update(t, false);
+    }
+    // subscriptions carry the latest values, so they go last
+    for (const auto& t : subscribed) {
+      update(t, false);
+    }
+    return;
+  }
+
+  // Every worker builds the second level branches which hash to it, so a
+  // tree under a single root is split too. The input is partitioned in one
+  // pass, fetched topics first in every part. The partial trees share only
+  // the root and first level nodes, which are merged when they are spliced
+  // together afterwards instead of contending on one tree.
+  std::vector<std::vector<const Topic*>> inputs(workers);
+  for (auto& input : inputs) {
+    input.reserve(total / workers + 1);
+  }
+  for (const auto* topics : {&fetched, &subscribed}) {
+    for (const auto& t : *topics) {
+      inputs[branchHash(t.m_path) % workers].push_back(&t);
+    }
+  }
+  std::vector<TopicTree> parts(workers);
+  parallelFor(workers, [&](size_t, size_t begin, size_t end) {
+    for (size_t w = begin; w < end; ++w) {
+      parts[w].m_nodes.reserve(inputs[w].size() + 1);
+      for (const Topic* t : inputs[w]) {
+        parts[w].update(*t, false);
+      }
+    }
+  }, 1);
+  splice(parts);
+}
+
+void TopicTree::splice(std::vector<TopicTree>& parts) {
+  // part nodes keep their order, shifted past the nodes of previous parts;
+  // the part roots collapse into the single root and the first level nodes
+  // into the first of their name, the copies in later parts are merged
+  // into it
+  std::unordered_map<std::string_view, uint32_t> first_level;
+  std::vector<std::vector<uint32_t>> remaps(parts.size());
+  std::vector<std::vector<char>> merged(parts.size());
+  std::vector<uint32_t> bases;
+  size_t count = 1;
+  for (size_t w = 0; w < parts.size(); ++w) {
+    const auto& nodes = parts[w].m_nodes;
+    remaps[w].assign(nodes.size(), kRoot);
+    merged[w].assign(nodes.size(), 0);
+    bases.push_back(static_cast<uint32_t>(count));
+    // children of the root are created, and listed, in index order
+    size_t skipped = 0;
+    for (auto c : nodes[kRoot].m_children) {
+      auto [it, added] = first_level.emplace(nodes[c].m_name, static_cast<uint32_t>(count + c - 1 - skipped));
+      remaps[w][c] = it->second;
+      if (!added) {
+        merged[w][c] = 1;
+        ++skipped;
+      }
+    }
+    count += nodes.size() - 1 - skipped;
+  }
+
+  m_nodes.resize(count);
+  Node& root = m_nodes[kRoot];
+  for (size_t w = 0; w < parts.size(); ++w) {
+    const Node& part_root = parts[w].m_nodes[kRoot];
+    root.m_topics += part_root.m_topics;
+    root.m_bytes += part_root.m_bytes;
+    root.m_updates += part_root.m_updates;
+    if (part_root.m_numbers) {
+      root.m_min = root.m_numbers ? std::min(root.m_min, part_root.m_min) : part_root.m_min;
+      root.m_max = root.m_numbers ? std::max(root.m_max, part_root.m_max) : part_root.m_max;
+      root.m_numbers += part_root.m_numbers;
+      root.m_sum += part_root.m_sum;
+      root.m_sum_updates = std::max(root.m_sum_updates, part_root.m_sum_updates);
+      root.m_extremes_stale = root.m_extremes_stale || part_root.m_extremes_stale;
+    }
+    for (auto c : part_root.m_children) {
+      if (!merged[w][c]) {
+        root.m_children.push_back(remaps[w][c]);
+      }
+    }
+  }
+  root.m_sorted = root.m_children.size() <= 1;
+
+  // indices of every part's nodes by lookup shard
+  std::vector<std::vector<std::vector<uint32_t>>> shards(parts.size());
+  parallelFor(parts.size(), [&](size_t, size_t begin, size_t end) {
+    for (size_t w = begin; w < end; ++w) {
+      auto& nodes = parts[w].m_nodes;
+      auto& remap = remaps[w];
+      shards[w].resize(kLookupShards);
+      size_t skipped = 0;
+      for (size_t i = 1; i < nodes.size(); ++i) {
+        if (merged[w][i]) {
+          ++skipped;
+        } else {
+          remap[i] = static_cast<uint32_t>(bases[w] + i - 1 - skipped);
+        }
+      }
+      for (size_t i = 1; i < nodes.size(); ++i) {
+        if (merged[w][i]) {
+          continue;
+        }
+        Node& n = m_nodes[remap[i]] = std::move(nodes[i]);
+        n.m_parent = remap[n.m_parent];
+        for (auto& c : n.m_children) {
+          c = remap[c];
+        }
+        shards[w][ChildKeyHash()(ChildKey{n.m_parent, n.m_name}) % kLookupShards].push_back(remap[i]);
+      }
+    }
+  }, 1);
+
+  // the copies of a first level node hold different second level branches
+  for (size_t w = 0; w < parts.size(); ++w) {
+    for (auto c : parts[w].m_nodes[kRoot].m_children) {
+      if (!merged[w][c]) {
+        continue;
+      }
+      const Node& from = parts[w].m_nodes[c];
+      Node& into = m_nodes[remaps[w][c]];
+      into.m_topics += from.m_topics;
+      into.m_bytes += from.m_bytes;
+      into.m_updates += from.m_updates;
+      if (from.m_topic) {
+        into.m_topic = true;
+        into.m_own_bytes = from.m_own_bytes;
+        into.m_numeric = from.m_numeric;
+        into.m_value = from.m_value;
+      }
+      if (from.m_numbers) {
+        into.m_min = into.m_numbers ? std::min(into.m_min, from.m_min) : from.m_min;
+        into.m_max = into.m_numbers ? std::max(into.m_max, from.m_max) : from.m_max;
+        into.m_numbers += from.m_numbers;
+        into.m_sum += from.m_sum;
+        into.m_sum_updates = std::max(into.m_sum_updates, from.m_sum_updates);
+        into.m_extremes_stale = into.m_extremes_stale || from.m_extremes_stale;
+      }
+      for (auto grandchild : from.m_children) {
+        into.m_children.push_back(remaps[w][grandchild]);
+      }
+      into.m_sorted = into.m_children.size() <= 1;
+    }
+  }
+
+  for (auto& part : parts) {
+    m_spliced_names.push_back(std::move(part.m_names));
+  }
+
+  // every worker fills its own lookup shards
+  size_t workers = parts.size();
+  parallelFor(workers, [&](size_t, size_t begin, size_t end) {
+    for (size_t w = begin; w < end; ++w) {
+      for (size_t shard = w; shard < kLookupShards; shard += workers) {
+        for (const auto& part : shards) {
+          for (auto i : part[shard]) {
+            m_lookup[shard].emplace(ChildKey{m_nodes[i].m_parent, m_nodes[i].m_name}, i);
+          }
+        }
+      }
+    }
+  }, 1);
+}
+
+std::string TopicTree::path(uint32_t index) const {
+  std::vector<std::string_view> segments;
+  for (; index != kRoot; index = m_nodes[index].m_parent) {
+    segments.push_back(m_nodes[index].m_name);
+  }
+
+  std::string result;
+  for (auto it = segments.rbegin(); it != segments.rend(); ++it) {
+    if (!result.empty()) {
+      result += '/';
+    }
+    result += *it;
+  }
+  return result;
+}
+
+const std::vector<uint32_t>& TopicTree::children(uint32_t index) {
+  Node& n = m_nodes[index];
+  if (!n.m_sorted) {
+    std::sort(n.m_children.begin(), n.m_children.end(), [this](uint32_t a, uint32_t b) {
+      return m_nodes[a].m_name < m_nodes[b].m_name;
+    });
+    n.m_sorted = true;
+  }
+  return n.m_children;
+}
+
+void TopicTree::resolveNumbers(uint32_t index) {
+  Node& n = m_nodes[index];
+  if (!n.m_extremes_stale && n.m_sum_updates < kRederiveSum) {
+    return;
+  }
+  bool found = n.m_numeric;
+  double lo = n.m_value;
+  double hi = n.m_value;
+  double sum = n.m_numeric ? n.m_value : 0.0;
+  for (auto c : n.m_children) {
+    resolveNumbers(c);
+    const Node& child = m_nodes[c];
+    if (child.m_numbers) {
+      lo = found ? std::min(lo, child.m_min) : child.m_min;
+      hi = found ? std::max(hi, child.m_max) : child.m_max;
+      sum += child.m_sum;
+      found = true;
+    }
+  }
+  n.m_min = lo;
+  n.m_max = hi;
+  n.m_extremes_stale = false;
+  n.m_sum = sum;
+  n.m_sum_updates = 0;
+}
+
+TopicTree::Numbers TopicTree::numbers(uint32_t index) {
+  resolveNumbers(index);
+  const Node& n = m_nodes[index];
+  return Numbers{n.m_numbers, n.m_sum, n.m_min, n.m_max};
+}
+
+void TopicTree::setExpanded(uint32_t index, bool expanded) {
+  Node& n = m_nodes[index];
+  if (n.m_expanded != expanded) {
+    n.m_expanded = expanded;
+    ++m_layout_version;
+  }
+}
@@ -0,0 +1,124 @@
+#ifndef DMON_TOPIC_TREE_H
+#define DMON_TOPIC_TREE_H
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "data/rate.h"
+#include "data/session.h"
+
+// Trie of topic paths split by '/'. Every node keeps aggregates of its whole
+// subtree which are adjusted along the path to the root on each insert or
+// update, so reading them never needs a traversal.
+class TopicTree {
+ public:
+  static constexpr uint32_t kRoot = 0;
+
+  struct Node {
+    std::string_view m_name;
+    uint32_t m_parent{kRoot};
+    std::vector<uint32_t> m_children;
+    bool m_topic{false};
+    bool m_expanded{false};
+    bool m_sorted{true};
+    // topics in the subtree, the node itself included
+    uint64_t m_topics{0};
+    // payload bytes in the subtree
+    uint64_t m_bytes{0};
+    // payload bytes of the node itself when it is a topic
+    uint64_t m_own_bytes{0};
+    uint64_t m_updates{0};
+    DecayingRate m_rate;
+    // topics in the subtree whose latest value is a number, and their sum
+    uint64_t m_numbers{0};
+    double m_sum{0.0};
+    // numeric updates added to m_sum since it was last derived from the
+    // children
+    uint32_t m_sum_updates{0};
+    // valid while m_numbers > 0 and not m_extremes_stale, see numbers()
+    double m_min{0.0};
+    double m_max{0.0};
+    // latest value of the node itself when m_numeric
+    double m_value{0.0};
+    bool m_numeric{false};
+    bool m_extremes_stale{false};
+  };
+
+  struct Numbers {
+    uint64_t m_count{0};
+    double m_sum{0.0};
+    double m_min{0.0};
+    double m_max{0.0};
+
+    double mean() const { return m_count ? m_sum / m_count : 0.0; }
+  };
+
+  TopicTree();
+
+  void clear();
+  // adds the topic or replaces the value of the known one; count_rate is off
+  // when replaying stored topics which did not just arrive
+  void update(const Topic& topic, bool count_rate = true);
+  // builds the tree anew in one parallel pass over both stores
+  void rebuild(const std::vector<Topic>& fetched, const std::vector<Topic>& subscribed);
+
+  size_t size() const { return m_nodes.size(); }
+  // changes when the tree is cleared or rebuilt and node indices are reused
+  uint64_t generation() const { return m_generation; }
+  const Node& node(uint32_t index) const { return m_nodes[index]; }
+  std::string path(uint32_t index) const;
+
+  // children ordered by name, sorted on first access after a change
+  const std::vector<uint32_t>& children(uint32_t index);
+  // aggregates of the numeric topics in the subtree. Count and sum follow
+  // every update on the way to the root; so do min and max unless the value
+  // leaving them was the extreme, then they are recomputed from the children
+  // on the next read. The sum is recomputed from the children on the read
+  // after kRederiveSum updates, before rounding errors add up.
+  Numbers numbers(uint32_t index);
+
+  void setExpanded(uint32_t index, bool expanded);
+  // changes whenever the set of expanded rows changes
+  uint64_t layoutVersion() const { return m_layout_version; }
+
+ private:
+  struct ChildKey {
+    uint32_t m_parent;
+    std::string_view m_name;
+    bool operator==(const ChildKey& other) const {
+      return m_parent == other.m_parent && m_name == other.m_name;
+    }
+  };
+
+  struct ChildKeyHash {
+    size_t operator()(const ChildKey& key) const {
+      return std::hash<std::string_view>()(key.m_name) ^ (size_t(key.m_parent) * 0x9e3779b97f4a7c15ull);
+    }
+  };
+
+  using Lookup = std::unordered_map<ChildKey, uint32_t, ChildKeyHash>;
+
+  // the child lookup is split so that a parallel rebuild can fill it
+  // without locking
+  static constexpr size_t kLookupShards = 64;
+  static constexpr uint32_t kRederiveSum = 4096;
+
+  uint32_t child(uint32_t parent, std::string_view name);
+  void resolveNumbers(uint32_t index);
+  void splice(std::vector<TopicTree>& parts);
+
+  std::vector<Node> m_nodes;
+  // node names live here, a deque never moves its elements so the views
+  // in the nodes and lookup keys stay valid
+  std::deque<std::string> m_names;
+  // names of the nodes taken over from the partial trees of a rebuild
+  std::vector<std::deque<std::string>> m_spliced_names;
+  std::vector<Lookup> m_lookup;
+  uint64_t m_layout_version{0};
+  uint64_t m_generation{0};
+};
+
+#endif //DMON_TOPIC_TREE_H
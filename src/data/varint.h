@@ -0,0 +1,37 @@
+#ifndef DMON_VARINT_H
+#define DMON_VARINT_H
+
+#include <cstdint>
+#include <vector>
+
+// LEB128 varints and zigzag mapping of signed deltas, for compact histories.
+
+inline uint64_t zigzag(uint64_t delta) {
+  return (delta << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(delta) >> 63);
+}
+
+inline uint64_t unzigzag(uint64_t value) {
+  return (value >> 1) ^ (~(value & 1) + 1);
+}
+
+inline void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+// the input is trusted, it was written by putVarint
+inline uint64_t getVarint(const uint8_t*& p) {
+  uint64_t value = 0;
+  for (int shift = 0;; shift += 7) {
+    uint8_t b = *p++;
+    value |= static_cast<uint64_t>(b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      return value;
+    }
+  }
+}
+
+#endif //DMON_VARINT_H
@@ -14,7 +14,10 @@
 #include <iostream>
 
 #include "ui/main_component.hpp"
+#include "ui/render_scheduler.hpp"
 #include "data/session.h"
+#include "modes/bench.h"
+#include "modes/headless.h"
 #include "spdlog/spdlog.h"
 #include "spdlog/sinks/basic_file_sink.h"
 
@@ -61,6 +64,30 @@ ARG_OPTS_T arg_opts[] = {
     {'r', "retries", "Reconnection retry attempts", ARG_OPTIONAL, ARG_HAS_VALUE, "5" },
     {'t', "timeout", "Reconnection timeout for a disconnected session", ARG_OPTIONAL, ARG_HAS_VALUE, NULL },
     {'s', "sleep", "Time to sleep before disconnecting (in seconds).", ARG_OPTIONAL, ARG_HAS_VALUE, "5" },
+    {'H', "headless", "Run without UI, subscribe to the selector and print hot topics periodically", ARG_OPTIONAL, ARG_NO_VALUE, NULL },
+    {'S', "selector", "Topic selector to subscribe in headless mode", ARG_OPTIONAL, ARG_HAS_VALUE, NULL },
+    {'i', "interval", "Report interval in headless mode and benchmarks, in seconds", ARG_OPTIONAL, ARG_HAS_VALUE, "10" },
+    {'k', "top", "Number of hot topics and branches to report", ARG_OPTIONAL, ARG_HAS_VALUE, "20" },
+    {'n', "counters", "Counters per hot topics sketch, bounds its memory and error", ARG_OPTIONAL, ARG_HAS_VALUE, "1024" },
+    {'D', "depth", "Path depth of hot branches", ARG_OPTIONAL, ARG_HAS_VALUE, "2" },
+    {'A', "aggregate-depth", "Path depth of numeric topic aggregates in headless mode, 0 for none", ARG_OPTIONAL, ARG_HAS_VALUE, "0" },
+    {'X', "metrics-port", "Port serving Prometheus metrics at /metrics in headless mode, 0 for none", ARG_OPTIONAL, ARG_HAS_VALUE, "0" },
+    {'Y', "metrics-address", "Address the metrics port listens on", ARG_OPTIONAL, ARG_HAS_VALUE, "127.0.0.1" },
+    {'F', "metrics-file", "File rewritten with Prometheus metrics every interval in headless mode, for the textfile collector", ARG_OPTIONAL, ARG_HAS_VALUE, NULL },
+    {'f', "fps", "Most frames drawn per second, the screen is only redrawn when something changed", ARG_OPTIONAL, ARG_HAS_VALUE, "30" },
+    {'V', "history", "Versions of every topic kept to step through with [ and ], 0 for none", ARG_OPTIONAL, ARG_HAS_VALUE, "32" },
+    {'W', "history-seconds", "Versions older than this many seconds are dropped, 0 for no limit", ARG_OPTIONAL, ARG_HAS_VALUE, "0" },
+    {'B', "history-budget", "Memory for the version history of all topics, in MiB", ARG_OPTIONAL, ARG_HAS_VALUE, "64" },
+    {'G', "series-budget", "Memory for the numeric series of all topics, in MiB", ARG_OPTIONAL, ARG_HAS_VALUE, "64" },
+    {'R', "ping-interval", "Milliseconds between pings measuring the round trip time to the server, 0 for none", ARG_OPTIONAL, ARG_HAS_VALUE, "1000" },
+    {'T', "bench-topic", "Topic the latency benchmark creates, default dmon/bench/latency, path the messaging benchmark sends to, default dmon/bench/messaging, or root of the replayed topics, default dmon/bench/replay", ARG_OPTIONAL, ARG_HAS_VALUE, NULL },
+    {'E', "bench-rate", "Messages per second the benchmarks send, the first rate of the messaging benchmark", ARG_OPTIONAL, ARG_HAS_VALUE, "1000" },
+    {'L', "bench-seconds", "Duration of a latency benchmark run or of every messaging benchmark rate, in seconds", ARG_OPTIONAL, ARG_HAS_VALUE, "10" },
+    {'Z', "bench-size", "Payload bytes of the benchmark messages", ARG_OPTIONAL, ARG_HAS_VALUE, "64" },
+    {'N', "bench-topics", "Topics the replay benchmark routes messages for", ARG_OPTIONAL, ARG_HAS_VALUE, "1000" },
+    {'Q', "bench-messages", "Deltas the replay benchmark routes", ARG_OPTIONAL, ARG_HAS_VALUE, "1000000" },
+    {'P', "proto", "Compiled FileDescriptorSet (protoc --include_imports --descriptor_set_out) to decode protobuf payloads with", ARG_OPTIONAL, ARG_HAS_VALUE, NULL },
+    {'M', "proto-map", "Message types of topics, comma separated path_prefix=package.Message", ARG_OPTIONAL, ARG_HAS_VALUE, NULL },
     END_OF_ARG_OPTS
 };
 
@@ -81,13 +108,26 @@ int main(int argc, char** argv) {
   spdlog::set_level(spdlog::level::debug);
 
 
+  // modes other than the UI are picked by the first argument, the rest are
+  // the usual options
+  std::string mode;
+  if (argc > 1 && argv[1][0] != '-') {
+    mode = argv[1];
+    if (mode != "bench-latency" && mode != "bench-messaging" && mode != "bench-replay") {
+      std::cerr << "Unknown mode " << mode << ", expected bench-latency, bench-messaging or bench-replay" << std::endl;
+      return EXIT_FAILURE;
+    }
+    --argc;
+    ++argv;
+  }
+
   /*
     * Standard command-line parsing.
     */
     HASH_T *options = parse_cmdline(argc, argv, arg_opts);
     if(options == nullptr || hash_get(options, "help") != nullptr) {
         // replace show usage due to fprintf wrapped in the diffusion library
-        std::cout << "Usage:\n";
+        std::cout << "Usage: dmon [bench-latency|bench-messaging|bench-replay] [options]\n";
         for (size_t i = 0; i < sizeof(arg_opts)/sizeof(arg_opts[0]) - 1; ++i)
         {
           std::cout << "-" << arg_opts[i].short_arg << "/-" << arg_opts[i].long_arg << "  "
@@ -119,6 +159,26 @@ int main(int argc, char** argv) {
     //const unsigned int sleep_time = std::atol(static_cast<const char*>(hash_get(options, "sleep")));
     //const char* selector = static_cast<const char*>(hash_get(options,"selector"));
 
+    ProtoSchema schema;
+    std::string schema_error;
+    if (hash_get(options, "proto") != nullptr &&
+        !schema.load(static_cast<const char*>(hash_get(options, "proto")), schema_error)) {
+      std::cerr << "Protobuf descriptors: " << schema_error << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (hash_get(options, "proto-map") != nullptr &&
+        !schema.bind(static_cast<const char*>(hash_get(options, "proto-map")), schema_error)) {
+      std::cerr << "Protobuf topic types: " << schema_error << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // the replay benchmark routes its messages itself, nothing goes over a
+    // socket; the client library picks its dummy transport by the URL scheme,
+    // which the benchmark checks before it starts
+    if (mode == "bench-replay") {
+      url = "dummy://localhost";
+    }
+
     spdlog::info("application has started url {} principal {} password {}", url, principal, reconnect_timeout);
     Session session;
     Error e;
@@ -128,54 +188,116 @@ int main(int argc, char** argv) {
       return EXIT_FAILURE;
     }
 
+    long ping_interval = std::atol(static_cast<const char*>(hash_get(options, "ping-interval")));
+    if (ping_interval > 0 && mode != "bench-replay") {
+      // a ping is given up on after a few intervals, but not too soon
+      session.startPing(std::chrono::milliseconds(ping_interval),
+                        std::chrono::milliseconds(std::max(5000L, 4 * ping_interval)));
+    }
+
+    if (!mode.empty()) {
+      BenchOptions bench;
+      bench.m_topic = hash_get(options, "bench-topic") != nullptr
+                          ? static_cast<const char*>(hash_get(options, "bench-topic"))
+                          : "dmon/bench/" + mode.substr(mode.find('-') + 1);
+      bench.m_rate = std::atol(static_cast<const char*>(hash_get(options, "bench-rate")));
+      bench.m_seconds = std::atol(static_cast<const char*>(hash_get(options, "bench-seconds")));
+      bench.m_size = std::atol(static_cast<const char*>(hash_get(options, "bench-size")));
+      bench.m_interval = std::atol(static_cast<const char*>(hash_get(options, "interval")));
+      bench.m_topics = std::atol(static_cast<const char*>(hash_get(options, "bench-topics")));
+      bench.m_messages = std::strtoull(static_cast<const char*>(hash_get(options, "bench-messages")), nullptr, 10);
+      if (mode == "bench-replay") {
+        return runBenchReplay(session, bench);
+      }
+      return mode == "bench-latency" ? runBenchLatency(session, bench) : runBenchMessaging(session, bench);
+    }
+
+    if (hash_get(options, "headless") != nullptr) {
+      if (hash_get(options, "selector") == nullptr) {
+        std::cerr << "Headless mode requires a selector (-S)" << std::endl;
+        return EXIT_FAILURE;
+      }
+      HeadlessOptions headless;
+      headless.m_selector = static_cast<const char*>(hash_get(options, "selector"));
+      headless.m_interval = std::atol(static_cast<const char*>(hash_get(options, "interval")));
+      headless.m_top = std::atol(static_cast<const char*>(hash_get(options, "top")));
+      headless.m_capacity = std::atol(static_cast<const char*>(hash_get(options, "counters")));
+      headless.m_depth = std::atol(static_cast<const char*>(hash_get(options, "depth")));
+      headless.m_aggregate_depth = std::atol(static_cast<const char*>(hash_get(options, "aggregate-depth")));
+      headless.m_metrics_address = static_cast<const char*>(hash_get(options, "metrics-address"));
+      headless.m_metrics_port = std::atoi(static_cast<const char*>(hash_get(options, "metrics-port")));
+      if (hash_get(options, "metrics-file") != nullptr) {
+        headless.m_metrics_file = static_cast<const char*>(hash_get(options, "metrics-file"));
+      }
+      return runHeadless(session, headless);
+    }
+
+    session.getHotTopics().configure(std::atol(static_cast<const char*>(hash_get(options, "counters"))),
+                                     std::atol(static_cast<const char*>(hash_get(options, "depth"))));
+
   auto screen = ScreenInteractive::Fullscreen();
-  Animator animator(screen);
-  auto component = std::make_shared<MainComponent>(session, screen.ExitLoopClosure());
+  RenderScheduler scheduler(screen, std::atoi(static_cast<const char*>(hash_get(options, "fps"))));
+  HistoryOptions history;
+  history.m_versions = std::atol(static_cast<const char*>(hash_get(options, "history")));
+  history.m_seconds = std::atol(static_cast<const char*>(hash_get(options, "history-seconds")));
+  history.m_budget = static_cast<size_t>(std::atol(static_cast<const char*>(hash_get(options, "history-budget")))) << 20;
+  size_t series_budget = static_cast<size_t>(std::atol(static_cast<const char*>(hash_get(options, "series-budget")))) << 20;
+  auto component = std::make_shared<MainComponent>(session, schema, history, series_budget, screen.ExitLoopClosure());
+
+  // subscribed topics are taken in a batch once a frame, however many
+  // arrived; the session announces a batch once, when it starts
+  constexpr uint32_t kSubscribed = 1;
+  scheduler.onDirty(kSubscribed, [&component, &session] {
+    component->onSubscribeCompleted(std::string(), session.getSubscribeTopics(), std::string());
+  });
+  session.setSubscribeBatchCallback([&scheduler] { scheduler.markDirty(kSubscribed); });
 
-  session.setFetchCompletedCallback([&screen, &animator, &session, &component](std::string&& selector) {
-    animator.stop("fetch");
+  // the rest happens once per operation and is posted as it comes, with an
+  // event after the closure for the screen to draw it
+  session.setFetchCompletedCallback([&screen, &scheduler, &session, &component](std::string&& selector) {
+    scheduler.stop("fetch");
     screen.Post([&component, tpx = session.getFetchTopics(), sel = std::move(selector)]() mutable {
             component->onFetchCompleted(std::string(), std::move(tpx), std::move(sel));
           });
     screen.PostEvent(Event::Special("fetch"));
   });
 
-  session.setFetchErrorCallback([&screen, &animator, &component](Error error) {
-    animator.stop("fetch");
+  session.setFetchErrorCallback([&screen, &scheduler, &component](Error error) {
+    scheduler.stop("fetch");
     screen.Post([&component, error]() mutable {
       component->onFetchCompleted(error.m_message, std::vector<Topic>(), std::string());
     });
     screen.PostEvent(Event::Special("fetch"));
   });
 
-  session.setFetchDiscardCallback([&screen, &animator, &component](std::string&& selector) {
-    animator.stop("fetch");
+  session.setFetchDiscardCallback([&screen, &scheduler, &component](std::string&& selector) {
+    scheduler.stop("fetch");
     screen.Post([&component, sel = std::move(selector)]() mutable {
       component->onFetchCompleted("Discard", std::vector<Topic>(), std::move(sel));
     });
     screen.PostEvent(Event::Special("fetch"));
   });
 
-  session.setFetchStartCallback([&animator]() {
-           animator.start("fetch");
+  session.setFetchStartCallback([&scheduler]() {
+           scheduler.start("fetch");
   });
 
-  session.setSubscribeCompletedCallback([&screen, &animator, &component, &session](std::string&& selector) {
-    animator.stop("subscribe");
+  session.setSubscribeCompletedCallback([&screen, &scheduler, &component, &session](std::string&& selector) {
+    scheduler.stop("subscribe");
     screen.Post([&component, tpx = session.getSubscribeTopics(), sel = std::move(selector)]() mutable {
       component->onSubscribeCompleted(std::string(), std::move(tpx), std::move(sel));
     });
     screen.PostEvent(Event::Special("subscribe"));
   });
 
-  session.setSubscribeStartCallback([&animator](){
-    animator.start("subscribe");
+  session.setSubscribeStartCallback([&scheduler](){
+    scheduler.start("subscribe");
   });
 
-  session.setSubscribeErrorCallback([&screen, &animator, &component](Error error) {
-    animator.stop("subscribe");
+  session.setSubscribeErrorCallback([&screen, &scheduler, &component](Error error) {
+    scheduler.stop("subscribe");
     screen.Post([&component, error]() mutable {
-      component->onSubscribeCompleted(error.m_message, std::vector<Topic>(), std::string());
+      component->onSubscribeCompleted(error.m_message, SubscriptionBatch(), std::string());
     });
     screen.PostEvent(Event::Special("subscribe"));
   });
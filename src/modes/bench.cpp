@@ -0,0 +1,411 @@
+#include "modes/bench.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "data/latency.h"
+#include "spdlog/spdlog.h"
+
+namespace {
+std::atomic<bool> stop_requested{false};
+
+void onSignal(int) {
+  stop_requested = true;
+}
+
+// Outcome of a topic control request. The state is shared with the
+// callback, which may still come after the benchmark gave up waiting.
+class Outcome {
+ public:
+  Session::ControlCallback callback() {
+    return [state = m_state](bool ok, std::string&& error) {
+      std::lock_guard<std::mutex> lk(state->m_mutex);
+      state->m_done = true;
+      state->m_ok = ok;
+      state->m_error = std::move(error);
+      state->m_cv.notify_one();
+    };
+  }
+
+  bool wait(std::string& error) {
+    std::unique_lock<std::mutex> lk(m_state->m_mutex);
+    if (!m_state->m_cv.wait_for(lk, std::chrono::seconds(10), [this] { return m_state->m_done; })) {
+      error = "no reply in 10s";
+      return false;
+    }
+    error = m_state->m_error;
+    return m_state->m_ok;
+  }
+
+ private:
+  struct State {
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_done{false};
+    bool m_ok{false};
+    std::string m_error;
+  };
+
+  std::shared_ptr<State> m_state{std::make_shared<State>()};
+};
+
+// leading space separated decimal fields of a benchmark payload
+template <typename... Fields>
+bool parseFields(const char* begin, const char* end, Fields&... fields) {
+  bool ok = true;
+  auto parse = [&](auto& field) {
+    if (!ok || begin >= end) {
+      ok = false;
+      return;
+    }
+    auto parsed = std::from_chars(begin, end, field);
+    ok = parsed.ec == std::errc();
+    begin = parsed.ptr + 1;
+  };
+  (parse(fields), ...);
+  return ok;
+}
+
+// Sends at rate for the duration, with every message stamped with the time
+// it was due; tick runs between messages. Returns the number sent.
+uint64_t pace(long rate, std::chrono::seconds duration,
+              const std::function<void(uint64_t sequence, int64_t due)>& send, const std::function<void()>& tick) {
+  auto period = std::chrono::nanoseconds(1000000000LL / std::max(1L, rate));
+  auto due = std::chrono::steady_clock::now();
+  auto finish = due + duration;
+  uint64_t sequence = 0;
+  while (!stop_requested && due < finish) {
+    std::this_thread::sleep_until(due);
+    // latency counts from when a message was due, so a sender falling
+    // behind shows up in it instead of being hidden by the late start
+    send(++sequence, std::chrono::duration_cast<std::chrono::nanoseconds>(due.time_since_epoch()).count());
+    due += period;
+    tick();
+  }
+  return sequence;
+}
+
+// Values received on the session callback thread, read by the benchmark
+struct Receiver {
+  // monotonicNow() when publishing started, older values are from an
+  // earlier run
+  std::atomic<int64_t> m_start{0};
+  LatencyHistogram m_latency;
+  std::atomic<uint64_t> m_received{0};
+  std::atomic<uint64_t> m_unparsed{0};
+  // sequence numbers at or below the highest one seen
+  std::atomic<uint64_t> m_reordered{0};
+  uint64_t m_highest{0};
+
+  void onTopic(const Topic& topic) {
+    int64_t now = monotonicNow();
+    if (topic.m_buffer.empty()) {
+      return;
+    }
+    uint64_t sequence = 0;
+    int64_t due = 0;
+    const char* begin = topic.m_buffer.data();
+    if (!parseFields(begin, begin + topic.m_buffer.size(), sequence, due) || sequence == 0) {
+      m_unparsed.store(m_unparsed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return;
+    }
+    if (due < m_start.load(std::memory_order_relaxed)) {
+      return;
+    }
+    m_latency.record(now - due);
+    m_received.store(m_received.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (sequence <= m_highest) {
+      m_reordered.store(m_reordered.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    } else {
+      m_highest = sequence;
+    }
+  }
+};
+
+// the fields as text, padded to size
+template <typename... Fields>
+void formatPayload(std::string& payload, size_t size, Fields... fields) {
+  payload.clear();
+  ((payload += std::to_string(fields), payload += ' '), ...);
+  if (payload.size() < size) {
+    payload.resize(size, 'x');
+  }
+}
+
+// Echoed messages, received on the session callback thread. Every rate
+// step has a histogram of its own, the step is carried in the message.
+struct MessageReceiver {
+  static constexpr size_t kMaxSteps = 16;
+
+  std::array<LatencyHistogram, kMaxSteps> m_round_trips;
+  std::atomic<uint64_t> m_received{0};
+  std::atomic<uint64_t> m_unparsed{0};
+
+  void onMessage(const char* data, size_t size) {
+    int64_t now = monotonicNow();
+    size_t step = 0;
+    int64_t due = 0;
+    if (!parseFields(data, data + size, step, due) || step >= kMaxSteps) {
+      m_unparsed.store(m_unparsed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return;
+    }
+    m_round_trips[step].record(now - due);
+    m_received.store(m_received.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+};
+
+void printLatency(std::ostream& out, const LatencySummary& s) {
+  out << "latency us p50/p90/p99/p99.9/max " << s.m_p50 / 1e3 << "/" << s.m_p90 / 1e3 << "/" << s.m_p99 / 1e3 << "/"
+      << s.m_p999 / 1e3 << "/" << s.m_max / 1e3 << " mean " << s.m_mean / 1e3;
+}
+
+bool control(const char* what, const std::function<bool(Session::ControlCallback&&)>& request) {
+  Outcome outcome;
+  std::string error;
+  if (!request(outcome.callback()) || !outcome.wait(error)) {
+    spdlog::warn("bench {} failed: {}", what, error);
+    std::cerr << "Bench: " << what << " failed" << (error.empty() ? "" : ": ") << error << std::endl;
+    return false;
+  }
+  return true;
+}
+}  // namespace
+
+int runBenchLatency(Session& session, const BenchOptions& options) {
+  const std::string& topic = options.m_topic;
+  auto receiver = std::make_shared<Receiver>();
+  session.setHeadless(true);
+  session.setTopicCallback([receiver](const Topic& t) { receiver->onTopic(t); });
+
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+
+  if (!control("adding topic", [&](auto&& done) { return session.addTopic(topic, std::move(done)); }) ||
+      !control("registering update source",
+               [&](auto&& done) { return session.registerUpdateSource(topic, std::move(done)); })) {
+    return EXIT_FAILURE;
+  }
+  if (!session.subscribe(topic)) {
+    std::cerr << "Bench: subscription to " << topic << " failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  for (int i = 0; i < 1000 && session.isSubscribtionInProgress(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  std::cout << "publishing to " << topic << " " << options.m_rate << "/s for " << options.m_seconds << "s, "
+            << options.m_size << " byte values" << std::endl;
+  spdlog::info("bench latency topic {} rate {} seconds {}", topic, options.m_rate, options.m_seconds);
+
+  auto interval = std::chrono::seconds(std::max(1L, options.m_interval));
+  auto started = std::chrono::steady_clock::now();
+  auto next_report = started + interval;
+  receiver->m_start.store(monotonicNow());
+
+  std::string payload;
+  uint64_t sequence = pace(
+      options.m_rate, std::chrono::seconds(options.m_seconds),
+      [&](uint64_t sequence, int64_t due) {
+        formatPayload(payload, options.m_size, sequence, due);
+        session.update(topic, payload.data(), payload.size());
+      },
+      [&]() {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_report) {
+          double elapsed = std::chrono::duration<double>(now - started).count();
+          std::cout << elapsed << "s received " << receiver->m_received.load() << " ";
+          printLatency(std::cout, receiver->m_latency.summary());
+          std::cout << std::endl;
+          next_report += interval;
+        }
+      });
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+  // values still on their way
+  for (int i = 0; i < 300 && receiver->m_received.load() < sequence; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  uint64_t received = receiver->m_received.load();
+  std::cout << "sent " << sequence << " in " << elapsed << "s (" << sequence / std::max(elapsed, 1e-9)
+            << "/s) received " << received << " missing " << (sequence > received ? sequence - received : 0)
+            << " reordered " << receiver->m_reordered.load() << " unparsed " << receiver->m_unparsed.load()
+            << " update failures " << session.getUpdateFailures() << "\n";
+  printLatency(std::cout, receiver->m_latency.summary());
+  std::cout << std::endl;
+
+  control("removing topic", [&](auto&& done) { return session.removeTopics(topic, std::move(done)); });
+  return received > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int runBenchMessaging(Session& session, const BenchOptions& options) {
+  const std::string& path = options.m_topic;
+  auto receiver = std::make_shared<MessageReceiver>();
+  session.setMessageListener(path, [receiver](const char* data, size_t size) { receiver->onMessage(data, size); });
+
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+
+  if (!control("registering message handler",
+               [&](auto&& done) { return session.registerEcho(path, std::move(done)); })) {
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "sending to " << path << " from " << options.m_rate << "/s, doubling every " << options.m_seconds
+            << "s while the echoes keep up, " << options.m_size << " byte messages" << std::endl;
+  spdlog::info("bench messaging path {} rate {} seconds {}", path, options.m_rate, options.m_seconds);
+
+  std::string payload;
+  uint64_t sent = 0;
+  long sustained = 0;
+  long rate = std::max(1L, options.m_rate);
+  for (size_t step = 0; step < MessageReceiver::kMaxSteps && !stop_requested; ++step, rate *= 2) {
+    uint64_t received_before = receiver->m_received.load();
+    auto started = std::chrono::steady_clock::now();
+    uint64_t step_sent = pace(
+        rate, std::chrono::seconds(std::max(1L, options.m_seconds)),
+        [&](uint64_t, int64_t due) {
+          formatPayload(payload, options.m_size, step, due);
+          session.sendMessage(path, payload.data(), payload.size());
+        },
+        []() {});
+    sent += step_sent;
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    uint64_t received = receiver->m_received.load();
+    // messages still queued somewhere between here, the server and back;
+    // a rate is sustained while that stays under a tenth of a second's worth
+    uint64_t backlog = sent > received ? sent - received : 0;
+    bool keeps_up = backlog <= std::max<uint64_t>(100, rate / 10);
+    std::cout << "offered " << rate << "/s sent " << step_sent / std::max(elapsed, 1e-9) << "/s echoed "
+              << (received - received_before) / std::max(elapsed, 1e-9) << "/s backlog " << backlog << " ";
+    printLatency(std::cout, receiver->m_round_trips[step].summary());
+    std::cout << (keeps_up ? "" : " falling behind") << std::endl;
+    if (!keeps_up) {
+      break;
+    }
+    sustained = rate;
+  }
+
+  // echoes still on their way
+  for (int i = 0; i < 300 && receiver->m_received.load() < sent; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  uint64_t received = receiver->m_received.load();
+  std::cout << "sent " << sent << " echoed " << received << " missing " << (sent > received ? sent - received : 0)
+            << " unparsed " << receiver->m_unparsed.load() << " send failures " << session.getMessageFailures()
+            << "\nsustainable rate " << sustained << "/s" << std::endl;
+  return received > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int runBenchReplay(Session& session, const BenchOptions& options) {
+  const std::string& root = options.m_topic;
+  const size_t topics = std::max<size_t>(1, options.m_topics);
+  std::vector<std::string> paths;
+  paths.reserve(topics);
+  for (size_t i = 0; i < topics; ++i) {
+    paths.push_back(root + "/" + std::to_string(i / 100) + "/" + std::to_string(i));
+  }
+  const std::string selector = "?" + root + "//";
+  std::string payload;
+
+  // on a real transport the requests would go out and the routed replies
+  // race the server's
+  if (!session.usesDummyTransport()) {
+    std::cerr << "Bench: the session is not on the dummy transport, connect it with a dummy:// URL" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+
+  // fetch: a reply per topic, then the response completing it
+  size_t fetched = 0;
+  session.setFetchCompletedCallback([&](std::string&&) { fetched = session.getFetchTopics().size(); });
+  if (!session.fetch(selector)) {
+    std::cerr << "Bench: fetch of " << selector << " failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  auto started = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < topics; ++i) {
+    formatPayload(payload, options.m_size, i, uint64_t(0));
+    session.route(MESSAGE_TYPE_FETCH_REPLY, paths[i], payload.data(), payload.size());
+  }
+  session.onFetchCompleted(nullptr);
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  std::cout << "fetch routed " << topics << " replies in " << elapsed * 1e3 << "ms ("
+            << topics / std::max(elapsed, 1e-9) << "/s), fetched " << fetched << std::endl;
+
+  // subscription: the UI hand-off runs inline, checking every topic's
+  // sequence numbers come in order
+  std::vector<uint64_t> expected(topics, 0);
+  uint64_t handed = 0;
+  uint64_t callbacks = 0;
+  uint64_t out_of_order = 0;
+  uint64_t unparsed = 0;
+  session.setSubscribeBatchCallback([&] {
+    ++callbacks;
+    for (const auto& topic : session.getSubscribeTopics().m_updates) {
+      ++handed;
+      size_t index = 0;
+      uint64_t sequence = 0;
+      const char* begin = topic.m_buffer.data();
+      if (!parseFields(begin, begin + topic.m_buffer.size(), index, sequence) || index >= topics) {
+        ++unparsed;
+        continue;
+      }
+      if (sequence != expected[index]) {
+        ++out_of_order;
+      }
+      expected[index] = sequence + 1;
+    }
+  });
+  if (!session.subscribe(selector)) {
+    std::cerr << "Bench: subscription to " << selector << " failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  session.onSubscribeCompleted();
+
+  started = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < topics; ++i) {
+    formatPayload(payload, options.m_size, i, uint64_t(0));
+    session.route(MESSAGE_TYPE_TOPIC_LOAD, paths[i] + "!" + std::to_string(i + 1), payload.data(), payload.size());
+  }
+  auto loaded = std::chrono::steady_clock::now();
+  std::vector<uint64_t> sequences(topics, 0);
+  uint64_t deltas = 0;
+  for (; deltas < options.m_messages && !stop_requested; ++deltas) {
+    size_t i = deltas % topics;
+    formatPayload(payload, options.m_size, i, ++sequences[i]);
+    session.route(MESSAGE_TYPE_DELTA, "!" + std::to_string(i + 1), payload.data(), payload.size());
+  }
+  auto finished = std::chrono::steady_clock::now();
+
+  double loading = std::chrono::duration<double>(loaded - started).count();
+  double streaming = std::chrono::duration<double>(finished - loaded).count();
+  uint64_t routed = topics + deltas;
+  std::cout << "subscription routed " << topics << " topic loads in " << loading * 1e3 << "ms ("
+            << topics / std::max(loading, 1e-9) << "/s), " << deltas << " deltas in " << streaming << "s ("
+            << deltas / std::max(streaming, 1e-9) << "/s, " << deltas * options.m_size / std::max(streaming, 1e-9) / 1e6
+            << " MB/s)\n"
+            << "handed over " << handed << " of " << routed << " in " << callbacks << " callbacks, out of order "
+            << out_of_order << ", unparsed " << unparsed << ", deltas applied " << session.getDeltas().applied()
+            << " failed " << session.getDeltas().failed() << "\ningest ";
+  printLatency(std::cout, session.getLatency().histogram(LatencyStage::Ingest).summary());
+  std::cout << std::endl;
+  if (handed == 0) {
+    std::cerr << "Bench: no routed update reached the subscription" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return handed == routed && out_of_order == 0 && unparsed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
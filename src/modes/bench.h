@@ -0,0 +1,47 @@
+#ifndef DMON_BENCH_H
+#define DMON_BENCH_H
+
+#include <string>
+
+#include "data/session.h"
+
+struct BenchOptions {
+  // topic published to and subscribed, removed when the run ends, or the
+  // path messages are sent to
+  std::string m_topic;
+  // messages per second
+  long m_rate{1000};
+  // of the run, or of every rate step
+  long m_seconds{10};
+  // payload bytes, at least what the sequence number and time take
+  size_t m_size{64};
+  // seconds between two progress reports
+  long m_interval{1};
+  // topics and messages the replay benchmark routes
+  size_t m_topics{1000};
+  uint64_t m_messages{1000000};
+};
+
+// Publishes timestamped values to a topic of its own through an update
+// source at a fixed rate, subscribes to it and prints percentiles of the
+// one-way latency from the time every value was due to be sent to its
+// arrival. Both ends are in this process, so they share the monotonic
+// clock.
+int runBenchLatency(Session& session, const BenchOptions& options);
+
+// Registers a message handler on the path which sends every message back to
+// its sender and a listener for those, then sends timestamped messages
+// through it at a rate doubling every m_seconds for as long as the echoes
+// keep up. Prints throughput, backlog and round trip percentiles per rate
+// and the highest rate sustained.
+int runBenchMessaging(Session& session, const BenchOptions& options);
+
+// Needs a session on the dummy transport, which it checks. Fetches and
+// subscribes under the topic path, stands in for the server's responses and
+// routes a scripted stream through the client library as fast as it goes:
+// fetch replies and a topic load for each of m_topics topics, then
+// m_messages deltas to them in turn. Prints the throughput of every phase, the messages handed over and
+// whether every topic saw its sequence in order.
+int runBenchReplay(Session& session, const BenchOptions& options);
+
+#endif //DMON_BENCH_H
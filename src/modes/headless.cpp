@@ -0,0 +1,148 @@
+#include "modes/headless.h"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "modes/metrics.h"
+#include "spdlog/spdlog.h"
+
+namespace {
+std::atomic<bool> stop_requested{false};
+
+void onSignal(int) {
+  stop_requested = true;
+}
+
+void printEntries(std::ostream& out, const std::string& title, const std::vector<SpaceSaving::Entry>& entries) {
+  out << title << ":\n";
+  for (const auto& e : entries) {
+    out << std::setw(14) << e.m_count << " +-" << std::setw(12) << std::left << e.m_error << std::right
+        << " " << e.m_key << "\n";
+  }
+}
+
+void printBranch(std::ostream& out, TopicTree& tree, uint32_t index, size_t depth) {
+  auto numbers = tree.numbers(index);
+  if (numbers.m_count == 0) {
+    return;
+  }
+  out << std::setw(10) << numbers.m_count << " sum " << numbers.m_sum << " min " << numbers.m_min << " max "
+      << numbers.m_max << " avg " << numbers.mean() << " " << (index == TopicTree::kRoot ? "/" : tree.path(index))
+      << "\n";
+  if (depth == 0) {
+    return;
+  }
+  for (auto child : tree.children(index)) {
+    printBranch(out, tree, child, depth - 1);
+  }
+}
+}  // namespace
+
+void printStreamSummary(std::ostream& out, const std::string& name, const StreamSummary& s) {
+  out << name << ": messages " << s.m_messages << " distinct topics ~" << static_cast<uint64_t>(s.m_distinct_topics + 0.5)
+      << " size p50/p99/max " << s.m_size_p50 << "/" << s.m_size_p99 << "/" << s.m_size_max
+      << " B gap p50/p99 " << s.m_gap_p50 * 1e3 << "/" << s.m_gap_p99 * 1e3 << " ms\n";
+}
+
+void printAggregates(std::ostream& out, TopicTree& tree, size_t depth) {
+  out << "Numeric topics by branch (depth " << depth << "):\n";
+  printBranch(out, tree, TopicTree::kRoot, depth);
+}
+
+void printHotTopics(std::ostream& out, const HotTopics::Report& report) {
+  out << "messages " << report.m_messages << " bytes " << report.m_bytes << "\n";
+  printEntries(out, "Hot topics by messages", report.m_topics_by_messages);
+  printEntries(out, "Hot topics by bytes", report.m_topics_by_bytes);
+  printEntries(out, "Hot branches (depth " + std::to_string(report.m_depth) + ") by messages", report.m_branches_by_messages);
+  printEntries(out, "Hot branches (depth " + std::to_string(report.m_depth) + ") by bytes", report.m_branches_by_bytes);
+}
+
+namespace {
+std::mutex aggregate_mutex;
+// latest values of the subscribed topics, only fed with -A
+TopicTree aggregate_tree;
+
+void printReport(std::ostream& out, Session& session, const HeadlessOptions& options) {
+  auto selectors = session.getSelectors();
+  for (size_t i = 0; i < selectors.size(); ++i) {
+    printStreamSummary(out, selectors[i], session.getSelectorSummary(i));
+  }
+  printStreamSummary(out, "all", session.getStreamSummary());
+  auto ping = session.getPing().summary();
+  if (ping.m_sent > 0) {
+    out << "ping rtt p50/p99/max " << ping.m_rtt.m_p50 / 1e6 << "/" << ping.m_rtt.m_p99 / 1e6 << "/"
+        << ping.m_rtt.m_max / 1e6 << " ms jitter " << ping.m_jitter / 1e6 << " ms sent " << ping.m_sent << " lost "
+        << ping.m_lost << "\n";
+  }
+  if (options.m_aggregate_depth > 0) {
+    // deltas are only decoded for the aggregates
+    out << "deltas applied " << session.getDeltas().applied() << " without a value " << session.getDeltas().failed()
+        << "\n";
+  }
+  printHotTopics(out, session.getHotTopics().report(options.m_top));
+  if (options.m_aggregate_depth > 0) {
+    std::lock_guard<std::mutex> lk(aggregate_mutex);
+    printAggregates(out, aggregate_tree, options.m_aggregate_depth);
+  }
+}
+}  // namespace
+
+int runHeadless(Session& session, const HeadlessOptions& options) {
+  session.setHeadless(true);
+  session.getHotTopics().configure(options.m_capacity, options.m_depth);
+  if (options.m_aggregate_depth > 0) {
+    session.setTopicCallback([](const Topic& topic) {
+      std::lock_guard<std::mutex> lk(aggregate_mutex);
+      aggregate_tree.update(topic, false);
+    });
+  }
+
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+
+  session.setSubscribeErrorCallback([](Error error) {
+    spdlog::warn("headless subscription error {} message {}", error2Str(error.m_code), error.m_message);
+    std::cerr << "Subscription error " << error2Str(error.m_code) << ": " << error.m_message << std::endl;
+    stop_requested = true;
+  });
+
+  if (!session.subscribe(options.m_selector)) {
+    std::cerr << "Subscription to " << options.m_selector << " failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  MetricsExporter metrics(session);
+  if (options.m_metrics_port > 0) {
+    std::string error;
+    if (!metrics.listen(options.m_metrics_address, options.m_metrics_port, error)) {
+      std::cerr << "Metrics: " << error << std::endl;
+      return EXIT_FAILURE;
+    }
+    spdlog::info("metrics served on http://{}:{}/metrics", options.m_metrics_address, options.m_metrics_port);
+  }
+
+  spdlog::info("headless mode subscribed {} report every {}s", options.m_selector, options.m_interval);
+  auto interval = std::chrono::seconds(std::max(1L, options.m_interval));
+  auto next = std::chrono::steady_clock::now() + interval;
+  while (!stop_requested) {
+    using namespace std::chrono_literals;
+    std::this_thread::sleep_for(100ms);
+    if (std::chrono::steady_clock::now() >= next) {
+      printReport(std::cout, session, options);
+      std::cout << std::endl;
+      std::string error;
+      if (!options.m_metrics_file.empty() && !metrics.writeFile(options.m_metrics_file, error)) {
+        spdlog::warn("metrics file not written: {}", error);
+      }
+      next += interval;
+    }
+  }
+
+  printReport(std::cout, session, options);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,38 @@
+#ifndef DMON_HEADLESS_H
+#define DMON_HEADLESS_H
+
+#include <ostream>
+#include <string>
+
+#include "data/session.h"
+#include "data/topic_tree.h"
+
+struct HeadlessOptions {
+  std::string m_selector;
+  // seconds between two reports
+  long m_interval{10};
+  // entries per report table
+  size_t m_top{20};
+  size_t m_capacity{HotTopics::kDefaultCapacity};
+  size_t m_depth{HotTopics::kDefaultDepth};
+  // path depth of the numeric aggregates report, 0 turns it off
+  size_t m_aggregate_depth{0};
+  // Prometheus metrics served on the address and port, 0 for none, and
+  // written to the file every interval, empty for none
+  std::string m_metrics_address{"127.0.0.1"};
+  int m_metrics_port{0};
+  std::string m_metrics_file;
+};
+
+void printHotTopics(std::ostream& out, const HotTopics::Report& report);
+void printStreamSummary(std::ostream& out, const std::string& name, const StreamSummary& summary);
+// count, sum, min, max and average of the numeric topics under every branch
+// down to depth
+void printAggregates(std::ostream& out, TopicTree& tree, size_t depth);
+
+// Subscribes to the selector and prints periodic reports to stdout until
+// SIGINT or SIGTERM. Aggregates need the latest value of every topic, so
+// only with m_aggregate_depth the topics are kept in a tree.
+int runHeadless(Session& session, const HeadlessOptions& options);
+
+#endif //DMON_HEADLESS_H
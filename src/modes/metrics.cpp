@@ -0,0 +1,251 @@
+#include "modes/metrics.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "spdlog/spdlog.h"
+
+namespace {
+constexpr size_t kMaxRequest = 8 << 10;
+
+// upper bounds of the exported latency buckets, in nanoseconds; the
+// histograms are far finer, these are what dashboards need
+constexpr std::array<int64_t, 19> kBounds{
+    10000,     25000,     50000,     100000,     250000,     500000,     1000000,
+    2500000,   5000000,   10000000,  25000000,   50000000,   100000000,  250000000,
+    500000000, 1000000000, 2500000000, 5000000000, 10000000000};
+
+std::string escape(const std::string& value) {
+  std::string escaped;
+  escaped.reserve(value.size());
+  for (char c : value) {
+    if (c == '\\' || c == '"') {
+      escaped += '\\';
+      escaped += c;
+    } else if (c == '\n') {
+      escaped += "\\n";
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+void family(std::ostream& out, const char* name, const char* type, const char* help) {
+  out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+}
+
+void sample(std::ostream& out, const char* name, const std::string& labels, double value) {
+  out << name;
+  if (!labels.empty()) {
+    out << "{" << labels << "}";
+  }
+  out << " " << value << "\n";
+}
+
+// labels may be empty; the le label is added to them
+void histogram(std::ostream& out, const char* name, const std::string& labels, const LatencyHistogram& h) {
+  std::array<uint64_t, kBounds.size()> counts{};
+  uint64_t total = 0;
+  h.forEach([&](uint64_t highest, uint64_t n) {
+    size_t i = std::lower_bound(kBounds.begin(), kBounds.end(), static_cast<int64_t>(highest)) - kBounds.begin();
+    if (i < counts.size()) {
+      counts[i] += n;
+    }
+    total += n;
+  });
+  std::string prefix = labels.empty() ? std::string() : labels + ",";
+  std::string bucket = std::string(name) + "_bucket";
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < kBounds.size(); ++i) {
+    cumulative += counts[i];
+    char le[32];
+    snprintf(le, sizeof(le), "%g", kBounds[i] / 1e9);
+    sample(out, bucket.c_str(), prefix + "le=\"" + le + "\"", cumulative);
+  }
+  sample(out, bucket.c_str(), prefix + "le=\"+Inf\"", total);
+  // the mean is of the recorded values, the buckets round them up a little
+  sample(out, (std::string(name) + "_sum").c_str(), labels, h.summary().m_mean * total / 1e9);
+  sample(out, (std::string(name) + "_count").c_str(), labels, total);
+}
+}  // namespace
+
+MetricsExporter::MetricsExporter(Session& session) : m_session(session) {}
+
+MetricsExporter::~MetricsExporter() {
+  m_stop = true;
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+  if (m_listener >= 0) {
+    close(m_listener);
+  }
+}
+
+std::string MetricsExporter::render() {
+  std::ostringstream out;
+  out.precision(10);
+
+  family(out, "dmon_session_state", "gauge", "1 for the state the session is in");
+  auto state = m_session.getState();
+  for (int s = SESSION_STATE_UNKNOWN; s <= CLOSED_FAILED; ++s) {
+    sample(out, "dmon_session_state", "state=\"" + state2String(static_cast<SESSION_STATE_T>(s)) + "\"",
+           s == state ? 1 : 0);
+  }
+  family(out, "dmon_session_reconnects_total", "counter", "Recoveries started after the connection was lost");
+  sample(out, "dmon_session_reconnects_total", "", m_session.getReconnects());
+
+  // slots of the selectors never move, their counters are atomics
+  auto selectors = m_session.getSelectors();
+  std::vector<RateSampler::Rates> rates(selectors.size());
+  {
+    std::lock_guard<std::mutex> lk(m_rates_mutex);
+    m_rates.sample(
+        selectors.size(), [this](size_t i) { return m_session.getSelectorCounters(i).load(); },
+        std::chrono::steady_clock::now());
+    for (size_t i = 0; i < selectors.size(); ++i) {
+      rates[i] = m_rates.rates(i);
+    }
+  }
+  std::vector<std::string> labels;
+  for (const auto& selector : selectors) {
+    labels.push_back("selector=\"" + escape(selector) + "\"");
+  }
+  family(out, "dmon_messages_total", "counter", "Subscribed messages received per selector");
+  for (size_t i = 0; i < selectors.size(); ++i) {
+    sample(out, "dmon_messages_total", labels[i], m_session.getSelectorCounters(i).load().m_messages);
+  }
+  family(out, "dmon_bytes_total", "counter", "Payload bytes of the subscribed messages per selector");
+  for (size_t i = 0; i < selectors.size(); ++i) {
+    sample(out, "dmon_bytes_total", labels[i], m_session.getSelectorCounters(i).load().m_bytes);
+  }
+  family(out, "dmon_message_rate", "gauge", "Messages per second per selector since the previous scrape");
+  for (size_t i = 0; i < selectors.size(); ++i) {
+    sample(out, "dmon_message_rate", labels[i], rates[i].m_messages);
+  }
+  family(out, "dmon_byte_rate", "gauge", "Payload bytes per second per selector since the previous scrape");
+  for (size_t i = 0; i < selectors.size(); ++i) {
+    sample(out, "dmon_byte_rate", labels[i], rates[i].m_bytes);
+  }
+
+  family(out, "dmon_deltas_applied_total", "counter", "Deltas turned into full values");
+  sample(out, "dmon_deltas_applied_total", "", m_session.getDeltas().applied());
+  family(out, "dmon_deltas_failed_total", "counter", "Deltas which came without a value to apply them to");
+  sample(out, "dmon_deltas_failed_total", "", m_session.getDeltas().failed());
+
+  auto ping = m_session.getPing().summary();
+  family(out, "dmon_pings_sent_total", "counter", "Pings sent to the server");
+  sample(out, "dmon_pings_sent_total", "", ping.m_sent);
+  family(out, "dmon_pings_lost_total", "counter", "Pings without a reply in time");
+  sample(out, "dmon_pings_lost_total", "", ping.m_lost);
+  family(out, "dmon_ping_rtt_seconds", "histogram", "Round trip time of the pings");
+  histogram(out, "dmon_ping_rtt_seconds", "", m_session.getPing().rtt());
+
+  auto& latency = m_session.getLatency();
+  family(out, "dmon_latency_seconds", "histogram", "Time subscribed messages spend in each stage on their way to the screen");
+  for (size_t i = 0; i < PipelineLatency::kStages; ++i) {
+    auto stage = static_cast<LatencyStage>(i);
+    histogram(out, "dmon_latency_seconds", std::string("stage=\"") + PipelineLatency::name(stage) + "\"",
+              latency.histogram(stage));
+  }
+  return out.str();
+}
+
+bool MetricsExporter::listen(const std::string& address, int port, std::string& error) {
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+    error = "bad address " + address;
+    return false;
+  }
+  m_listener = ::socket(AF_INET, SOCK_STREAM, 0);
+  int on = 1;
+  if (m_listener < 0 || setsockopt(m_listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 ||
+      bind(m_listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(m_listener, 8) != 0) {
+    error = address + ":" + std::to_string(port) + ": " + strerror(errno);
+    return false;
+  }
+  m_thread = std::thread([this] { serve(); });
+  return true;
+}
+
+void MetricsExporter::serve() {
+  pollfd listener{m_listener, POLLIN, 0};
+  while (!m_stop) {
+    if (poll(&listener, 1, 200) <= 0) {
+      continue;
+    }
+    int fd = accept(m_listener, nullptr, nullptr);
+    if (fd < 0) {
+      continue;
+    }
+    // scrapes are rare and small, one at a time on this thread is plenty
+    timeval timeout{1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    respond(fd);
+    close(fd);
+  }
+}
+
+void MetricsExporter::respond(int fd) {
+  std::string request;
+  char buffer[1024];
+  while (request.find("\r\n\r\n") == std::string::npos) {
+    ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+    if (n <= 0 || request.size() + n > kMaxRequest) {
+      return;
+    }
+    request.append(buffer, n);
+  }
+
+  std::string status = "200 OK";
+  std::string body;
+  if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0) {
+    body = render();
+  } else {
+    status = "404 Not Found";
+    body = "metrics are at /metrics\n";
+  }
+  std::string response = "HTTP/1.1 " + status +
+                         "\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: " +
+                         std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+  size_t sent = 0;
+  while (sent < response.size()) {
+    ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      spdlog::debug("metrics response not sent: {}", strerror(errno));
+      return;
+    }
+    sent += n;
+  }
+}
+
+bool MetricsExporter::writeFile(const std::string& path, std::string& error) {
+  std::string temporary = path + ".tmp";
+  {
+    std::ofstream out(temporary, std::ios::trunc);
+    if (!out || !(out << render()) || !out.flush()) {
+      error = temporary + ": " + strerror(errno);
+      return false;
+    }
+  }
+  if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+    error = path + ": " + strerror(errno);
+    return false;
+  }
+  return true;
+}
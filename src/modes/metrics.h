@@ -0,0 +1,48 @@
+#ifndef DMON_METRICS_H
+#define DMON_METRICS_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "data/session.h"
+#include "data/topic_stats.h"
+
+// Prometheus text format (0.0.4) view of a session for monitoring stacks to
+// scrape: session state and reconnects, per selector message and byte
+// counters and rates, deltas, pings and the latency histograms. Everything
+// is read from the relaxed atomics the callback thread writes, never from
+// the sketches it locks, so rendering does not hold up ingestion. Either
+// served over HTTP or written to a file for the node exporter's textfile
+// collector.
+class MetricsExporter {
+ public:
+  explicit MetricsExporter(Session& session);
+  ~MetricsExporter();
+
+  MetricsExporter(const MetricsExporter&) = delete;
+  MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+  // rates are per second since the previous render at least a second ago
+  std::string render();
+
+  // serves GET /metrics from a thread of its own until destroyed
+  bool listen(const std::string& address, int port, std::string& error);
+  // writes a temporary file next to the path and renames it over the path,
+  // so the collector never reads a partial one
+  bool writeFile(const std::string& path, std::string& error);
+
+ private:
+  void serve();
+  void respond(int fd);
+
+  Session& m_session;
+  std::mutex m_rates_mutex;
+  RateSampler m_rates;
+  int m_listener{-1};
+  std::atomic<bool> m_stop{false};
+  std::thread m_thread;
+};
+
+#endif //DMON_METRICS_H
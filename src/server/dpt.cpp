@@ -0,0 +1,149 @@
+#include "server/dpt.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+template <typename Request>
+std::string unmarshalSelector(SESSION_T* session, const BUF_T* payload,
+                              Request* (*unmarshal)(SESSION_T*, const BUF_T*),
+                              void (*release)(SESSION_T*, Request*)) {
+  Request* request = unmarshal(session, payload);
+  if (request == nullptr) {
+    return std::string();
+  }
+  std::string selector = request->topic_selector != nullptr ? request->topic_selector : "";
+  release(session, request);
+  return selector;
+}
+
+template <typename Response>
+BUF_T* marshalEmpty(SESSION_T* session, Response* (*create)(SESSION_T*),
+                    BUF_T* (*marshal)(SESSION_T*, const Response*), void (*release)(SESSION_T*, Response*)) {
+  Response* response = create(session);
+  BUF_T* body = marshal(session, response);
+  release(session, response);
+  return body;
+}
+}  // namespace
+
+DptCodec::DptCodec()
+    : m_session(static_cast<SESSION_T*>(calloc(1, sizeof(SESSION_T)))),
+      m_details(create_topic_details_single_value(M_DATA_TYPE_STRING)) {}
+
+DptCodec::~DptCodec() {
+  topic_details_free(m_details);
+  free(m_session);
+}
+
+std::string DptCodec::connectionResponse(uint64_t server, uint64_t session) {
+  char identity[40];
+  snprintf(identity, sizeof(identity), "%016" PRIx64 "-%016" PRIx64, server, session);
+  std::string response;
+  response += static_cast<char>(DPT_PROTOCOL_BYTE);
+  response += static_cast<char>(WS_PROTOCOL_VERSION);
+  response += static_cast<char>(CONNECTION_RESPONSE_CODE_OK);
+  response += identity;
+  response += static_cast<char>(DPT_RECORD_DELIM);
+  return response;
+}
+
+std::string DptCodec::message(MESSAGE_TYPE_T type, const std::vector<std::string>& headers,
+                              const std::string& payload) {
+  std::string message;
+  size_t size = 3 + payload.size();
+  for (const auto& header : headers) {
+    size += header.size() + 1;
+  }
+  message.reserve(size);
+  message += static_cast<char>(type);
+  message += static_cast<char>(DPT_ENCODING_NONE);
+  for (size_t i = 0; i < headers.size(); ++i) {
+    if (i > 0) {
+      message += static_cast<char>(DPT_FIELD_DELIM);
+    }
+    message += headers[i];
+  }
+  message += static_cast<char>(DPT_RECORD_DELIM);
+  message += payload;
+  return message;
+}
+
+std::string DptCodec::topicLoad(const std::string& path, uint32_t alias, const std::string& value) {
+  return message(MESSAGE_TYPE_TOPIC_LOAD, {path + "!" + std::to_string(alias)}, value);
+}
+
+std::string DptCodec::delta(uint32_t alias, const std::string& value) {
+  return message(MESSAGE_TYPE_DELTA, {"!" + std::to_string(alias)}, value);
+}
+
+std::string DptCodec::fetchReply(const std::string& path, const std::string& value) {
+  return message(MESSAGE_TYPE_FETCH_REPLY, {path}, value);
+}
+
+std::string DptCodec::service(SERVICE_TYPE_T type, SERVICE_MODE_T mode, uint64_t conversation, BUF_T* body) {
+  if (body == nullptr) {
+    body = buf_create();
+  }
+  BUF_T* envelope = transport_envelope_buf(type, mode, (CONVERSATION_ID_T){.id = conversation}, body);
+  std::string message(envelope->data, envelope->len);
+  buf_free(envelope);
+  buf_free(body);
+  return message;
+}
+
+V5_MESSAGE_T* DptCodec::parseService(const std::string& message) {
+  BUF_T buf{const_cast<char*>(message.data()), message.size()};
+  return v5_message_parse(&buf);
+}
+
+std::string DptCodec::selector(const V5_MESSAGE_T& request) const {
+  switch (request.service_type) {
+    case SVC_SUBSCRIBE:
+      return unmarshalSelector(m_session, request.payload, svc_subscribe_request_unmarshal,
+                               svc_subscribe_request_free);
+    case SVC_UNSUBSCRIBE:
+      return unmarshalSelector(m_session, request.payload, svc_unsubscribe_request_unmarshal,
+                               svc_unsubscribe_request_free);
+    case SVC_FETCH:
+      return unmarshalSelector(m_session, request.payload, svc_fetch_request_unmarshal, svc_fetch_request_free);
+    default:
+      return std::string();
+  }
+}
+
+BUF_T* DptCodec::response(SERVICE_TYPE_T type) const {
+  switch (type) {
+    case SVC_SUBSCRIBE:
+      return marshalEmpty(m_session, svc_subscribe_response_create, svc_subscribe_response_marshal,
+                          svc_subscribe_response_free);
+    case SVC_UNSUBSCRIBE:
+      return marshalEmpty(m_session, svc_unsubscribe_response_create, svc_unsubscribe_response_marshal,
+                          svc_unsubscribe_response_free);
+    case SVC_FETCH:
+      return marshalEmpty(m_session, svc_fetch_response_create, svc_fetch_response_marshal,
+                          svc_fetch_response_free);
+    case SVC_PING_USER:
+      return marshalEmpty(m_session, svc_ping_user_response_create, svc_ping_user_response_marshal,
+                          svc_ping_user_response_free);
+    default:
+      return buf_create();
+  }
+}
+
+BUF_T* DptCodec::subscriptionNotification(uint32_t id, const std::string& path) const {
+  SVC_NOTIFY_SUBSCRIPTION_REQUEST_T request{};
+  request.topic_info.topic_id = id;
+  request.topic_info.topic_path = const_cast<char*>(path.c_str());
+  request.topic_details = m_details;
+  return svc_notify_subscription_request_marshal(m_session, &request);
+}
+
+BUF_T* DptCodec::unsubscriptionNotification(uint32_t id, const std::string& path) const {
+  SVC_NOTIFY_UNSUBSCRIPTION_REQUEST_T request{};
+  request.topic_id = id;
+  request.topic_path = const_cast<char*>(path.c_str());
+  request.reason = UNSUBSCRIPTION_REASON_REQUESTED;
+  return svc_notify_unsubscription_request_marshal(m_session, &request);
+}
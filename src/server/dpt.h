@@ -0,0 +1,56 @@
+#ifndef DMON_DPT_H
+#define DMON_DPT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "diffusion.h"
+
+extern "C" {
+#include "internal/topic_int.h"
+}
+
+// Server side of the DPT framing over WebSocket. The client library carries
+// both halves of its codec, so service messages are enveloped and parsed
+// with its own functions and only the DPT v4 topic messages and the
+// connection response are put together here. Every message is one
+// WebSocket binary message.
+class DptCodec {
+ public:
+  DptCodec();
+  ~DptCodec();
+
+  DptCodec(const DptCodec&) = delete;
+  DptCodec& operator=(const DptCodec&) = delete;
+
+  // first message of a connection, accepting it with the session id
+  static std::string connectionResponse(uint64_t server, uint64_t session);
+  // type, encoding, headers separated by field delimiters and closed by a
+  // record delimiter, payload
+  static std::string message(MESSAGE_TYPE_T type, const std::vector<std::string>& headers, const std::string& payload);
+  // a topic load defines the alias later deltas name the topic by
+  static std::string topicLoad(const std::string& path, uint32_t alias, const std::string& value);
+  static std::string delta(uint32_t alias, const std::string& value);
+  static std::string fetchReply(const std::string& path, const std::string& value);
+
+  // takes ownership of the body, which may be null
+  static std::string service(SERVICE_TYPE_T type, SERVICE_MODE_T mode, uint64_t conversation, BUF_T* body);
+  // null if the message is not a service message
+  static V5_MESSAGE_T* parseService(const std::string& message);
+
+  // selector of a subscribe, unsubscribe or fetch request
+  std::string selector(const V5_MESSAGE_T& request) const;
+  // body of the empty response to a request
+  BUF_T* response(SERVICE_TYPE_T type) const;
+  BUF_T* subscriptionNotification(uint32_t id, const std::string& path) const;
+  BUF_T* unsubscriptionNotification(uint32_t id, const std::string& path) const;
+
+ private:
+  // the marshalling functions are written for the client end and take its
+  // session; a blank one stands in for it
+  SESSION_T* m_session;
+  TOPIC_DETAILS_T* m_details;
+};
+
+#endif //DMON_DPT_H
@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "args.h"
+#include "server/script.h"
+#include "server/server.h"
+#include "spdlog/spdlog.h"
+
+namespace {
+std::atomic<bool> stop_requested{false};
+
+void onSignal(int) {
+  stop_requested = true;
+}
+
+// a thousand topics when no script is given
+constexpr char kDefaultScript[] = "dmon/standin/{1..10}/{1..100}\n";
+}  // namespace
+
+ARG_OPTS_T arg_opts[] = {
+    ARG_OPTS_HELP,
+    {'a', "address", "Address to listen on", ARG_OPTIONAL, ARG_HAS_VALUE, "127.0.0.1" },
+    {'p', "port", "Port to listen on, dmon connects with -u ws://<address>:<port>", ARG_OPTIONAL, ARG_HAS_VALUE, "8080" },
+    {'f', "script", "Topic tree, one '<path> [rate] [size]' line per group of topics, {first..last} ranges in the path expand to a topic each", ARG_OPTIONAL, ARG_HAS_VALUE, NULL },
+    {'r', "rate", "Updates per second of the topics the script gives no rate for", ARG_OPTIONAL, ARG_HAS_VALUE, "1" },
+    {'z', "size", "Value bytes of the topics the script gives no size for", ARG_OPTIONAL, ARG_HAS_VALUE, "64" },
+    {'i', "interval", "Seconds between two statistics reports", ARG_OPTIONAL, ARG_HAS_VALUE, "10" },
+    END_OF_ARG_OPTS
+};
+
+int main(int argc, char** argv) {
+  HASH_T* options = parse_cmdline(argc, argv, arg_opts);
+  if (options == nullptr || hash_get(options, "help") != nullptr) {
+    std::cout << "Usage: dmon-server [options]\n";
+    for (size_t i = 0; i < sizeof(arg_opts) / sizeof(arg_opts[0]) - 1; ++i) {
+      std::cout << "-" << arg_opts[i].short_arg << "/-" << arg_opts[i].long_arg << "  " << arg_opts[i].description;
+      if (arg_opts[i].default_value != nullptr) {
+        std::cout << " default value: " << arg_opts[i].default_value;
+      }
+      std::cout << "\n";
+    }
+    return EXIT_FAILURE;
+  }
+
+  double rate = std::atof(static_cast<const char*>(hash_get(options, "rate")));
+  size_t size = std::atol(static_cast<const char*>(hash_get(options, "size")));
+  std::vector<ScriptedTopic> topics;
+  std::string error;
+  bool loaded = false;
+  if (hash_get(options, "script") != nullptr) {
+    loaded = loadScript(static_cast<const char*>(hash_get(options, "script")), rate, size, topics, error);
+  } else {
+    std::istringstream script(kDefaultScript);
+    loaded = parseScript(script, rate, size, topics, error);
+  }
+  if (!loaded) {
+    std::cerr << "Script: " << error << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  StandInServer server(topics);
+  const char* address = static_cast<const char*>(hash_get(options, "address"));
+  int port = std::atoi(static_cast<const char*>(hash_get(options, "port")));
+  if (!server.listen(address, port, error)) {
+    std::cerr << "Listen: " << error << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "serving " << topics.size() << " topics on ws://" << address << ":" << port << std::endl;
+
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+  std::thread runner([&server] { server.run(stop_requested); });
+
+  auto interval = std::chrono::seconds(std::max(1L, std::atol(static_cast<const char*>(hash_get(options, "interval")))));
+  auto last = std::chrono::steady_clock::now();
+  auto next_report = last + interval;
+  ServerStats previous;
+  while (!stop_requested) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto now = std::chrono::steady_clock::now();
+    if (now < next_report) {
+      continue;
+    }
+    double elapsed = std::chrono::duration<double>(now - last).count();
+    auto s = server.stats();
+    std::cout << "connections " << s.m_connections << " accepted " << s.m_accepted << " updates/s "
+              << (s.m_updates - previous.m_updates) / elapsed << " messages/s "
+              << (s.m_messages - previous.m_messages) / elapsed << " bytes/s "
+              << (s.m_bytes - previous.m_bytes) / elapsed << std::endl;
+    previous = s;
+    last = now;
+    next_report += interval;
+  }
+  runner.join();
+  spdlog::info("stand-in server finished");
+  return EXIT_SUCCESS;
+}
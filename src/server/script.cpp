@@ -0,0 +1,103 @@
+#include "server/script.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+constexpr size_t kMaxTopics = 10000000;
+
+// appends every path the pattern expands to
+bool expand(const std::string& pattern, std::vector<std::string>& paths, std::string& error) {
+  size_t open = pattern.find('{');
+  if (open == std::string::npos) {
+    paths.push_back(pattern);
+    return true;
+  }
+  size_t dots = pattern.find("..", open);
+  size_t close = pattern.find('}', open);
+  long first = 0;
+  long last = 0;
+  char* end = nullptr;
+  if (dots == std::string::npos || close == std::string::npos || dots > close) {
+    error = "unterminated range in " + pattern;
+    return false;
+  }
+  first = strtol(pattern.c_str() + open + 1, &end, 10);
+  if (end != pattern.c_str() + dots) {
+    error = "bad range start in " + pattern;
+    return false;
+  }
+  last = strtol(pattern.c_str() + dots + 2, &end, 10);
+  if (end != pattern.c_str() + close || last < first) {
+    error = "bad range end in " + pattern;
+    return false;
+  }
+  std::string prefix = pattern.substr(0, open);
+  std::string rest = pattern.substr(close + 1);
+  for (long i = first; i <= last; ++i) {
+    if (paths.size() > kMaxTopics) {
+      error = "more than " + std::to_string(kMaxTopics) + " topics";
+      return false;
+    }
+    if (!expand(prefix + std::to_string(i) + rest, paths, error)) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+bool parseScript(std::istream& in, double rate, size_t size, std::vector<ScriptedTopic>& topics,
+                 std::string& error) {
+  std::string line;
+  std::vector<std::string> paths;
+  for (size_t number = 1; std::getline(in, line); ++number) {
+    std::istringstream fields(line);
+    std::string pattern;
+    if (!(fields >> pattern) || pattern[0] == '#') {
+      continue;
+    }
+    ScriptedTopic topic;
+    topic.m_rate = rate;
+    topic.m_size = size;
+    if (!(fields >> std::ws).eof() && !(fields >> topic.m_rate)) {
+      error = "line " + std::to_string(number) + ": bad rate";
+      return false;
+    }
+    if (!(fields >> std::ws).eof() && !(fields >> topic.m_size)) {
+      error = "line " + std::to_string(number) + ": bad size";
+      return false;
+    }
+    paths.clear();
+    if (!expand(pattern, paths, error)) {
+      error = "line " + std::to_string(number) + ": " + error;
+      return false;
+    }
+    for (auto& path : paths) {
+      topic.m_path = std::move(path);
+      topics.push_back(topic);
+    }
+  }
+  if (topics.empty()) {
+    error = "no topics";
+    return false;
+  }
+  return true;
+}
+
+bool loadScript(const std::string& file, double rate, size_t size, std::vector<ScriptedTopic>& topics,
+                std::string& error) {
+  std::ifstream in(file);
+  if (!in) {
+    error = file + ": " + strerror(errno);
+    return false;
+  }
+  if (!parseScript(in, rate, size, topics, error)) {
+    error = file + ": " + error;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,29 @@
+#ifndef DMON_SCRIPT_H
+#define DMON_SCRIPT_H
+
+#include <istream>
+#include <string>
+#include <vector>
+
+struct ScriptedTopic {
+  std::string m_path;
+  // updates per second, 0 for a topic which never changes
+  double m_rate{0};
+  // value bytes, at least what the version and time take
+  size_t m_size{0};
+};
+
+// Topic tree of the stand-in server, one line per group of topics:
+//
+//   # comment
+//   <path> [rate] [size]
+//
+// A path may repeat {first..last} ranges, every combination of them is a
+// topic: prices/{1..50}/{1..20} 5 128 makes 1000 topics updated five times
+// a second with 128 byte values. Rate and size default to the given ones.
+bool parseScript(std::istream& in, double rate, size_t size, std::vector<ScriptedTopic>& topics,
+                 std::string& error);
+bool loadScript(const std::string& file, double rate, size_t size, std::vector<ScriptedTopic>& topics,
+                std::string& error);
+
+#endif //DMON_SCRIPT_H
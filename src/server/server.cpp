@@ -0,0 +1,432 @@
+#include "server/server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <queue>
+#include <random>
+#include <regex>
+#include <utility>
+
+#include "data/topic_stats.h"
+#include "spdlog/spdlog.h"
+
+namespace {
+constexpr char kSetSeparator[] = "////";
+// a generator this far behind starts over from now rather than catching up
+constexpr int64_t kMaxLag = 1000000000LL;
+
+// one selector of a set, see StandInServer
+class Selector {
+ public:
+  explicit Selector(std::string selector) {
+    if (selector.size() >= 2 && selector.compare(selector.size() - 2, 2, "//") == 0) {
+      m_descendants = true;
+      selector.resize(selector.size() - 2);
+    }
+    char kind = selector.empty() ? '>' : selector[0];
+    if (kind == '>' || kind == '?' || kind == '*') {
+      selector.erase(0, 1);
+    } else {
+      kind = '>';
+    }
+    if (kind == '>') {
+      m_path = trim(selector);
+    } else {
+      try {
+        m_pattern = std::regex(trim(selector), std::regex::ECMAScript | std::regex::nosubs);
+        m_regex = true;
+      } catch (const std::regex_error&) {
+        spdlog::warn("stand-in server: bad selector pattern {}", selector);
+      }
+    }
+  }
+
+  bool matches(const std::string& path) const {
+    if (!m_regex) {
+      return path == m_path ||
+             (m_descendants && path.size() > m_path.size() && path.compare(0, m_path.size(), m_path) == 0 &&
+              path[m_path.size()] == '/');
+    }
+    if (std::regex_match(path, m_pattern)) {
+      return true;
+    }
+    // the topic or any of its ancestors
+    for (size_t slash = path.rfind('/'); m_descendants && slash != std::string::npos && slash > 0;
+         slash = path.rfind('/', slash - 1)) {
+      if (std::regex_match(path.begin(), path.begin() + slash, m_pattern)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  static std::string trim(const std::string& path) {
+    size_t begin = path.find_first_not_of('/');
+    return begin == std::string::npos ? std::string() : path.substr(begin);
+  }
+
+  std::string m_path;
+  std::regex m_pattern;
+  bool m_regex{false};
+  bool m_descendants{false};
+};
+
+std::vector<Selector> parseSelector(const std::string& selector) {
+  std::vector<Selector> selectors;
+  if (selector.empty() || selector[0] != '#') {
+    selectors.emplace_back(selector);
+    return selectors;
+  }
+  for (size_t begin = 1; begin <= selector.size();) {
+    size_t end = selector.find(kSetSeparator, begin);
+    if (end == std::string::npos) {
+      end = selector.size();
+    }
+    if (end > begin) {
+      selectors.emplace_back(selector.substr(begin, end - begin));
+    }
+    begin = end + sizeof(kSetSeparator) - 1;
+  }
+  return selectors;
+}
+
+bool matchesAny(const std::vector<Selector>& selectors, const std::string& path) {
+  return std::any_of(selectors.begin(), selectors.end(), [&path](const Selector& s) { return s.matches(path); });
+}
+}  // namespace
+
+StandInServer::StandInServer(const std::vector<ScriptedTopic>& topics) : m_server_id(std::random_device()()) {
+  m_topics.reserve(topics.size());
+  int64_t now = monotonicNow();
+  for (const auto& script : topics) {
+    ServedTopic topic;
+    topic.m_script = script;
+    topic.m_id = static_cast<uint32_t>(m_topics.size() + 1);
+    update(topic, now);
+    m_topics.push_back(std::move(topic));
+  }
+}
+
+StandInServer::~StandInServer() {
+  if (m_listener >= 0) {
+    ::close(m_listener);
+  }
+}
+
+bool StandInServer::listen(const std::string& address, int port, std::string& error) {
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+    error = "bad address " + address;
+    return false;
+  }
+  m_listener = ::socket(AF_INET, SOCK_STREAM, 0);
+  int on = 1;
+  if (m_listener < 0 || setsockopt(m_listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 ||
+      bind(m_listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(m_listener, 64) != 0) {
+    error = address + ":" + std::to_string(port) + ": " + strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+void StandInServer::run(const std::atomic<bool>& stop_requested) {
+  std::thread generator([this, &stop_requested] { generate(stop_requested); });
+  pollfd listener{m_listener, POLLIN, 0};
+  while (!stop_requested) {
+    reap();
+    if (poll(&listener, 1, 200) <= 0) {
+      continue;
+    }
+    int fd = accept(m_listener, nullptr, nullptr);
+    if (fd < 0) {
+      continue;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    auto connection = std::make_shared<Connection>(fd);
+    m_accepted.fetch_add(1, std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> lk(m_connections_mutex);
+      m_connections.push_back(connection);
+    }
+    m_workers.push_back(Worker{connection, std::thread([this, connection] { serve(connection); })});
+  }
+
+  generator.join();
+  {
+    std::lock_guard<std::mutex> lk(m_connections_mutex);
+    for (auto& connection : m_connections) {
+      connection->m_socket.shutdown();
+    }
+  }
+  for (auto& worker : m_workers) {
+    worker.m_thread.join();
+  }
+  m_workers.clear();
+}
+
+void StandInServer::reap() {
+  auto closed = std::partition(m_workers.begin(), m_workers.end(),
+                               [](const Worker& worker) { return !worker.m_connection->m_closed; });
+  for (auto it = closed; it != m_workers.end(); ++it) {
+    it->m_thread.join();
+  }
+  m_workers.erase(closed, m_workers.end());
+}
+
+ServerStats StandInServer::stats() const {
+  ServerStats s;
+  {
+    std::lock_guard<std::mutex> lk(m_connections_mutex);
+    s.m_connections = m_connections.size();
+  }
+  s.m_accepted = m_accepted.load(std::memory_order_relaxed);
+  s.m_updates = m_updates.load(std::memory_order_relaxed);
+  s.m_messages = m_messages.load(std::memory_order_relaxed);
+  s.m_bytes = m_bytes.load(std::memory_order_relaxed);
+  return s;
+}
+
+void StandInServer::serve(std::shared_ptr<Connection> connection) {
+  std::string target;
+  std::string error;
+  if (!connection->m_socket.handshake(target, error)) {
+    spdlog::warn("stand-in server: handshake failed: {}", error);
+  } else {
+    uint64_t session = m_sessions.fetch_add(1, std::memory_order_relaxed) + 1;
+    spdlog::info("stand-in server: session {} connected to {}", session, target);
+    {
+      std::lock_guard<std::mutex> lk(m_topics_mutex);
+      connection->m_subscribed.assign(m_topics.size(), false);
+    }
+    std::string message;
+    if (connection->m_socket.send(DptCodec::connectionResponse(m_server_id, session))) {
+      while (connection->m_socket.read(message)) {
+        if (message.empty()) {
+          continue;
+        }
+        auto type = static_cast<MESSAGE_TYPE_T>(static_cast<unsigned char>(message[0]));
+        if (type == MESSAGE_TYPE_PING_SERVER || type == MESSAGE_TYPE_PING_CLIENT) {
+          connection->m_socket.send(message);
+          continue;
+        }
+        if (type == MESSAGE_TYPE_CLOSE_REQUEST) {
+          break;
+        }
+        V5_MESSAGE_T* v5 = DptCodec::parseService(message);
+        if (v5 == nullptr) {
+          spdlog::warn("stand-in server: session {} sent an unknown message type {}", session, int(type));
+          continue;
+        }
+        // replies to the notifications need nothing more
+        if (v5->service_mode == MODE_REQUEST) {
+          onRequest(*connection, *v5);
+        }
+        v5_message_free(v5);
+      }
+    }
+    spdlog::info("stand-in server: session {} closed", session);
+  }
+
+  {
+    std::lock_guard<std::mutex> lk(m_connections_mutex);
+    m_connections.erase(std::remove(m_connections.begin(), m_connections.end(), connection), m_connections.end());
+  }
+  connection->m_closed = true;
+}
+
+void StandInServer::onRequest(Connection& connection, const V5_MESSAGE_T& request) {
+  uint64_t conversation = request.conversation_id.id;
+  std::string selector;
+  size_t selected = 0;
+  // topics go out before the response, which completes the request for
+  // the client
+  switch (request.service_type) {
+    case SVC_SUBSCRIBE:
+      selector = m_codec.selector(request);
+      selected = subscribe(connection, selector);
+      break;
+    case SVC_UNSUBSCRIBE:
+      selector = m_codec.selector(request);
+      selected = unsubscribe(connection, selector);
+      break;
+    case SVC_FETCH:
+      selector = m_codec.selector(request);
+      selected = fetch(connection, selector);
+      break;
+    case SVC_PING_USER:
+      break;
+    default:
+      spdlog::warn("stand-in server: service {} not supported", int(request.service_type));
+      send(connection, DptCodec::service(request.service_type, MODE_ERROR, conversation, nullptr));
+      return;
+  }
+  if (!selector.empty()) {
+    spdlog::debug("stand-in server: service {} selector {} selects {} topics", int(request.service_type), selector,
+                  selected);
+  }
+  send(connection,
+       DptCodec::service(request.service_type, MODE_RESPONSE, conversation, m_codec.response(request.service_type)));
+}
+
+size_t StandInServer::subscribe(Connection& connection, const std::string& selector) {
+  auto selectors = parseSelector(selector);
+  size_t selected = 0;
+  std::vector<std::string> messages;
+  // the deltas of the topics wait for the loads, the other connections
+  // do not wait for this one's socket
+  std::lock_guard<std::mutex> order(connection.m_send_mutex);
+  {
+    std::lock_guard<std::mutex> lk(m_topics_mutex);
+    for (size_t i = 0; i < m_topics.size(); ++i) {
+      const auto& topic = m_topics[i];
+      if (!matchesAny(selectors, topic.m_script.m_path)) {
+        continue;
+      }
+      ++selected;
+      if (connection.m_subscribed[i]) {
+        continue;
+      }
+      connection.m_subscribed[i] = true;
+      messages.push_back(DptCodec::service(SVC_NOTIFY_SUBSCRIPTION, MODE_REQUEST, ++connection.m_conversation,
+                                           m_codec.subscriptionNotification(topic.m_id, topic.m_script.m_path)));
+      messages.push_back(DptCodec::topicLoad(topic.m_script.m_path, topic.m_id, topic.m_value));
+    }
+  }
+  for (const auto& message : messages) {
+    send(connection, message);
+  }
+  return selected;
+}
+
+size_t StandInServer::unsubscribe(Connection& connection, const std::string& selector) {
+  auto selectors = parseSelector(selector);
+  size_t selected = 0;
+  std::vector<std::string> messages;
+  {
+    std::lock_guard<std::mutex> lk(m_topics_mutex);
+    for (size_t i = 0; i < m_topics.size(); ++i) {
+      const auto& topic = m_topics[i];
+      if (!connection.m_subscribed[i] || !matchesAny(selectors, topic.m_script.m_path)) {
+        continue;
+      }
+      ++selected;
+      connection.m_subscribed[i] = false;
+      messages.push_back(DptCodec::service(SVC_NOTIFY_UNSUBSCRIPTION, MODE_REQUEST, ++connection.m_conversation,
+                                           m_codec.unsubscriptionNotification(topic.m_id, topic.m_script.m_path)));
+    }
+  }
+  for (const auto& message : messages) {
+    send(connection, message);
+  }
+  return selected;
+}
+
+size_t StandInServer::fetch(Connection& connection, const std::string& selector) {
+  auto selectors = parseSelector(selector);
+  std::vector<std::string> messages;
+  {
+    std::lock_guard<std::mutex> lk(m_topics_mutex);
+    for (const auto& topic : m_topics) {
+      if (matchesAny(selectors, topic.m_script.m_path)) {
+        messages.push_back(DptCodec::fetchReply(topic.m_script.m_path, topic.m_value));
+      }
+    }
+  }
+  for (const auto& message : messages) {
+    send(connection, message);
+  }
+  return messages.size();
+}
+
+void StandInServer::generate(const std::atomic<bool>& stop_requested) {
+  using Due = std::pair<int64_t, size_t>;
+  std::priority_queue<Due, std::vector<Due>, std::greater<Due>> schedule;
+  int64_t start = monotonicNow();
+  for (size_t i = 0; i < m_topics.size(); ++i) {
+    if (m_topics[i].m_script.m_rate > 0) {
+      // spread over the first period, so equal rates do not come in bursts
+      auto period = static_cast<int64_t>(1e9 / m_topics[i].m_script.m_rate);
+      schedule.emplace(start + static_cast<int64_t>(i * 7919 % 1000) * period / 1000, i);
+    }
+  }
+
+  std::vector<std::shared_ptr<Connection>> connections;
+  std::vector<std::string> deltas;
+  // connection and index of its delta
+  std::vector<std::pair<Connection*, size_t>> sends;
+  while (!stop_requested && !schedule.empty()) {
+    int64_t now = monotonicNow();
+    int64_t next = schedule.top().first;
+    if (next > now) {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(std::min<int64_t>(next - now, 100000000)));
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> lk(m_connections_mutex);
+      connections = m_connections;
+    }
+    deltas.clear();
+    sends.clear();
+    {
+      std::lock_guard<std::mutex> lk(m_topics_mutex);
+      // everything due by now goes out in one go
+      while (!schedule.empty() && schedule.top().first <= now) {
+        auto [due, index] = schedule.top();
+        schedule.pop();
+        auto& topic = m_topics[index];
+        update(topic, now);
+        m_updates.fetch_add(1, std::memory_order_relaxed);
+        bool encoded = false;
+        for (auto& connection : connections) {
+          if (index < connection->m_subscribed.size() && connection->m_subscribed[index]) {
+            if (!encoded) {
+              deltas.push_back(DptCodec::delta(topic.m_id, topic.m_value));
+              encoded = true;
+            }
+            sends.emplace_back(connection.get(), deltas.size() - 1);
+          }
+        }
+        due += static_cast<int64_t>(1e9 / topic.m_script.m_rate);
+        schedule.emplace(due < now - kMaxLag ? now : due, index);
+      }
+    }
+    // a slow client holds up the generator but not the requests of the
+    // others; a subscription seen here may still be sending its loads, the
+    // deltas wait for them. One may trail an unsubscription, as it can from
+    // a real server
+    for (const auto& [connection, delta] : sends) {
+      std::lock_guard<std::mutex> order(connection->m_send_mutex);
+      send(*connection, deltas[delta]);
+    }
+  }
+}
+
+void StandInServer::update(ServedTopic& topic, int64_t now) {
+  ++topic.m_version;
+  topic.m_value = std::to_string(topic.m_version) + ' ' + std::to_string(now) + ' ';
+  if (topic.m_value.size() < topic.m_script.m_size) {
+    topic.m_value.resize(topic.m_script.m_size, 'x');
+  }
+}
+
+bool StandInServer::send(Connection& connection, const std::string& message) {
+  if (!connection.m_socket.send(message)) {
+    return false;
+  }
+  m_messages.fetch_add(1, std::memory_order_relaxed);
+  m_bytes.fetch_add(message.size(), std::memory_order_relaxed);
+  return true;
+}
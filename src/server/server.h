@@ -0,0 +1,104 @@
+#ifndef DMON_SERVER_H
+#define DMON_SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "server/dpt.h"
+#include "server/script.h"
+#include "server/websocket.h"
+
+struct ServerStats {
+  uint64_t m_connections{0};
+  uint64_t m_accepted{0};
+  uint64_t m_updates{0};
+  // sent to the clients
+  uint64_t m_messages{0};
+  uint64_t m_bytes{0};
+};
+
+// Stand-in for a Diffusion server, enough of one to load test dmon on a
+// single box: clients connect over WebSocket, subscribe, unsubscribe, fetch
+// and ping; subscribers get notified, sent a topic load and then deltas as
+// the generator updates the scripted topics. Every topic value is
+// "<version> <monotonic ns> " padded to its size, so a client on the same
+// host can tell the delivery latency. Selectors are matched in a simplified
+// way: >path, ?regex and *regex against the whole path, // suffix for the
+// descendants too, and # sets of those separated by ////.
+class StandInServer {
+ public:
+  explicit StandInServer(const std::vector<ScriptedTopic>& topics);
+  ~StandInServer();
+
+  bool listen(const std::string& address, int port, std::string& error);
+  // accepts connections and updates topics until stop_requested is set
+  void run(const std::atomic<bool>& stop_requested);
+
+  ServerStats stats() const;
+
+ private:
+  struct ServedTopic {
+    ScriptedTopic m_script;
+    uint32_t m_id{0};
+    uint64_t m_version{0};
+    std::string m_value;
+  };
+
+  struct Connection {
+    explicit Connection(int fd) : m_socket(fd) {}
+
+    WebSocket m_socket;
+    // guarded by the server's m_topics_mutex
+    std::vector<bool> m_subscribed;
+    // held by a subscription from before it takes m_topics_mutex until its
+    // topic loads are sent, and by the generator for every delta, so no
+    // delta overtakes a load; never waited for under m_topics_mutex
+    std::mutex m_send_mutex;
+    // of the requests this end starts
+    uint64_t m_conversation{0};
+    // set by its thread as it returns, which the accept loop then joins
+    std::atomic<bool> m_closed{false};
+  };
+
+  struct Worker {
+    std::shared_ptr<Connection> m_connection;
+    std::thread m_thread;
+  };
+
+  void serve(std::shared_ptr<Connection> connection);
+  // joins the threads of the connections which have closed
+  void reap();
+  void onRequest(Connection& connection, const V5_MESSAGE_T& request);
+  // sends what the selector adds, returns the number of topics it selects
+  size_t subscribe(Connection& connection, const std::string& selector);
+  size_t unsubscribe(Connection& connection, const std::string& selector);
+  size_t fetch(Connection& connection, const std::string& selector);
+  void generate(const std::atomic<bool>& stop_requested);
+  void update(ServedTopic& topic, int64_t now);
+  bool send(Connection& connection, const std::string& message);
+
+  DptCodec m_codec;
+  int m_listener{-1};
+  uint64_t m_server_id;
+  std::atomic<uint64_t> m_sessions{0};
+
+  std::mutex m_topics_mutex;
+  std::vector<ServedTopic> m_topics;
+
+  mutable std::mutex m_connections_mutex;
+  std::vector<std::shared_ptr<Connection>> m_connections;
+  // only the thread of run touches them
+  std::vector<Worker> m_workers;
+
+  std::atomic<uint64_t> m_accepted{0};
+  std::atomic<uint64_t> m_updates{0};
+  std::atomic<uint64_t> m_messages{0};
+  std::atomic<uint64_t> m_bytes{0};
+};
+
+#endif //DMON_SERVER_H
@@ -0,0 +1,228 @@
+#include "server/websocket.h"
+
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+constexpr char kAcceptGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+constexpr size_t kMaxRequest = 16 << 10;
+constexpr uint64_t kMaxMessage = 64 << 20;
+
+constexpr unsigned char kContinuation = 0x0;
+constexpr unsigned char kText = 0x1;
+constexpr unsigned char kBinary = 0x2;
+constexpr unsigned char kClose = 0x8;
+constexpr unsigned char kPing = 0x9;
+constexpr unsigned char kPong = 0xa;
+
+// value of the header, empty when the request has none
+std::string header(const std::string& request, const char* name) {
+  size_t length = strlen(name);
+  for (size_t line = request.find("\r\n"); line != std::string::npos; line = request.find("\r\n", line + 2)) {
+    size_t begin = line + 2;
+    if (strncasecmp(request.c_str() + begin, name, length) == 0 && request.size() > begin + length &&
+        request[begin + length] == ':') {
+      size_t value = request.find_first_not_of(' ', begin + length + 1);
+      size_t end = request.find("\r\n", begin);
+      return value < end ? request.substr(value, end - value) : std::string();
+    }
+  }
+  return std::string();
+}
+
+std::string acceptKey(const std::string& key) {
+  std::string input = key + kAcceptGuid;
+  unsigned char digest[SHA_DIGEST_LENGTH];
+  SHA1(reinterpret_cast<const unsigned char*>(input.data()), input.size(), digest);
+  unsigned char encoded[4 * ((SHA_DIGEST_LENGTH + 2) / 3) + 1];
+  int size = EVP_EncodeBlock(encoded, digest, SHA_DIGEST_LENGTH);
+  return std::string(reinterpret_cast<const char*>(encoded), size);
+}
+}  // namespace
+
+WebSocket::WebSocket(int fd) : m_fd(fd) {}
+
+WebSocket::~WebSocket() {
+  ::close(m_fd);
+}
+
+bool WebSocket::handshake(std::string& target, std::string& error) {
+  std::string request;
+  char buffer[1024];
+  size_t end;
+  while ((end = request.find("\r\n\r\n")) == std::string::npos) {
+    if (request.size() > kMaxRequest) {
+      error = "request too long";
+      return false;
+    }
+    ssize_t n = ::recv(m_fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) {
+      error = n == 0 ? "closed during handshake" : strerror(errno);
+      return false;
+    }
+    request.append(buffer, n);
+  }
+  m_pending = request.substr(end + 4);
+  request.resize(end + 2);
+
+  if (request.compare(0, 4, "GET ") != 0) {
+    error = "not a GET request";
+    return false;
+  }
+  size_t target_end = request.find(' ', 4);
+  target = request.substr(4, target_end == std::string::npos ? 0 : target_end - 4);
+
+  std::string key = header(request, "Sec-WebSocket-Key");
+  if (key.empty()) {
+    error = "no Sec-WebSocket-Key";
+    static const std::string rejected = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
+    writeAll(rejected.data(), rejected.size());
+    return false;
+  }
+  std::string response =
+      "HTTP/1.1 101 Switching Protocols\r\n"
+      "Upgrade: websocket\r\n"
+      "Connection: Upgrade\r\n"
+      "Sec-WebSocket-Accept: " + acceptKey(key) + "\r\n";
+  // clients which ask for a subprotocol drop connections not agreeing to one
+  std::string protocols = header(request, "Sec-WebSocket-Protocol");
+  if (!protocols.empty()) {
+    response += "Sec-WebSocket-Protocol: " + protocols.substr(0, protocols.find(',')) + "\r\n";
+  }
+  response += "\r\n";
+  if (!writeAll(response.data(), response.size())) {
+    error = strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool WebSocket::read(std::string& message) {
+  message.clear();
+  std::string payload;
+  while (true) {
+    unsigned char head[2];
+    if (!readExact(reinterpret_cast<char*>(head), sizeof(head))) {
+      return false;
+    }
+    bool fin = head[0] & 0x80;
+    unsigned char opcode = head[0] & 0x0f;
+    uint64_t size = head[1] & 0x7f;
+    if (size >= 126) {
+      unsigned char extended[8];
+      size_t bytes = size == 126 ? 2 : 8;
+      if (!readExact(reinterpret_cast<char*>(extended), bytes)) {
+        return false;
+      }
+      size = 0;
+      for (size_t i = 0; i < bytes; ++i) {
+        size = (size << 8) | extended[i];
+      }
+    }
+    if (size > kMaxMessage || message.size() + size > kMaxMessage) {
+      return false;
+    }
+    unsigned char mask[4] = {0, 0, 0, 0};
+    if ((head[1] & 0x80) && !readExact(reinterpret_cast<char*>(mask), sizeof(mask))) {
+      return false;
+    }
+    payload.resize(size);
+    if (!readExact(&payload[0], size)) {
+      return false;
+    }
+    for (size_t i = 0; i < size; ++i) {
+      payload[i] ^= mask[i & 3];
+    }
+
+    switch (opcode) {
+      case kClose:
+        sendFrame(kClose, payload.data(), std::min<size_t>(payload.size(), 2));
+        return false;
+      case kPing:
+        sendFrame(kPong, payload.data(), payload.size());
+        break;
+      case kPong:
+        break;
+      case kText:
+      case kBinary:
+      case kContinuation:
+        message += payload;
+        if (fin) {
+          return true;
+        }
+        break;
+      default:
+        return false;
+    }
+  }
+}
+
+bool WebSocket::send(const std::string& message) {
+  return sendFrame(kBinary, message.data(), message.size());
+}
+
+void WebSocket::shutdown() {
+  ::shutdown(m_fd, SHUT_RDWR);
+}
+
+bool WebSocket::sendFrame(unsigned char opcode, const char* data, size_t size) {
+  char head[10];
+  size_t length = 2;
+  head[0] = static_cast<char>(0x80 | opcode);
+  if (size < 126) {
+    head[1] = static_cast<char>(size);
+  } else if (size <= 0xffff) {
+    head[1] = 126;
+    head[2] = static_cast<char>(size >> 8);
+    head[3] = static_cast<char>(size);
+    length = 4;
+  } else {
+    head[1] = 127;
+    for (int i = 0; i < 8; ++i) {
+      head[2 + i] = static_cast<char>(uint64_t(size) >> (56 - 8 * i));
+    }
+    length = 10;
+  }
+  std::lock_guard<std::mutex> lk(m_write_mutex);
+  return writeAll(head, length) && writeAll(data, size);
+}
+
+bool WebSocket::readExact(char* data, size_t size) {
+  size_t buffered = std::min(size, m_pending.size());
+  if (buffered > 0) {
+    memcpy(data, m_pending.data(), buffered);
+    m_pending.erase(0, buffered);
+  }
+  for (size_t done = buffered; done < size;) {
+    ssize_t n = ::recv(m_fd, data + done, size - done, 0);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    done += n;
+  }
+  return true;
+}
+
+bool WebSocket::writeAll(const char* data, size_t size) {
+  for (size_t done = 0; done < size;) {
+    ssize_t n = ::send(m_fd, data + done, size - done, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    done += n;
+  }
+  return true;
+}
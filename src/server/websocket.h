@@ -0,0 +1,40 @@
+#ifndef DMON_WEBSOCKET_H
+#define DMON_WEBSOCKET_H
+
+#include <mutex>
+#include <string>
+
+// Server end of a WebSocket connection (RFC 6455) over an accepted socket,
+// just what the stand-in server needs: the opening handshake, unfragmented
+// binary messages out and reassembled messages in. Reads happen on one
+// thread, sends may come from any.
+class WebSocket {
+ public:
+  // takes ownership of the socket
+  explicit WebSocket(int fd);
+  ~WebSocket();
+
+  WebSocket(const WebSocket&) = delete;
+  WebSocket& operator=(const WebSocket&) = delete;
+
+  // reads the upgrade request and accepts it, target is its request target
+  // with the query string
+  bool handshake(std::string& target, std::string& error);
+  // next text or binary message, false once the connection is closed
+  bool read(std::string& message);
+  bool send(const std::string& message);
+  // unblocks a read on another thread
+  void shutdown();
+
+ private:
+  bool sendFrame(unsigned char opcode, const char* data, size_t size);
+  bool readExact(char* data, size_t size);
+  bool writeAll(const char* data, size_t size);
+
+  int m_fd;
+  std::mutex m_write_mutex;
+  // read past the end of the handshake request
+  std::string m_pending;
+};
+
+#endif //DMON_WEBSOCKET_H
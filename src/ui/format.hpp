@@ -0,0 +1,67 @@
+#ifndef UI_FORMAT_HPP
+#define UI_FORMAT_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+inline std::string formatBytes(uint64_t bytes) {
+  static const char units[] = {'K', 'M', 'G', 'T'};
+  char buf[32];
+  if (bytes < 1024) {
+    snprintf(buf, sizeof(buf), "%llu B", static_cast<unsigned long long>(bytes));
+    return buf;
+  }
+
+  double value = bytes / 1024.0;
+  size_t unit = 0;
+  while (value >= 1024.0 && unit + 1 < sizeof(units)) {
+    value /= 1024.0;
+    ++unit;
+  }
+  snprintf(buf, sizeof(buf), "%.1f %ciB", value, units[unit]);
+  return buf;
+}
+
+inline std::string formatRate(double per_second) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), per_second < 10.0 ? "%.2f/s" : "%.0f/s", per_second);
+  return buf;
+}
+
+inline std::string formatAge(double seconds) {
+  char buf[32];
+  if (seconds < 10.0) {
+    snprintf(buf, sizeof(buf), "%.1fs", seconds < 0.0 ? 0.0 : seconds);
+  } else if (seconds < 120.0) {
+    snprintf(buf, sizeof(buf), "%.0fs", seconds);
+  } else if (seconds < 7200.0) {
+    snprintf(buf, sizeof(buf), "%.0fm", seconds / 60.0);
+  } else {
+    snprintf(buf, sizeof(buf), "%.0fh", seconds / 3600.0);
+  }
+  return buf;
+}
+
+inline std::string formatDuration(double seconds) {
+  char buf[32];
+  if (seconds < 1e-6) {
+    snprintf(buf, sizeof(buf), "%.0fns", seconds * 1e9);
+  } else if (seconds < 1e-3) {
+    snprintf(buf, sizeof(buf), "%.0fus", seconds * 1e6);
+  } else if (seconds < 1.0) {
+    snprintf(buf, sizeof(buf), "%.1fms", seconds * 1e3);
+  } else {
+    snprintf(buf, sizeof(buf), "%.2fs", seconds);
+  }
+  return buf;
+}
+
+// up to digits significant digits, plain notation while it fits
+inline std::string formatNumber(double value, int digits = 10) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.*g", digits, value);
+  return buf;
+}
+
+#endif /* end of include guard: UI_FORMAT_HPP */
@@ -3,9 +3,11 @@
 #include <ftxui/dom/elements.hpp>
 #include <ftxui/screen/string.hpp>
 #include <ftxui/component/event.hpp>
+#include <cstdio>
+#include <ctime>
 #include <map>
 
-#include "data/hexdump.h"
+#include "ui/format.hpp"
 
 namespace {
 struct LogStyle {
@@ -26,42 +28,76 @@ std::map<std::wstring, LogStyle> log_style = {
     {L"VERBOSE4", {color(Color::GrayDark), dim}},
     {L"NINJA", {color(Color::Blue), dim}},
 };
+
+// Only rows this close to the selection are turned into elements, the frame
+// can't show more anyway and the list may hold millions of topics.
+constexpr int kRenderWindow = 200;
+
+std::string formatTime(std::chrono::system_clock::time_point tp) {
+  auto t = std::chrono::system_clock::to_time_t(tp);
+  std::tm tm{};
+  localtime_r(&t, &tm);
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count() % 1000;
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%02d:%02d:%02d.%03d", tm.tm_hour, tm.tm_min, tm.tm_sec, static_cast<int>(ms));
+  return buf;
+}
+
+Element columnTitle(const std::string& title, SortColumn column, const TopicStore& topics) {
+  if (topics.sortColumn() != column) {
+    return text(title);
+  }
+  return text(title + (topics.descending() ? " v" : " ^")) | bold;
+}
 }  // namespace
 
-Element LogDisplayer::RenderLines(const std::vector<Topic>& topics) {
+Element LogDisplayer::RenderLines() {
+  const TopicStore& topics = m_topics;
   if (size != topics.size() && selected_ > topics.size()) {
     selected_ = 0;
   }
 
-  if (topics.empty()) {
-    m_seltext.clear();
-  }
-
   size = topics.size();
 
   Elements list;
   size_t size_type = 5;
   size_t num_size = 6;
+  size_t num_updates = 6;
+  size_t time_size = 14;
+  size_t rate_size = 10;
+  size_t age_size = 6;
+  auto now = std::chrono::system_clock::now();
 
+  int first = std::max(0, selected_ - kRenderWindow);
+  int last = std::min(size, selected_ + kRenderWindow);
 
-  for (auto& it : topics) {
-    size_type = std::max(size_type, it.m_topic_type.length());
+  for (int row = first; row < last; ++row) {
+    size_type = std::max(size_type, topics[row].m_topic_type.length() + 2);
   }
 
   auto header = hbox({
-      text("Type") | ftxui::size(WIDTH, EQUAL, size_type),
+      columnTitle("Type", SortColumn::Type, topics) | ftxui::size(WIDTH, EQUAL, size_type),
+      separator(),
+      columnTitle("Size", SortColumn::Size, topics) | ftxui::size(WIDTH, EQUAL, num_size),
+      separator(),
+      columnTitle("Upd", SortColumn::Updates, topics) | ftxui::size(WIDTH, EQUAL, num_updates),
       separator(),
-      text("Size") | ftxui::size(WIDTH, EQUAL, num_size),
+      columnTitle("Msg/s", SortColumn::MessageRate, topics) | ftxui::size(WIDTH, EQUAL, rate_size),
       separator(),
-      text("Topic path") | flex,
-      //separator(),
-      //text(L"Time") | dim | ftxui::size(WIDTH, EQUAL, 14),
+      columnTitle("Bytes/s", SortColumn::ByteRate, topics) | ftxui::size(WIDTH, EQUAL, rate_size),
+      separator(),
+      text("Age") | ftxui::size(WIDTH, EQUAL, age_size),
+      separator(),
+      columnTitle("Last update", SortColumn::LastUpdate, topics) | ftxui::size(WIDTH, EQUAL, time_size),
+      separator(),
+      columnTitle("Topic path", SortColumn::Path, topics) | flex,
   });
 
-  auto previous_type = topics.size() ? topics[0].m_topic_type : "";
+  auto previous_type = first < last ? topics[first].m_topic_type : "";
 
-  int index = 0;
-  for (auto& it : topics) {
+  int index = first;
+  for (int row = first; row < last; ++row) {
+    const Topic& it = topics[row];
     bool is_focus = (index++ == selected_);
     if (previous_type != it.m_topic_type)
       list.push_back(separator());
@@ -72,10 +108,6 @@ Element LogDisplayer::RenderLines(const std::vector<Topic>& topics) {
     Decorator level_decorator = nothing; //log_style[it->level].level_decorator;
 
     if (is_focus) {
-      std::stringstream ss;
-      ss << it.m_path << ":\n";
-      ss << CustomHexdump<32, true>(&it.m_buffer[0], it.m_buffer.size());
-      m_seltext = ss.str();
       line_decorator = line_decorator | focus;
       if (Focused())
         line_decorator = line_decorator | focus | inverted;
@@ -92,6 +124,26 @@ Element LogDisplayer::RenderLines(const std::vector<Topic>& topics) {
                 | ftxui::size(WIDTH, EQUAL, num_size)
                 | notflex,
             separator(),
+            text(std::to_string(it.m_updates))
+                | ftxui::size(WIDTH, EQUAL, num_updates)
+                | notflex,
+            separator(),
+            text(formatRate(it.m_msg_rate))
+                | ftxui::size(WIDTH, EQUAL, rate_size)
+                | notflex,
+            separator(),
+            text(formatBytes(it.m_byte_rate) + "/s")
+                | ftxui::size(WIDTH, EQUAL, rate_size)
+                | notflex,
+            separator(),
+            text(formatAge(std::chrono::duration<double>(now - it.m_received).count()))
+                | ftxui::size(WIDTH, EQUAL, age_size)
+                | notflex,
+            separator(),
+            text(formatTime(it.m_received))
+                | ftxui::size(WIDTH, EQUAL, time_size)
+                | notflex,
+            separator(),
             //hbox({
             //    text(it->file),
             //    text(it->line)  //
@@ -136,6 +188,10 @@ bool LogDisplayer::OnEvent(Event event) {
   if (!Focused())
     return false;
 
+  if (sortEvent(event)) {
+    return true;
+  }
+
   int old_selected = selected_;
 
   if (event == Event::ArrowUp || event == Event::Character('k'))
@@ -162,3 +218,38 @@ bool LogDisplayer::OnEvent(Event event) {
 
   return false;
 }
+
+bool LogDisplayer::sortEvent(const Event& event) {
+  static const std::map<std::string, SortColumn> keys = {
+      {"a", SortColumn::Arrival},
+      {"t", SortColumn::Type},
+      {"s", SortColumn::Size},
+      {"p", SortColumn::Path},
+      {"u", SortColumn::Updates},
+      {"l", SortColumn::LastUpdate},
+      {"m", SortColumn::MessageRate},
+      {"b", SortColumn::ByteRate},
+  };
+
+  if (!event.is_character()) {
+    return false;
+  }
+
+  auto it = keys.find(event.character());
+  if (it == keys.end()) {
+    return false;
+  }
+
+  // the same key again flips the direction, counters and times start with
+  // the biggest/latest ones which are usually the interesting ones
+  bool descending = it->second == m_topics.sortColumn()
+                        ? !m_topics.descending()
+                        : (it->second == SortColumn::Size ||
+                           it->second == SortColumn::Updates ||
+                           it->second == SortColumn::LastUpdate ||
+                           it->second == SortColumn::MessageRate ||
+                           it->second == SortColumn::ByteRate);
+  m_topics.sortBy(it->second, descending);
+  animation::RequestAnimationFrame();
+  return true;
+}
@@ -3,31 +3,31 @@
 
 #include <ftxui/component/component.hpp>
 #include "data/session.h"
+#include "data/topic_store.h"
 
 using namespace ftxui;
 
 class LogDisplayer : public ComponentBase {
  public:
-  LogDisplayer() {}
-  Element RenderLines(const std::vector<Topic>& topics);
+  explicit LogDisplayer(TopicStore& topics) : m_topics(topics) {}
+  Element RenderLines();
   bool OnEvent(Event) override;
   int selected() { return selected_; }
   bool Focusable() const override {
     return true;
   }
 
-  std::string GetSelected() {
-    return m_seltext;
-  }
-
-  void clearSelected() {
-    m_seltext.clear();
+  // nullptr when the list is empty
+  const Topic* selectedTopic() const {
+    return selected_ >= 0 && selected_ < m_topics.size() ? &m_topics[selected_] : nullptr;
   }
 
  private:
+  bool sortEvent(const Event& event);
+
+  TopicStore& m_topics;
   int selected_ = 0;
   int size = 0;
-  std::string m_seltext;
 };
 
 #endif /* end of include guard: UI_LOG_DISPLAYER_HPP */
@@ -1,17 +1,27 @@
 #include "ui/main_component.hpp"
 
+#include <ctime>
 #include <ftxui/dom/elements.hpp>
+#include <ftxui/dom/node.hpp>
 #include <ftxui/component/component.hpp>
 #include <ftxui/screen/string.hpp>
 #include "data/session.h"
+#include "ui/format.hpp"
 
 using namespace ftxui;
 
 
-MainComponent::MainComponent(Session& session, Closure&& screen_exit)
+MainComponent::MainComponent(Session& session, const ProtoSchema& schema, const HistoryOptions& history,
+                             size_t series_budget, Closure&& screen_exit)
     : m_screen_exit_(std::move(screen_exit)),
-      log_displayer_1_(Make<LogDisplayer>()),
-      log_displayer_2_(Make<LogDisplayer>()),
+      m_series(series_budget),
+      m_history(history),
+      log_displayer_1_(Make<LogDisplayer>(m_topics)),
+      log_displayer_2_(Make<LogDisplayer>(m_subscribe_topics)),
+      m_payload_view_(Make<PayloadView>(schema)),
+      m_subscribe_payload_view_(Make<PayloadView>(schema)),
+      m_tree_view_(Make<TreeView>(m_tree)),
+      m_usage_view_(Make<UsageView>(m_tree)),
       m_session(session)
     {
   Add(Container::Vertical({
@@ -26,7 +36,7 @@ MainComponent::MainComponent(Session& session, Closure&& screen_exit)
                   }),
                   m_error_report,
                   log_displayer_1_,
-                  m_payload_text_box_,
+                  m_payload_view_,
                   m_btn_copy_
               }),
               Container::Vertical({
@@ -38,9 +48,13 @@ MainComponent::MainComponent(Session& session, Closure&& screen_exit)
                   m_subsribe_error_report,
                   container_level_filter_,
                   log_displayer_2_,
-                  m_subscribe_payload_text_box_
+                  m_subscribe_payload_view_
                   //m_btn_copy_
               }),
+              Container::Vertical({m_tree_view_}),
+              Container::Vertical({m_usage_view_}),
+              Container::Vertical({}),
+              Container::Vertical({m_btn_export_latency_}),
               Container::Vertical({m_btn_dump_exit, m_btn_exit_})
           },
           &tab_selected_)//,
@@ -63,22 +77,422 @@ bool MainComponent::OnEvent(Event event) {
     ++m_subscribtion_spinner_indx;
   }
 
-  return ComponentBase::OnEvent(event);
+  if (ComponentBase::OnEvent(event)) {
+    return true;
+  }
+
+  // [ and ] step through the kept versions of the selected topic, past the
+  // newest one the view follows the live value again
+  if ((tab_selected_ == 0 || tab_selected_ == 1) && (event == Event::Character('[') || event == Event::Character(']'))) {
+    const Topic* selected = (tab_selected_ == 1 ? log_displayer_2_ : log_displayer_1_)->selectedTopic();
+    uint64_t first;
+    uint64_t end;
+    if (!selected || !m_history.range(selected->m_path, first, end)) {
+      return false;
+    }
+    if (selected->m_path != m_history_path) {
+      m_history_path = selected->m_path;
+      m_history_back = false;
+    }
+    uint64_t current = m_history_back ? std::max(m_history_version, first) : end - 1;
+    if (event == Event::Character('[')) {
+      m_history_back = true;
+      m_history_version = current > first ? current - 1 : first;
+    } else {
+      m_history_back = current + 2 < end;
+      m_history_version = current + 1;
+    }
+    return true;
+  }
+
+  return false;
+}
+
+const Topic* MainComponent::shownTopic(const Topic* selected) {
+  if (!selected || !m_history_back) {
+    return selected;
+  }
+  uint64_t first;
+  uint64_t end;
+  if (selected->m_path != m_history_path || !m_history.range(selected->m_path, first, end)) {
+    m_history_back = false;
+    return selected;
+  }
+  // versions may have been dropped since the last step
+  uint64_t version = std::min(std::max(m_history_version, first), end - 1);
+  if (m_history_topic.m_path != selected->m_path || m_history_topic.m_updates != version) {
+    m_history_topic.m_path = selected->m_path;
+    m_history_topic.m_topic_type = selected->m_topic_type;
+    // the version number tells the payload view that the value changed
+    m_history_topic.m_updates = version;
+    if (!m_history.load(selected->m_path, version, m_history_topic.m_buffer, m_history_topic.m_received)) {
+      m_history_back = false;
+      return selected;
+    }
+  }
+  m_history_version = version;
+  return &m_history_topic;
+}
+
+std::string MainComponent::historyTitle(const Topic* selected) const {
+  uint64_t first;
+  uint64_t end;
+  if (!selected || !m_history.range(selected->m_path, first, end)) {
+    return std::string();
+  }
+  if (!m_history_back || selected->m_path != m_history_path) {
+    return ", " + std::to_string(end - first) + " versions kept";
+  }
+  auto received = std::chrono::system_clock::to_time_t(m_history_topic.m_received);
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(m_history_topic.m_received.time_since_epoch()) % 1000;
+  char time[32];
+  std::strftime(time, sizeof(time), "%H:%M:%S", std::localtime(&received));
+  char suffix[16];
+  snprintf(suffix, sizeof(suffix), ".%03d", static_cast<int>(ms.count()));
+  return ", version -" + std::to_string(end - 1 - m_history_version) + " of " + std::to_string(end - first) + " at " +
+         time + suffix;
+}
+
+
+Element MainComponent::renderSelectorStats() {
+  auto selectors = m_session.getSelectors();
+  auto now = monotonicNow();
+
+  auto row = [](const std::string& name, const std::string& msg_rate, const std::string& byte_rate,
+                const std::string& total, const std::string& age, const std::string& distinct,
+                const std::string& sizes, const std::string& gaps) {
+    return hbox({
+        text(name) | flex,
+        separator(),
+        text(msg_rate) | size(WIDTH, EQUAL, 10),
+        separator(),
+        text(byte_rate) | size(WIDTH, EQUAL, 12),
+        separator(),
+        text(total) | size(WIDTH, EQUAL, 10),
+        separator(),
+        text(age) | size(WIDTH, EQUAL, 6),
+        separator(),
+        text(distinct) | size(WIDTH, EQUAL, 9),
+        separator(),
+        text(sizes) | size(WIDTH, EQUAL, 19),
+        separator(),
+        text(gaps) | size(WIDTH, EQUAL, 17),
+    });
+  };
+  // the sketch columns are estimates with a bounded relative error
+  auto distinct = [](const StreamSummary& s) { return "~" + std::to_string(static_cast<uint64_t>(s.m_distinct_topics + 0.5)); };
+  auto sizes = [](const StreamSummary& s) { return formatBytes(s.m_size_p50) + " / " + formatBytes(s.m_size_p99); };
+  auto gaps = [](const StreamSummary& s) { return formatDuration(s.m_gap_p50) + " / " + formatDuration(s.m_gap_p99); };
+
+  Elements rows;
+  rows.push_back(row("Selector", "Msg/s", "Bytes/s", "Total", "Age", "Topics", "Size p50 / p99", "Gap p50 / p99"));
+  for (size_t i = 0; i < selectors.size(); ++i) {
+    auto counters = m_session.getSelectorCounters(i).load();
+    auto rates = m_selector_rates.rates(i);
+    auto summary = m_session.getSelectorSummary(i);
+    rows.push_back(row(selectors[i], formatRate(rates.m_messages), formatBytes(rates.m_bytes) + "/s",
+                       std::to_string(counters.m_messages),
+                       counters.m_last_update ? formatAge((now - counters.m_last_update) / 1e9) : "-",
+                       distinct(summary), sizes(summary), gaps(summary)));
+  }
+  auto all = m_session.getStreamSummary();
+  rows.push_back(row("(all)", "", "", std::to_string(all.m_messages), "", distinct(all), sizes(all), gaps(all)) | bold);
+  const auto& deltas = m_session.getDeltas();
+  if (deltas.applied() || deltas.failed()) {
+    rows.push_back(hbox({
+        text("Deltas applied " + std::to_string(deltas.applied()) + ", without a value "),
+        text(std::to_string(deltas.failed())) | color(deltas.failed() ? Color::Red : Color::Default),
+    }));
+  }
+  return vbox(rows);
+}
+
+Element MainComponent::renderHotTopics() {
+  constexpr size_t kTop = 20;
+  auto report = m_session.getHotTopics().report(kTop);
+
+  auto table = [](const std::string& title, const std::vector<SpaceSaving::Entry>& entries, bool bytes) {
+    Elements rows;
+    rows.push_back(hbox({
+        text(bytes ? "Bytes" : "Messages") | size(WIDTH, EQUAL, 12),
+        separator(),
+        text("Error") | size(WIDTH, EQUAL, 10),
+        separator(),
+        text("Path") | flex,
+    }));
+    for (const auto& e : entries) {
+      rows.push_back(hbox({
+          text(bytes ? formatBytes(e.m_count) : std::to_string(e.m_count)) | size(WIDTH, EQUAL, 12),
+          separator(),
+          text(bytes ? formatBytes(e.m_error) : std::to_string(e.m_error)) | size(WIDTH, EQUAL, 10) | dim,
+          separator(),
+          text(e.m_key) | flex,
+      }));
+    }
+    return window(text(title), vbox(rows)) | flex;
+  };
+
+  std::string branches = "Hot branches (depth " + std::to_string(report.m_depth) + ")";
+  return vbox({
+      text("Messages " + std::to_string(report.m_messages) + ", " + formatBytes(report.m_bytes) +
+           " since start, counts may overestimate by the error column"),
+      hbox({
+          table("Hot topics by messages", report.m_topics_by_messages, false),
+          table("Hot topics by bytes", report.m_topics_by_bytes, true),
+      }),
+      hbox({
+          table(branches + " by messages", report.m_branches_by_messages, false),
+          table(branches + " by bytes", report.m_branches_by_bytes, true),
+      }),
+  });
+}
+
+Element MainComponent::renderSeriesStats(const Topic* topic) const {
+  const NumericSeries* series = topic ? m_series.find(topic->m_path) : nullptr;
+  if (!series) {
+    return emptyElement();
+  }
+  auto stats = series->stats();
+  auto line = [](const std::string& name, double value) {
+    return hbox({text(name) | dim | size(WIDTH, EQUAL, 7), text(formatNumber(value))});
+  };
+  return vbox({
+      separator(),
+      hbox({text("points") | dim | size(WIDTH, EQUAL, 7), text(std::to_string(stats.m_count))}),
+      line("last", stats.m_last),
+      line("min", stats.m_min),
+      line("max", stats.m_max),
+      line("mean", stats.m_mean),
+      line("stddev", stats.m_stddev),
+      text(formatBytes(series->memory())) | dim,
+  });
+}
+
+Element MainComponent::renderSeriesChart(const Topic* topic) {
+  const NumericSeries* series = topic ? m_series.use(topic->m_path) : nullptr;
+  if (!series) {
+    return emptyElement();
+  }
+  if (topic->m_path != m_overview_path) {
+    m_overview.reset();
+    m_overview_path = topic->m_path;
+  }
+  m_overview.update(*series);
+  return graph([this](int width, int height) { return plotSeries(width, height); }) | color(Color::Cyan) |
+         xflex_grow;
+}
+
+std::vector<int> MainComponent::plotSeries(int width, int height) const {
+  std::vector<int> columns(width, 0);
+  std::vector<SeriesPoint> points;
+  m_overview.downsample(width, points);
+  if (points.empty() || height <= 0) {
+    return columns;
+  }
+
+  double lo = points[0].m_value;
+  double hi = points[0].m_value;
+  for (const auto& p : points) {
+    lo = std::min(lo, p.m_value);
+    hi = std::max(hi, p.m_value);
+  }
+  auto scale = [&](double value) {
+    return hi > lo ? static_cast<int>((value - lo) / (hi - lo) * (height - 1) + 0.5) : height / 2;
+  };
+
+  // the chosen points are spread unevenly in time, columns in between are
+  // interpolated
+  double first = static_cast<double>(points.front().m_time);
+  double span = static_cast<double>(points.back().m_time) - first;
+  size_t segment = 0;
+  for (int x = 0; x < width; ++x) {
+    double t = first + (width > 1 ? span * x / (width - 1) : 0.0);
+    while (segment + 1 < points.size() && points[segment + 1].m_time < t) {
+      ++segment;
+    }
+    const auto& a = points[segment];
+    const auto& b = points[std::min(segment + 1, points.size() - 1)];
+    double dt = static_cast<double>(b.m_time - a.m_time);
+    double value = dt > 0 ? a.m_value + (b.m_value - a.m_value) * (t - a.m_time) / dt : a.m_value;
+    columns[x] = scale(value);
+  }
+  return columns;
 }
 
+namespace {
+
+// Lays out and draws its child like it was not there, then tells that the
+// frame is painted: the last step before the screen goes to the terminal.
+class PaintedNotifier : public Node {
+ public:
+  PaintedNotifier(Element child, std::function<void()> painted)
+      : Node({std::move(child)}), m_painted(std::move(painted)) {}
+
+  void ComputeRequirement() override {
+    Node::ComputeRequirement();
+    requirement_ = children_[0]->requirement();
+  }
+
+  void SetBox(Box box) override {
+    Node::SetBox(box);
+    children_[0]->SetBox(box);
+  }
+
+  void Render(Screen& screen) override {
+    Node::Render(screen);
+    m_painted();
+  }
+
+ private:
+  std::function<void()> m_painted;
+};
+
+}  // namespace
 
 Element MainComponent::Render() {
-  m_current_payload = log_displayer_1_->GetSelected();
-  m_subscribe_payload = log_displayer_2_->GetSelected();
-  auto lines_count = std::min(tab_selected_, 1) == 0 ? m_topics.size(): m_subscribe_topics.size();
+  m_frame_started = monotonicNow();
+  return std::make_shared<PaintedNotifier>(renderTab(), [this] { onFramePainted(); });
+}
+
+void MainComponent::onFramePainted() {
+  int64_t now = monotonicNow();
+  m_frame_last = now - m_frame_started;
+  m_frame_times.record(m_frame_last);
+  ++m_frames;
+  if (m_unpainted.empty()) {
+    return;
+  }
+  auto& latency = m_session.getLatency();
+  for (const auto& u : m_unpainted) {
+    latency.record(LatencyStage::Render, now - u.m_taken);
+    latency.record(LatencyStage::EndToEnd, now - u.m_arrived);
+  }
+  m_unpainted.clear();
+}
+
+Element MainComponent::renderPing() {
+  auto ping = m_session.getPing().summary();
+  if (ping.m_sent == 0) {
+    return emptyElement();
+  }
+  auto ms = [](int64_t nanoseconds) { return formatDuration(nanoseconds * 1e-9); };
+  std::string rtt = ping.m_rtt.m_count == 0
+                        ? "RTT -"
+                        : "RTT " + ms(ping.m_last) + " p50 " + ms(ping.m_rtt.m_p50) + " p99 " + ms(ping.m_rtt.m_p99) +
+                              " jitter " + ms(ping.m_jitter);
+  auto element = text(rtt);
+  if (ping.m_lost > 0) {
+    element = hbox({element, text(" lost " + std::to_string(ping.m_lost)) | color(Color::Red)});
+  }
+  return hbox({element, separator()});
+}
+
+Element MainComponent::renderLatency() {
+  auto cell = [](const std::string& value, int width) { return text(value) | size(WIDTH, EQUAL, width); };
+  auto duration = [&cell](double nanoseconds) { return cell(formatDuration(nanoseconds * 1e-9), 9); };
+  Elements rows;
+  rows.push_back(hbox({
+      cell("Stage", 12), separator(), cell("Messages", 12), separator(), cell("Mean", 9), separator(),
+      cell("p50", 9), separator(), cell("p90", 9), separator(), cell("p99", 9), separator(),
+      cell("p99.9", 9), separator(), cell("Max", 9),
+  }));
+  for (size_t i = 0; i < PipelineLatency::kStages; ++i) {
+    auto stage = static_cast<LatencyStage>(i);
+    auto s = m_session.getLatency().histogram(stage).summary();
+    rows.push_back(hbox({
+        cell(PipelineLatency::name(stage), 12), separator(), cell(std::to_string(s.m_count), 12), separator(),
+        duration(s.m_mean), separator(), duration(s.m_p50), separator(), duration(s.m_p90), separator(),
+        duration(s.m_p99), separator(), duration(s.m_p999), separator(), duration(s.m_max),
+    }));
+  }
+  return window(text("Latency of subscribed messages"),
+                vbox({
+                    vbox(rows),
+                    separator(),
+                    text("ingest: topic handler to queued for the UI, counters, sketches and deltas included") | dim,
+                    text("hand-off: queued to taken by the UI thread") | dim,
+                    text("render: taken by the UI thread to the first frame showing it painted") | dim,
+                }));
+}
 
-  int current_line =
-      (std::min(tab_selected_, 1) == 0 ? log_displayer_1_ : log_displayer_2_)
-          ->selected();
+void MainComponent::sampleSelf(std::chrono::steady_clock::time_point now) {
+  if (now - m_self_sample.m_at < std::chrono::seconds(1)) {
+    return;
+  }
+  SelfSample sample{now, processUsage(), m_frames,
+                    m_session.getLatency().histogram(LatencyStage::Handoff).count()};
+  if (m_self_sample.m_at != std::chrono::steady_clock::time_point()) {
+    double dt = std::chrono::duration<double>(now - m_self_sample.m_at).count();
+    m_cpu_load = float((sample.m_usage.m_cpu_seconds - m_self_sample.m_usage.m_cpu_seconds) / dt);
+    m_allocation_rate = float((sample.m_usage.m_allocations - m_self_sample.m_usage.m_allocations) / dt);
+    m_frame_rate = float((sample.m_frames - m_self_sample.m_frames) / dt);
+    m_handover_rate = float((sample.m_handed_over - m_self_sample.m_handed_over) / dt);
+  }
+  m_self_sample = sample;
+}
+
+Element MainComponent::renderSelfStats() {
+  auto line = [](const std::string& name, const std::string& value, const std::string& note = std::string()) {
+    return hbox({text(name) | size(WIDTH, EQUAL, 16), text(value) | size(WIDTH, EQUAL, 34), text(note) | dim});
+  };
+  double received = 0.0;
+  for (size_t i = 0; i < Session::kMaxSelectors; ++i) {
+    received += m_selector_rates.rates(i).m_messages;
+  }
+  auto frames = m_frame_times.summary();
+  char cpu[32];
+  snprintf(cpu, sizeof(cpu), "%.0f%%", m_cpu_load * 100.0);
+  return window(text("dmon"),
+                vbox({
+                    line("Ingest queue", std::to_string(m_session.getQueueDepth()) + " peak " +
+                                             std::to_string(m_session.getQueuePeak()),
+                         "subscribed topics waiting for the UI thread, never dropped"),
+                    line("Messages", formatRate(received) + " received " + formatRate(m_handover_rate) + " taken",
+                         "by the topic handlers and by the UI thread"),
+                    line("Frames", formatRate(m_frame_rate), "frames drawn per second"),
+                    line("Frame time", formatDuration(m_frame_last * 1e-9) + " p50 " +
+                                           formatDuration(frames.m_p50 * 1e-9) + " p99 " +
+                                           formatDuration(frames.m_p99 * 1e-9),
+                         "from Render() to painted, max " + formatDuration(frames.m_max * 1e-9)),
+                    line("CPU", cpu, "user and system time of all threads"),
+                    line("Resident", formatBytes(m_self_sample.m_usage.m_rss_bytes)),
+                    allocationsCounted()
+                        ? line("Allocations", formatRate(m_allocation_rate), "operator new calls")
+                        : line("Allocations", "-", "counted when built with -DDMON_COUNT_ALLOCATIONS=ON"),
+                }));
+}
+
+Element MainComponent::renderTab() {
+  // counters are sampled at most once a second, rows only change then
+  auto now = std::chrono::steady_clock::now();
+  const TopicStats& stats = m_session.getTopicStats();
+  if (m_topic_rates.sample(stats.size(), [&stats](size_t i) { return stats.counters(i)->load(); }, now)) {
+    m_topics.refreshRates(m_topic_rates);
+    m_subscribe_topics.refreshRates(m_topic_rates);
+  }
+  m_selector_rates.sample(Session::kMaxSelectors, [this](size_t i) { return m_session.getSelectorCounters(i).load(); }, now);
+  sampleSelf(now);
+
+  size_t lines_count = 0;
+  int current_line = 0;
+  if (tab_selected_ == 0) {
+    lines_count = m_topics.size();
+    current_line = log_displayer_1_->selected();
+  } else if (tab_selected_ == 2) {
+    lines_count = m_tree_view_->rows();
+    current_line = m_tree_view_->selected();
+  } else if (tab_selected_ == 3) {
+    lines_count = m_usage_view_->rows();
+    current_line = m_usage_view_->selected();
+  } else {
+    lines_count = m_subscribe_topics.size();
+    current_line = log_displayer_2_->selected();
+  }
 
   auto header = hbox({
       hbox(text(m_session.getAddress()) | color(Color::LightGreen)),
       separator(),
+      renderPing(),
       hcenter(toggle_->Render()),
       separator(),
       //m_btn_exit_->Render(),
@@ -122,6 +536,8 @@ Element MainComponent::Render() {
 
   Element tab_menu;
   if (tab_selected_ == 0) {
+    auto lines = log_displayer_1_->RenderLines();
+    m_payload_view_->setPayload(shownTopic(log_displayer_1_->selectedTopic()));
     return  //
         vbox({
             header,
@@ -139,20 +555,25 @@ Element MainComponent::Render() {
                 //window(text(L"Selector"), hbox(container_search_selector_->Render(), m_btn_search_->Render())) | flex,
                 //filler(),
             }) | notflex,*/
-            log_displayer_1_->RenderLines(m_topics) | flex_shrink,
-            window(text("Content"), hbox(m_payload_text_box_->Render() | size(ftxui::HEIGHT, ftxui::EQUAL, 10) | xflex_grow, vbox(m_btn_copy_->Render())))
+            lines | flex_shrink,
+            window(text("Content (" + m_payload_view_->mode() + historyTitle(log_displayer_1_->selectedTopic()) + ")"), hbox(m_payload_view_->Render() | size(ftxui::HEIGHT, ftxui::EQUAL, 10) | xflex_grow, renderSeriesChart(log_displayer_1_->selectedTopic()), vbox(m_btn_copy_->Render(), renderSeriesStats(log_displayer_1_->selectedTopic()))))
         });
   }
 
   std::vector<Topic> dummy;
   if (tab_selected_ == 1) {
+    auto lines = log_displayer_2_->RenderLines();
+    m_subscribe_payload_view_->setPayload(shownTopic(log_displayer_2_->selectedTopic()));
     return  //
         vbox({
             header,
             separator(),
             window(text(L"Subscribe"), hbox(text("Enter path:"), separator(), m_subscribe_selector_->Render(), m_btn_subscribe_->Render()) | notflex),
             m_subsribe_error_report->Render(),
-            window(text(L"Subscriptions"), container_level_filter_->Render()) | notflex,
+            hbox({
+                window(text(L"Subscriptions"), container_level_filter_->Render()),
+                window(text(L"Subscription rates"), renderSelectorStats()) | flex,
+            }) | notflex,
 
             /*hbox({
                 window(text(L"Type"), container_level_filter_->Render()) |
@@ -163,8 +584,47 @@ Element MainComponent::Render() {
                 //window(text(L"Selector"), hbox(container_search_selector_->Render(), m_btn_search_->Render())) | flex,
                 //filler(),
             }) | notflex,*/
-            log_displayer_2_->RenderLines(m_subscribe_topics) | flex_shrink,
-            window(text("Content"), hbox(m_subscribe_payload_text_box_->Render() | size(ftxui::HEIGHT, ftxui::EQUAL, 10) | xflex_grow, vbox(m_btn_copy_->Render())))
+            lines | flex_shrink,
+            window(text("Content (" + m_subscribe_payload_view_->mode() + historyTitle(log_displayer_2_->selectedTopic()) + ")"), hbox(m_subscribe_payload_view_->Render() | size(ftxui::HEIGHT, ftxui::EQUAL, 10) | xflex_grow, renderSeriesChart(log_displayer_2_->selectedTopic()), vbox(m_btn_copy_->Render(), renderSeriesStats(log_displayer_2_->selectedTopic()))))
+        });
+  }
+
+  if (tab_selected_ == 2) {
+    return  //
+        vbox({
+            header,
+            separator(),
+            m_tree_view_->Render() | flex,
+        });
+  }
+
+  if (tab_selected_ == 3) {
+    return  //
+        vbox({
+            header,
+            separator(),
+            m_usage_view_->Render() | flex,
+        });
+  }
+
+  if (tab_selected_ == 4) {
+    return  //
+        vbox({
+            header,
+            separator(),
+            renderHotTopics() | flex,
+        });
+  }
+
+  if (tab_selected_ == 5) {
+    return  //
+        vbox({
+            header,
+            separator(),
+            renderLatency(),
+            hbox({m_btn_export_latency_->Render(), text(" " + m_latency_export_message) | vcenter}),
+            renderSelfStats(),
+            filler(),
         });
   }
 
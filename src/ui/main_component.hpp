@@ -12,8 +12,17 @@
 #include <fstream>
 
 #include "ui/log_displayer.hpp"
-
+#include "ui/payload_view.hpp"
+#include "ui/tree_view.hpp"
+#include "ui/usage_view.hpp"
+
+#include "data/history.h"
+#include "data/latency.h"
+#include "data/process.h"
+#include "data/series.h"
 #include "data/session.h"
+#include "data/topic_store.h"
+#include "data/topic_tree.h"
 #include "spdlog/spdlog.h"
 #include "clip.h"
 #include "data/hexdump.h"
@@ -21,87 +30,43 @@
 using namespace ftxui;
 
 
-class Animator {
- private:
-  std::condition_variable m_cv;
-  std::mutex m_m;
-  ScreenInteractive& m_screen;
-  bool m_stop{false};
-  std::thread m_thread;
-  std::vector<std::string> m_signals;
- public:
-  Animator(ScreenInteractive& screen) : m_screen(screen) {
-    m_thread = std::thread([this]() {
-      while(true) {
-        {
-          std::unique_lock<std::mutex> lk(m_m);
-          m_cv.wait(lk, [this] { return !m_signals.empty() || m_stop; });
-          spdlog::info("Post event, stop {}", m_stop);
-          if (m_stop) break;
-          std::for_each(m_signals.begin(), m_signals.end(), [this](const auto& sig){
-            m_screen.PostEvent(Event::Special(sig));
-          });
-        }
-        using namespace std::chrono_literals;
-        std::this_thread::sleep_for(0.2s);
-      }
-
-      spdlog::info("Thread finished");
-    });
-  }
-
-  ~Animator() {
-    {
-      std::lock_guard<std::mutex> lk(m_m);
-      m_stop = true;
-    }
-    m_cv.notify_one();
-    m_thread.join();
-  }
-
-  void start(const std::string& sig) {
-    {
-      std::lock_guard<std::mutex> lk(m_m);
-      if (std::none_of(m_signals.begin(), m_signals.end(), [&sig](const auto& s) { return s == sig;})) {
-        m_signals.push_back(sig);
-      }
-    }
-    m_cv.notify_one();
-  }
-
-  void stop(const std::string& sig) {
-    {
-      std::lock_guard<std::mutex> lk(m_m);
-      m_signals.erase(std::remove(m_signals.begin(), m_signals.end(), sig), m_signals.end());
-    }
-    m_cv.notify_one();
-  }
-
-  void close() {
-    {
-      std::lock_guard<std::mutex> lk(m_m);
-      m_stop = true;
-    }
-
-    m_cv.notify_one();
-  }
-};
-
-
 class MainComponent : public ComponentBase {
  public:
   static std::string test_data;
-  MainComponent(Session& session, Closure&& screenExit);
+  MainComponent(Session& session, const ProtoSchema& schema, const HistoryOptions& history, size_t series_budget,
+                Closure&& screenExit);
   Element Render() override;
   bool OnEvent(Event) override;
 
   void onFetchCompleted(const std::string& errorMessage, std::vector<Topic>&& topics, std::string&& selector) {
-    m_topics = std::move(topics);
+    for (const auto& t : topics) {
+      m_series.update(t);
+      m_history.record(t);
+    }
+    m_topics.assign(std::move(topics));
+    m_tree.rebuild(m_topics.topics(), m_subscribe_topics.topics());
     m_fetch_error_message = errorMessage;
   }
 
-  void onSubscribeCompleted(const std::string& errorMessage, std::vector<Topic>&& topics, std::string&& selector) {
-    std::copy(topics.begin(), topics.end(), std::back_inserter(m_subscribe_topics));
+  void onSubscribeCompleted(const std::string& errorMessage, SubscriptionBatch&& batch, std::string&& selector) {
+    int64_t taken = monotonicNow();
+    auto& latency = m_session.getLatency();
+    for (const auto& t : batch.m_updates) {
+      if (t.m_queued != 0) {
+        latency.record(LatencyStage::Handoff, taken - t.m_queued);
+        m_unpainted.push_back(Unpainted{t.m_arrived, taken});
+      }
+      m_series.update(t);
+      m_history.record(t);
+    }
+    // the list and the tree show the latest value of a topic only
+    std::vector<Topic> latest;
+    latest.reserve(batch.m_latest.size());
+    for (auto index : batch.m_latest) {
+      m_tree.update(batch.m_updates[index]);
+      latest.push_back(std::move(batch.m_updates[index]));
+    }
+    m_subscribe_topics.merge(std::move(latest));
     m_subscribe_error_message = errorMessage;
     m_sub_bools.push_back(false);
     spdlog::debug("Subscribe completed {}", selector);
@@ -112,20 +77,78 @@ class MainComponent : public ComponentBase {
   }
 
  private:
+  // subscribed message waiting for the frame which shows it
+  struct Unpainted {
+    int64_t m_arrived;
+    int64_t m_taken;
+  };
+
+  Element renderTab();
+  // called while the frame is drawn, once everything is painted
+  void onFramePainted();
+  // round trip times to the server for the header
+  Element renderPing();
+  Element renderLatency();
+  // where dmon itself spends its time, to tell which part is the bottleneck
+  Element renderSelfStats();
+  // turns process usage and frame counts into rates, at most once a second
+  void sampleSelf(std::chrono::steady_clock::time_point now);
+  Element renderSelectorStats();
+  Element renderHotTopics();
+  Element renderSeriesStats(const Topic* topic) const;
+  Element renderSeriesChart(const Topic* topic);
+  std::vector<int> plotSeries(int width, int height) const;
+  // the selected topic or the past version of it scrolled back to
+  const Topic* shownTopic(const Topic* selected);
+  std::string historyTitle(const Topic* selected) const;
+
   Closure m_screen_exit_;
-  std::string m_current_payload;
   std::string m_search_selector;
-  std::string m_subscribe_payload;
 
   int tab_selected_ = 0;
   std::vector<std::string> tab_entries_ = {
       "Search",
       "Subscription",
+      "Tree",
+      "Usage",
+      "Hot",
+      "Stats",
       "Quit"
   };
 
-  std::vector<Topic> m_topics;
-  std::vector<Topic> m_subscribe_topics;
+  TopicStore m_topics;
+  TopicStore m_subscribe_topics;
+  TopicTree m_tree;
+  SeriesStore m_series;
+  // downsampled history of the charted topic
+  SeriesOverview m_overview;
+  std::string m_overview_path;
+  HistoryStore m_history;
+  // topic whose history is browsed with [ and ], live unless m_history_back
+  std::string m_history_path;
+  bool m_history_back{false};
+  uint64_t m_history_version{0};
+  Topic m_history_topic;
+  std::vector<Unpainted> m_unpainted;
+  // every frame from Render() to painted
+  int64_t m_frame_started{0};
+  int64_t m_frame_last{0};
+  uint64_t m_frames{0};
+  LatencyHistogram m_frame_times;
+  struct SelfSample {
+    std::chrono::steady_clock::time_point m_at{};
+    ProcessUsage m_usage;
+    uint64_t m_frames{0};
+    uint64_t m_handed_over{0};
+  };
+  SelfSample m_self_sample;
+  float m_cpu_load{0.0f};
+  float m_allocation_rate{0.0f};
+  float m_frame_rate{0.0f};
+  float m_handover_rate{0.0f};
+  std::string m_latency_export_message;
+  RateSampler m_topic_rates;
+  RateSampler m_selector_rates;
   std::string m_fetch_error_message;
   std::string m_subscribe_error_message;
 
@@ -134,20 +157,21 @@ class MainComponent : public ComponentBase {
   Component container_thread_filter_ = Container::Horizontal({});
   std::shared_ptr<LogDisplayer> log_displayer_1_;
   std::shared_ptr<LogDisplayer> log_displayer_2_;
+  std::shared_ptr<PayloadView> m_payload_view_;
+  std::shared_ptr<PayloadView> m_subscribe_payload_view_;
+  std::shared_ptr<TreeView> m_tree_view_;
+  std::shared_ptr<UsageView> m_usage_view_;
   Component container_search_selector_ = Input(&m_search_selector, "", InputOption{.multiline=false, .on_change=[&](){
   }, .on_enter = [&](){
     if (!m_search_selector.empty() && m_session.fetch(m_search_selector)) {
-      log_displayer_1_->clearSelected();
       m_spinner_indx = 0;
     }
   }});
   Component m_btn_search_ = Button("Search", [&]{
         if (!m_search_selector.empty() && m_session.fetch(m_search_selector)) {
-          log_displayer_1_->clearSelected();
           m_spinner_indx = 0;
         }
       }, ButtonOption::Ascii());
-  Component m_payload_text_box_ = Input(&m_current_payload, InputOption{.multiline = true});
   Component m_btn_dump_exit = Button("Dump data and close application", [&](){
         std::ofstream fs("./dump.txt");
         if (fs) {
@@ -156,21 +180,32 @@ class MainComponent : public ComponentBase {
             fs << CustomHexdump<64, true>(&it.m_buffer[0], it.m_buffer.size());
           };
           fs << "Fetched topics:\n";
-          std::for_each(m_topics.begin(), m_topics.end(), print);
+          std::for_each(m_topics.topics().begin(), m_topics.topics().end(), print);
           fs << "Subscribed topics:\n";
-          std::for_each(m_subscribe_topics.begin(), m_subscribe_topics.end(), print);
+          std::for_each(m_subscribe_topics.topics().begin(), m_subscribe_topics.topics().end(), print);
         }
         m_screen_exit_();
       }, ButtonOption::Ascii());
   Component m_btn_exit_ = Button("Close application", m_screen_exit_, ButtonOption::Ascii());
   Component m_btn_copy_ = Button("Copy", [&](){
-        spdlog::debug("Copy to clipboard: {}", m_current_payload);
-        if (!clip::set_text(m_current_payload)) {
+        // a merge may have replaced the shown payload since the last frame
+        bool subscription = tab_selected_ == 1;
+        auto& view = subscription ? m_subscribe_payload_view_ : m_payload_view_;
+        view->setPayload(shownTopic((subscription ? log_displayer_2_ : log_displayer_1_)->selectedTopic()));
+        auto payload = view->text();
+        spdlog::debug("Copy to clipboard: {} bytes", payload.size());
+        if (!clip::set_text(payload)) {
           spdlog::debug("Copy to clipboard failed");
         }else {
           spdlog::debug("Copied!!!");
         }
       }, ButtonOption::Ascii());
+  Component m_btn_export_latency_ = Button("Export histograms", [&](){
+        std::string error;
+        m_latency_export_message = m_session.getLatency().exportTo("./latency", error)
+                                       ? "Written to ./latency-<stage>.hgrm"
+                                       : error;
+      }, ButtonOption::Ascii());
   Component m_btn_clear_ = Button("Clear", [&](){
         m_search_selector.clear();
       }, ButtonOption::Ascii());
@@ -198,20 +233,16 @@ class MainComponent : public ComponentBase {
   Component m_subscribe_selector_ = Input(&m_subscribe_selector, "", InputOption{.multiline=false, .on_change=[&](){
                                                                                    }, .on_enter = [&](){
                                                                                      if (!m_subscribe_selector.empty() && m_session.subscribe(m_subscribe_selector)) {
-                                                                                       log_displayer_2_->clearSelected();
                                                                                        m_subscribtion_spinner_indx = 0;
                                                                                      }
                                                                                    }});
 
   Component m_btn_subscribe_ = Button("Subscribe", [&]{
         if (!m_subscribe_selector.empty() && m_session.subscribe(m_subscribe_selector)) {
-          log_displayer_2_->clearSelected();
           m_subscribtion_spinner_indx = 0;
         }
       }, ButtonOption::Ascii());
 
-  Component m_subscribe_payload_text_box_ = Input(&m_subscribe_payload, InputOption{.multiline = true});
-
   Session& m_session;
   size_t m_spinner_indx{0};
   size_t m_subscribtion_spinner_indx{0};
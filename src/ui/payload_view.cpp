@@ -0,0 +1,524 @@
+#include "ui/payload_view.hpp"
+
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/component/event.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <sstream>
+
+#include "data/hexdump.h"
+
+namespace {
+// the pane is a few lines high, rows further away would never be shown
+constexpr int kRenderWindow = 100;
+constexpr size_t kHexRowSize = 32;
+// longest string shown in a row, the clipboard gets them in full
+constexpr size_t kMaxLabel = 512;
+constexpr size_t kMaxColumnWidth = 24;
+constexpr size_t kMaxColumns = 32;
+
+Decorator highlight(bool changed) {
+  return changed ? color(Color::Yellow) | bold : nothing;
+}
+
+// a field padded or cut to width bytes, control bytes shown as dots
+void appendCell(std::string& line, std::string_view field, size_t width) {
+  size_t length = field.size();
+  if (length > width) {
+    length = width - 1;
+    while (length > 0 && (static_cast<unsigned char>(field[length]) & 0xc0) == 0x80) {
+      --length;
+    }
+  }
+  for (size_t i = 0; i < length; ++i) {
+    line += static_cast<unsigned char>(field[i]) < 0x20 ? '.' : field[i];
+  }
+  if (length < field.size()) {
+    line += '~';
+    ++length;
+  }
+  line.append(width - length, ' ');
+}
+}  // namespace
+
+void PayloadView::setPayload(const Topic* topic) {
+  Version version;
+  if (topic) {
+    version = Version{topic->m_buffer.data(), topic->m_buffer.size(), topic->m_updates, topic->m_received};
+  }
+  if (version == m_version) {
+    return;
+  }
+
+  // a new value of the same topic keeps what was expanded and the cursor
+  bool same_topic = topic && topic->m_path == m_path;
+  Paths expanded;
+  if (same_topic && m_mode == Mode::Json) {
+    expanded = expandedPaths(m_tree);
+  } else if (same_topic && m_mode == Mode::Protobuf) {
+    expanded = expandedPaths(m_proto);
+  }
+  if (!same_topic) {
+    selected_ = 0;
+  }
+
+  // the view may be shown for a few frames without a change, the diff is
+  // taken here once per update and not per frame
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(version.m_data);
+  if (same_topic) {
+    diffBytes(m_previous.data(), m_previous.size(), data, version.m_size, m_changes);
+  } else {
+    m_changes.clear();
+  }
+  m_previous.assign(data, data + version.m_size);
+
+  m_version = version;
+  m_path = topic ? topic->m_path : std::string();
+  // node indices of the new tree don't match the old ones, the cursor stays
+  // on its row instead
+  m_rows.clear();
+  m_records.clear();
+  if (!m_tree.reset(data, version.m_size)) {
+    m_records.reset(version.m_data, version.m_size);
+  }
+  // a topic bound to a message type is decoded with it, any other payload
+  // may still be looked at as untyped fields
+  m_proto.reset(data, version.m_size, topic ? m_schema.messageFor(topic->m_path) : nullptr);
+  m_layout_dirty = true;
+
+  if (!same_topic || !available(m_mode)) {
+    if (available(Mode::Json)) {
+      m_mode = Mode::Json;
+    } else if (available(Mode::Protobuf) && m_proto.type()) {
+      m_mode = Mode::Protobuf;
+    } else {
+      m_mode = available(Mode::Records) ? Mode::Records : Mode::Hex;
+    }
+    m_first_column = 0;
+  }
+
+  if (m_mode == Mode::Json) {
+    expand(m_tree, expanded);
+  } else if (m_mode == Mode::Protobuf) {
+    expand(m_proto, expanded);
+  }
+}
+
+template <typename Tree>
+PayloadView::Paths PayloadView::expandedPaths(const Tree& tree) {
+  // children are indexed after their parent, so parents come first
+  Paths paths;
+  for (uint32_t index = 1; index < tree.size(); ++index) {
+    if (!tree.node(index).m_expanded) {
+      continue;
+    }
+    std::vector<uint32_t> path;
+    for (uint32_t node = index; node != Tree::kRoot; node = tree.node(node).m_parent) {
+      path.push_back(node - tree.node(tree.node(node).m_parent).m_first_child);
+    }
+    std::reverse(path.begin(), path.end());
+    paths.push_back(std::move(path));
+  }
+  return paths;
+}
+
+template <typename Tree>
+void PayloadView::expand(Tree& tree, const Paths& paths) {
+  for (const auto& path : paths) {
+    uint32_t node = Tree::kRoot;
+    for (auto position : path) {
+      uint32_t first = tree.children(node);
+      if (position >= tree.node(node).m_children || !tree.node(first + position).m_container) {
+        node = Tree::kNone;
+        break;
+      }
+      node = first + position;
+    }
+    if (node != Tree::kNone) {
+      tree.setExpanded(node, true);
+    }
+  }
+}
+
+bool PayloadView::available(Mode mode) const {
+  switch (mode) {
+    case Mode::Json:
+      return !m_tree.empty();
+    case Mode::Protobuf:
+      return !m_proto.empty();
+    case Mode::Records:
+      return !m_records.empty();
+    case Mode::Hex:
+      break;
+  }
+  return true;
+}
+
+int PayloadView::rows() const {
+  switch (m_mode) {
+    case Mode::Json:
+    case Mode::Protobuf:
+      return m_rows.size();
+    case Mode::Records:
+      return m_records.records();
+    case Mode::Hex:
+      break;
+  }
+  return (m_version.m_size + kHexRowSize - 1) / kHexRowSize;
+}
+
+template <typename Tree>
+void PayloadView::append(Tree& tree, uint32_t node, int depth) {
+  uint32_t first = tree.children(node);
+  for (uint32_t i = 0; i < tree.node(node).m_children; ++i) {
+    m_rows.push_back(Row{first + i, depth});
+    if (tree.node(first + i).m_expanded) {
+      append(tree, first + i, depth + 1);
+    }
+  }
+}
+
+void PayloadView::layout() {
+  if (!m_layout_dirty) {
+    return;
+  }
+  m_layout_dirty = false;
+  if (m_mode == Mode::Json) {
+    layout(m_tree);
+  } else if (m_mode == Mode::Protobuf) {
+    layout(m_proto);
+  } else {
+    m_rows.clear();
+  }
+}
+
+template <typename Tree>
+void PayloadView::layout(Tree& tree) {
+  // keep the cursor on the same node when rows appear above it
+  uint32_t selected_node = selected_ < m_rows.size() ? m_rows[selected_].m_node : Tree::kNone;
+  m_rows.clear();
+  if (tree.empty()) {
+    return;
+  }
+  m_rows.push_back(Row{Tree::kRoot, 0});
+  if (tree.node(Tree::kRoot).m_expanded) {
+    append(tree, Tree::kRoot, 1);
+  }
+
+  if (selected_node != Tree::kNone && selected_node < tree.size()) {
+    for (size_t row = 0; row < m_rows.size(); ++row) {
+      if (m_rows[row].m_node == selected_node) {
+        selected_ = row;
+        break;
+      }
+    }
+  }
+}
+
+Element PayloadView::hexRow(int row) const {
+  static const char hex[] = "0123456789abcdef";
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(m_version.m_data);
+  size_t begin = row * kHexRowSize;
+  size_t end = std::min(begin + kHexRowSize, m_version.m_size);
+
+  char offset[16];
+  snprintf(offset, sizeof(offset), "0x%06zx: ", begin);
+  if (!changed(begin, end)) {
+    std::string line = offset;
+    for (size_t i = begin; i < begin + kHexRowSize; ++i) {
+      if (i < end) {
+        line += hex[data[i] >> 4];
+        line += hex[data[i] & 0xf];
+        line += ' ';
+      } else {
+        line += "   ";
+      }
+    }
+    line += ' ';
+    for (size_t i = begin; i < end; ++i) {
+      line += std::isprint(data[i]) ? static_cast<char>(data[i]) : '.';
+    }
+    return ftxui::text(line);
+  }
+
+  // runs of changed and unchanged bytes become separate elements in both
+  // the hex and the text column
+  Elements hex_column;
+  Elements text_column;
+  for (size_t i = begin; i < end;) {
+    bool run_changed = changed(i, i + 1);
+    std::string hex_run;
+    std::string text_run;
+    for (; i < end && changed(i, i + 1) == run_changed; ++i) {
+      hex_run += hex[data[i] >> 4];
+      hex_run += hex[data[i] & 0xf];
+      hex_run += ' ';
+      text_run += std::isprint(data[i]) ? static_cast<char>(data[i]) : '.';
+    }
+    hex_column.push_back(ftxui::text(hex_run) | highlight(run_changed));
+    text_column.push_back(ftxui::text(text_run) | highlight(run_changed));
+  }
+  hex_column.push_back(ftxui::text(std::string((begin + kHexRowSize - end) * 3 + 1, ' ')));
+  return hbox({ftxui::text(offset), hbox(hex_column), hbox(text_column)});
+}
+
+Element PayloadView::renderRecords(int first, int last) {
+  // columns are as wide as their widest field among the rows built, only
+  // the cached offsets of those rows' fields are touched
+  size_t columns = std::min(kMaxColumns, m_records.columns() - std::min(m_first_column, m_records.columns()));
+  std::vector<size_t> widths(columns, 0);
+  for (int row = first; row < last; ++row) {
+    for (size_t column = 0; column < columns; ++column) {
+      widths[column] = std::max(widths[column], m_records.field(row, m_first_column + column).size());
+    }
+  }
+
+  std::string header = "#       ";
+  for (size_t column = 0; column < columns; ++column) {
+    widths[column] = std::min(kMaxColumnWidth, std::max<size_t>(widths[column], 3));
+    header += "| ";
+    appendCell(header, std::to_string(m_first_column + column), widths[column] + 1);
+  }
+
+  Elements list;
+  for (int row = first; row < last; ++row) {
+    char number[16];
+    snprintf(number, sizeof(number), "%-8d", row);
+    // cells of changed fields are elements of their own, rows without
+    // changes stay a single text
+    Elements cells;
+    std::string line = number;
+    for (size_t column = 0; column < columns; ++column) {
+      std::string_view field = m_records.field(row, m_first_column + column);
+      size_t offset = field.empty() ? 0 : field.data() - m_version.m_data;
+      line += "| ";
+      if (!field.empty() && changed(offset, offset + field.size())) {
+        cells.push_back(ftxui::text(line));
+        line.clear();
+        appendCell(line, field, widths[column] + 1);
+        cells.push_back(ftxui::text(line) | highlight(true));
+        line.clear();
+      } else {
+        appendCell(line, field, widths[column] + 1);
+      }
+    }
+    cells.push_back(ftxui::text(line));
+
+    Decorator line_decorator = nothing;
+    if (row == selected_) {
+      line_decorator = focus;
+      if (Focused())
+        line_decorator = line_decorator | inverted;
+    }
+    list.push_back(hbox(cells) | line_decorator);
+  }
+
+  return vbox({
+      ftxui::text(header) | bold,
+      vbox(list) | yframe,
+  });
+}
+
+template <typename Tree>
+Element PayloadView::treeRow(const Tree& tree, const Row& row) const {
+  const auto& node = tree.node(row.m_node);
+  std::string line(row.m_depth * 2, ' ');
+  if (!node.m_container || (node.m_indexed && node.m_children == 0)) {
+    line += "  ";
+  } else {
+    line += node.m_expanded ? "- " : "+ ";
+  }
+  line += tree.label(row.m_node, kMaxLabel);
+  return ftxui::text(line) | (node.m_container ? bold : nothing) | highlight(changed(tree, row.m_node));
+}
+
+bool PayloadView::changed(const CborTree& tree, uint32_t node) const {
+  size_t begin;
+  size_t end;
+  return !m_changes.empty() && tree.scalarSpan(node, begin, end) && changed(begin, end);
+}
+
+bool PayloadView::changed(const ProtoTree& tree, uint32_t node) const {
+  const auto& n = tree.node(node);
+  return !m_changes.empty() && n.m_offset + n.m_length <= m_version.m_size && changed(n.m_offset, n.m_offset + n.m_length);
+}
+
+Element PayloadView::Render() {
+  layout();
+  int size = rows();
+  selected_ = std::max(0, std::min(size - 1, selected_));
+
+  int first = std::max(0, selected_ - kRenderWindow);
+  int last = std::min(size, selected_ + kRenderWindow);
+
+  if (m_mode == Mode::Records) {
+    return renderRecords(first, last);
+  }
+
+  Elements list;
+  for (int row = first; row < last; ++row) {
+    Element line;
+    if (m_mode == Mode::Json) {
+      line = treeRow(m_tree, m_rows[row]);
+    } else if (m_mode == Mode::Protobuf) {
+      line = treeRow(m_proto, m_rows[row]);
+    } else {
+      line = hexRow(row);
+    }
+
+    if (row == selected_) {
+      line = line | focus;
+      if (Focused())
+        line = line | inverted;
+    }
+    list.push_back(line);
+  }
+
+  if (list.empty())
+    list.push_back(ftxui::text("(empty)"));
+
+  return vbox(list) | yframe;
+}
+
+bool PayloadView::OnEvent(Event event) {
+  if (!Focused())
+    return false;
+
+  int size = rows();
+  int old_selected = selected_;
+  bool changed = false;
+
+  if (event == Event::ArrowUp || event == Event::Character('k'))
+    selected_--;
+  if (event == Event::ArrowDown || event == Event::Character('j'))
+    selected_++;
+  if (event == Event::PageDown)
+    selected_ += 10;
+  if (event == Event::PageUp)
+    selected_ -= 10;
+  if (event == Event::Home)
+    selected_ = 0;
+  if (event == Event::End)
+    selected_ = size - 1;
+
+  // cycles through the views the payload can be shown in
+  if (event == Event::Character('x')) {
+    Mode mode = m_mode;
+    do {
+      mode = static_cast<Mode>((static_cast<int>(mode) + 1) % 4);
+    } while (!available(mode));
+    changed = mode != m_mode;
+    if (changed) {
+      m_mode = mode;
+      m_rows.clear();
+      m_layout_dirty = true;
+      selected_ = 0;
+    }
+  }
+
+  if (m_mode == Mode::Records) {
+    size_t old_column = m_first_column;
+    if ((event == Event::ArrowLeft || event == Event::Character('h')) && m_first_column > 0)
+      --m_first_column;
+    if ((event == Event::ArrowRight || event == Event::Character('l')) && m_first_column + 1 < m_records.columns())
+      ++m_first_column;
+    changed = changed || old_column != m_first_column;
+  }
+
+  if (m_mode == Mode::Json) {
+    changed = treeEvent(m_tree, event) || changed;
+  } else if (m_mode == Mode::Protobuf) {
+    changed = treeEvent(m_proto, event) || changed;
+  }
+
+  selected_ = std::max(0, std::min(size - 1, selected_));
+
+  if (selected_ != old_selected || changed) {
+    animation::RequestAnimationFrame();
+    return true;
+  }
+
+  return false;
+}
+
+// expanding only marks the node, its children are indexed by the next
+// layout while the payload is known to be alive
+template <typename Tree>
+bool PayloadView::treeEvent(Tree& tree, const Event& event) {
+  if (selected_ < 0 || selected_ >= m_rows.size()) {
+    return false;
+  }
+
+  uint32_t index = m_rows[selected_].m_node;
+  const auto& node = tree.node(index);
+  if (event == Event::ArrowRight || event == Event::Character('l') || event == Event::Return) {
+    if (node.m_container && !node.m_expanded) {
+      tree.setExpanded(index, true);
+      m_layout_dirty = true;
+      return true;
+    }
+  }
+  if (event == Event::ArrowLeft || event == Event::Character('h')) {
+    if (node.m_expanded) {
+      tree.setExpanded(index, false);
+      m_layout_dirty = true;
+      return true;
+    }
+    if (node.m_parent != Tree::kNone) {
+      // jump to the parent row, it is always above its children
+      for (int row = selected_; row >= 0; --row) {
+        if (m_rows[row].m_node == node.m_parent) {
+          selected_ = row;
+          break;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+std::string PayloadView::mode() const {
+  switch (m_mode) {
+    case Mode::Json:
+      return "JSON";
+    case Mode::Protobuf:
+      return "protobuf";
+    case Mode::Records:
+      return "records";
+    case Mode::Hex:
+      break;
+  }
+  return "hex";
+}
+
+std::string PayloadView::text() {
+  if (m_version.m_size == 0) {
+    return std::string();
+  }
+
+  std::string out = m_path + ":\n";
+  if (m_mode == Mode::Json && cborToJson(reinterpret_cast<const uint8_t*>(m_version.m_data), m_version.m_size, out)) {
+    return out;
+  }
+  if (m_mode == Mode::Protobuf) {
+    return out + m_proto.text();
+  }
+  if (m_mode == Mode::Records) {
+    // tab separated, one record per line
+    for (size_t record = 0; record < m_records.records(); ++record) {
+      for (size_t field = 0; field < m_records.fields(record); ++field) {
+        if (field > 0) {
+          out += '\t';
+        }
+        out += m_records.field(record, field);
+      }
+      out += '\n';
+    }
+    return out;
+  }
+  std::stringstream ss;
+  ss << m_path << ":\n";
+  ss << CustomHexdump<kHexRowSize, true>(m_version.m_data, m_version.m_size);
+  return ss.str();
+}
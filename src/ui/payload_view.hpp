@@ -0,0 +1,101 @@
+#ifndef UI_PAYLOAD_VIEW_HPP
+#define UI_PAYLOAD_VIEW_HPP
+
+#include <ftxui/component/component.hpp>
+#include "data/cbor.h"
+#include "data/diff.h"
+#include "data/protobuf.h"
+#include "data/records.h"
+#include "data/session.h"
+
+using namespace ftxui;
+
+// Payload of the selected topic, as collapsible JSON when it is a single
+// CBOR item, as a protobuf field tree when its topic is bound to a message
+// type, as a table when it is record data and as a hex dump otherwise.
+// Rows are produced from the lazily indexed document or the cached field
+// offsets and only those around the cursor become elements, so a
+// multi-megabyte payload is decoded no further than it is looked at. Bytes,
+// fields and values which changed since the previous update of the topic
+// are highlighted.
+class PayloadView : public ComponentBase {
+ public:
+  explicit PayloadView(const ProtoSchema& schema) : m_schema(schema) {}
+
+  // called every frame before Render(), cheap while the payload is the same;
+  // the topic's buffer is only read during Render()
+  void setPayload(const Topic* topic);
+  Element Render() override;
+  bool OnEvent(Event) override;
+  bool Focusable() const override {
+    return true;
+  }
+
+  // "JSON", "protobuf", "records" or "hex"
+  std::string mode() const;
+  // the whole payload as text, for the clipboard; call setPayload() first
+  std::string text();
+
+ private:
+  struct Row {
+    uint32_t m_node;
+    int m_depth;
+  };
+
+  struct Version {
+    const char* m_data{nullptr};
+    size_t m_size{0};
+    uint64_t m_updates{0};
+    std::chrono::system_clock::time_point m_received{};
+
+    bool operator==(const Version& other) const {
+      return m_data == other.m_data && m_size == other.m_size && m_updates == other.m_updates &&
+             m_received == other.m_received;
+    }
+  };
+
+  enum class Mode { Json, Protobuf, Records, Hex };
+  // child positions from the root down to an expanded node
+  using Paths = std::vector<std::vector<uint32_t>>;
+
+  bool available(Mode mode) const;
+  int rows() const;
+  void layout();
+  Element hexRow(int row) const;
+  bool changed(size_t begin, size_t end) const { return overlaps(m_changes, begin, end); }
+  bool changed(const CborTree& tree, uint32_t node) const;
+  bool changed(const ProtoTree& tree, uint32_t node) const;
+
+  // CborTree and ProtoTree are laid out and navigated alike
+  template <typename Tree>
+  void layout(Tree& tree);
+  template <typename Tree>
+  void append(Tree& tree, uint32_t node, int depth);
+  template <typename Tree>
+  static Paths expandedPaths(const Tree& tree);
+  template <typename Tree>
+  static void expand(Tree& tree, const Paths& paths);
+  template <typename Tree>
+  Element treeRow(const Tree& tree, const Row& row) const;
+  template <typename Tree>
+  bool treeEvent(Tree& tree, const Event& event);
+  Element renderRecords(int first, int last);
+
+  const ProtoSchema& m_schema;
+  std::string m_path;
+  Version m_version;
+  // copy of the payload shown, the next version is compared with it once
+  std::vector<uint8_t> m_previous;
+  std::vector<ByteRange> m_changes;
+  CborTree m_tree;
+  ProtoTree m_proto;
+  RecordIndex m_records;
+  Mode m_mode{Mode::Hex};
+  // first record field shown, wide records scroll sideways
+  size_t m_first_column{0};
+  bool m_layout_dirty{true};
+  std::vector<Row> m_rows;
+  int selected_ = 0;
+};
+
+#endif /* end of include guard: UI_PAYLOAD_VIEW_HPP */
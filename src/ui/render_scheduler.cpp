@@ -0,0 +1,108 @@
+#include "ui/render_scheduler.hpp"
+
+#include <algorithm>
+
+#include <ftxui/component/event.hpp>
+
+RenderScheduler::RenderScheduler(ScreenInteractive& screen, int fps)
+    : m_screen(screen),
+      m_period(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds(1)) /
+               std::max(1, fps)),
+      m_thread([this] { run(); }) {}
+
+RenderScheduler::~RenderScheduler() {
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_one();
+  m_thread.join();
+}
+
+void RenderScheduler::onDirty(uint32_t flag, std::function<void()>&& handler) {
+  for (size_t i = 0; i < kMaxFlags; ++i) {
+    if (flag == (uint32_t(1) << i)) {
+      m_handlers[i] = std::move(handler);
+    }
+  }
+}
+
+void RenderScheduler::markDirty(uint32_t flags) {
+  // only the first mark of a frame wakes the scheduler, later ones find the
+  // frame pending
+  if (m_dirty.fetch_or(flags, std::memory_order_acq_rel) != 0) {
+    return;
+  }
+  {
+    // the scheduler checks the flags under the mutex before it waits
+    std::lock_guard<std::mutex> lk(m_mutex);
+  }
+  m_cv.notify_one();
+}
+
+void RenderScheduler::start(const std::string& sig) {
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    if (std::find(m_signals.begin(), m_signals.end(), sig) == m_signals.end()) {
+      m_signals.push_back(sig);
+    }
+  }
+  m_cv.notify_one();
+}
+
+void RenderScheduler::stop(const std::string& sig) {
+  std::lock_guard<std::mutex> lk(m_mutex);
+  m_signals.erase(std::remove(m_signals.begin(), m_signals.end(), sig), m_signals.end());
+}
+
+void RenderScheduler::run() {
+  std::unique_lock<std::mutex> lk(m_mutex);
+  while (!m_stop) {
+    bool dirty = m_dirty.load(std::memory_order_acquire) != 0;
+    if (!dirty && m_signals.empty()) {
+      m_cv.wait(lk);
+      continue;
+    }
+
+    // a frame period after the previous frame, for spinners alone not
+    // before their period either
+    auto now = std::chrono::steady_clock::now();
+    auto next = m_last_frame + m_period;
+    if (!dirty) {
+      next = std::max(next, m_last_spin + kSpinnerPeriod);
+    }
+    if (now < next) {
+      m_cv.wait_until(lk, next);
+      continue;
+    }
+
+    std::vector<std::string> signals;
+    if (!m_signals.empty() && now >= m_last_spin + kSpinnerPeriod) {
+      signals = m_signals;
+      m_last_spin = now;
+    }
+    m_last_frame = now;
+    uint32_t flags = m_dirty.exchange(0, std::memory_order_acq_rel);
+    lk.unlock();
+    frame(flags);
+    for (const auto& sig : signals) {
+      m_screen.PostEvent(Event::Special(sig));
+    }
+    lk.lock();
+  }
+}
+
+void RenderScheduler::frame(uint32_t dirty) {
+  if (dirty == 0) {
+    return;
+  }
+  m_screen.Post([this, dirty] {
+    for (size_t i = 0; i < kMaxFlags; ++i) {
+      if ((dirty & (uint32_t(1) << i)) && m_handlers[i]) {
+        m_handlers[i]();
+      }
+    }
+  });
+  // closures change the model without invalidating the frame, an event does
+  m_screen.PostEvent(Event::Custom);
+}
@@ -0,0 +1,63 @@
+#ifndef UI_RENDER_SCHEDULER_HPP
+#define UI_RENDER_SCHEDULER_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ftxui/component/screen_interactive.hpp>
+
+using namespace ftxui;
+
+// Draws at most fps frames a second and nothing while nothing changes.
+// Other threads mark what changed with dirty flags instead of posting to the
+// screen themselves; once a frame the scheduler posts a single closure which
+// runs the handler of every flag marked since the previous frame on the UI
+// thread, followed by an event for the screen to draw. However fast updates
+// arrive they cost one frame per period. While an operation is in progress its spinner
+// event is posted every kSpinnerPeriod.
+class RenderScheduler {
+ public:
+  static constexpr size_t kMaxFlags = 32;
+  static constexpr auto kSpinnerPeriod = std::chrono::milliseconds(200);
+
+  RenderScheduler(ScreenInteractive& screen, int fps);
+  ~RenderScheduler();
+
+  RenderScheduler(const RenderScheduler&) = delete;
+  RenderScheduler& operator=(const RenderScheduler&) = delete;
+
+  // before anything is marked: handler of the flag, a single bit
+  void onDirty(uint32_t flag, std::function<void()>&& handler);
+  // any thread, one atomic or per call
+  void markDirty(uint32_t flags);
+
+  // Event::Special(sig) is posted every spinner period between start and stop
+  void start(const std::string& sig);
+  void stop(const std::string& sig);
+
+ private:
+  void run();
+  void frame(uint32_t dirty);
+
+  ScreenInteractive& m_screen;
+  const std::chrono::steady_clock::duration m_period;
+  std::array<std::function<void()>, kMaxFlags> m_handlers;
+  std::atomic<uint32_t> m_dirty{0};
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_stop{false};
+  std::vector<std::string> m_signals;
+  std::chrono::steady_clock::time_point m_last_frame{};
+  std::chrono::steady_clock::time_point m_last_spin{};
+  std::thread m_thread;
+};
+
+#endif /* end of include guard: UI_RENDER_SCHEDULER_HPP */
@@ -0,0 +1,181 @@
+#include "ui/tree_view.hpp"
+
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/component/event.hpp>
+
+#include "ui/format.hpp"
+
+namespace {
+constexpr int kRenderWindow = 200;
+constexpr int kNumberWidth = 11;
+// fits "-1.23457e+10"
+constexpr int kValueWidth = 12;
+constexpr int kValueDigits = 6;
+
+Element numberColumns(const TopicTree::Numbers& numbers) {
+  auto column = [](const std::string& value) {
+    return hbox({separator(), text(value) | size(WIDTH, EQUAL, kValueWidth)});
+  };
+  if (numbers.m_count == 0) {
+    return hbox({column(""), column(""), column(""), column(""), column("")});
+  }
+  return hbox({
+      column(std::to_string(numbers.m_count)),
+      column(formatNumber(numbers.m_sum, kValueDigits)),
+      column(formatNumber(numbers.m_min, kValueDigits)),
+      column(formatNumber(numbers.m_max, kValueDigits)),
+      column(formatNumber(numbers.mean(), kValueDigits)),
+  });
+}
+}  // namespace
+
+void TreeView::append(uint32_t node, int depth) {
+  for (auto child : m_tree.children(node)) {
+    m_rows.push_back(Row{child, depth});
+    if (m_tree.node(child).m_expanded) {
+      append(child, depth + 1);
+    }
+  }
+}
+
+void TreeView::layout() {
+  if (m_layout_version == m_tree.layoutVersion()) {
+    return;
+  }
+
+  // keep the cursor on the same node when rows appear above it
+  uint32_t selected_node = selected_ < m_rows.size() ? m_rows[selected_].m_node : TopicTree::kRoot;
+  m_rows.clear();
+  append(TopicTree::kRoot, 0);
+  m_layout_version = m_tree.layoutVersion();
+
+  selected_ = std::min<int>(selected_, std::max<int>(0, m_rows.size() - 1));
+  if (selected_node != TopicTree::kRoot) {
+    for (size_t row = 0; row < m_rows.size(); ++row) {
+      if (m_rows[row].m_node == selected_node) {
+        selected_ = row;
+        break;
+      }
+    }
+  }
+}
+
+Element TreeView::Render() {
+  layout();
+
+  // the value columns only show up once a topic has a numeric value
+  bool numeric = m_tree.node(TopicTree::kRoot).m_numbers > 0;
+  auto value_header = [](const std::string& title) {
+    return hbox({separator(), text(title) | size(WIDTH, EQUAL, kValueWidth)});
+  };
+  auto header = hbox({
+      text("Topic tree") | flex,
+      separator(),
+      text("Topics") | size(WIDTH, EQUAL, kNumberWidth),
+      separator(),
+      text("Bytes") | size(WIDTH, EQUAL, kNumberWidth),
+      separator(),
+      text("Msg/s") | size(WIDTH, EQUAL, kNumberWidth),
+      numeric ? hbox({value_header("Numeric"), value_header("Sum"), value_header("Min"), value_header("Max"),
+                      value_header("Avg")})
+              : emptyElement(),
+  });
+
+  auto now = DecayingRate::Clock::now();
+  int first = std::max(0, selected_ - kRenderWindow);
+  int last = std::min<int>(m_rows.size(), selected_ + kRenderWindow);
+
+  Elements list;
+  for (int row = first; row < last; ++row) {
+    const auto& node = m_tree.node(m_rows[row].m_node);
+    std::string name(m_rows[row].m_depth * 2, ' ');
+    if (node.m_children.empty()) {
+      name += "  ";
+    } else {
+      name += node.m_expanded ? "- " : "+ ";
+    }
+    name += node.m_name;
+
+    Decorator line_decorator = node.m_topic ? nothing : bold;
+    if (row == selected_) {
+      line_decorator = line_decorator | focus;
+      if (Focused())
+        line_decorator = line_decorator | inverted;
+    }
+
+    list.push_back(hbox({
+        text(name) | flex,
+        separator(),
+        text(std::to_string(node.m_topics)) | size(WIDTH, EQUAL, kNumberWidth),
+        separator(),
+        text(formatBytes(node.m_bytes)) | size(WIDTH, EQUAL, kNumberWidth),
+        separator(),
+        text(formatRate(node.m_rate.perSecond(now))) | size(WIDTH, EQUAL, kNumberWidth),
+        numeric ? numberColumns(m_tree.numbers(m_rows[row].m_node)) : emptyElement(),
+    }) | line_decorator);
+  }
+
+  if (list.empty())
+    list.push_back(text("(empty)"));
+
+  return window(text("Topic tree"), vbox({
+                                        header,
+                                        separator(),
+                                        vbox(list) | yframe,
+                                    }));
+}
+
+bool TreeView::OnEvent(Event event) {
+  if (!Focused())
+    return false;
+
+  layout();
+  int size = m_rows.size();
+  int old_selected = selected_;
+  uint64_t old_layout = m_tree.layoutVersion();
+
+  if (event == Event::ArrowUp || event == Event::Character('k'))
+    selected_--;
+  if (event == Event::ArrowDown || event == Event::Character('j'))
+    selected_++;
+  if (event == Event::PageDown)
+    selected_ += 10;
+  if (event == Event::PageUp)
+    selected_ -= 10;
+  if (event == Event::Home)
+    selected_ = 0;
+  if (event == Event::End)
+    selected_ = size - 1;
+
+  if (size && selected_ >= 0 && selected_ < size) {
+    uint32_t index = m_rows[selected_].m_node;
+    const auto& node = m_tree.node(index);
+    if (event == Event::ArrowRight || event == Event::Character('l') || event == Event::Return) {
+      if (!node.m_children.empty()) {
+        m_tree.setExpanded(index, true);
+      }
+    }
+    if (event == Event::ArrowLeft || event == Event::Character('h')) {
+      if (node.m_expanded) {
+        m_tree.setExpanded(index, false);
+      } else if (node.m_parent != TopicTree::kRoot) {
+        // jump to the parent row, it is always above its children
+        for (int row = selected_; row >= 0; --row) {
+          if (m_rows[row].m_node == node.m_parent) {
+            selected_ = row;
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  selected_ = std::max(0, std::min(size - 1, selected_));
+
+  if (selected_ != old_selected || old_layout != m_tree.layoutVersion()) {
+    animation::RequestAnimationFrame();
+    return true;
+  }
+
+  return false;
+}
@@ -0,0 +1,38 @@
+#ifndef UI_TREE_VIEW_HPP
+#define UI_TREE_VIEW_HPP
+
+#include <ftxui/component/component.hpp>
+#include "data/topic_tree.h"
+
+using namespace ftxui;
+
+// Topic paths as an expandable tree. Only expanded nodes are walked to build
+// the rows, and only rows around the selection become elements.
+class TreeView : public ComponentBase {
+ public:
+  explicit TreeView(TopicTree& tree) : m_tree(tree) {}
+  Element Render() override;
+  bool OnEvent(Event) override;
+  bool Focusable() const override {
+    return true;
+  }
+
+  int selected() const { return selected_; }
+  size_t rows() const { return m_rows.size(); }
+
+ private:
+  struct Row {
+    uint32_t m_node;
+    int m_depth;
+  };
+
+  void layout();
+  void append(uint32_t node, int depth);
+
+  TopicTree& m_tree;
+  std::vector<Row> m_rows;
+  uint64_t m_layout_version{~uint64_t(0)};
+  int selected_ = 0;
+};
+
+#endif /* end of include guard: UI_TREE_VIEW_HPP */
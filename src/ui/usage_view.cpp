@@ -0,0 +1,153 @@
+#include "ui/usage_view.hpp"
+
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/component/event.hpp>
+
+#include "data/parallel.h"
+#include "ui/format.hpp"
+
+namespace {
+constexpr int kRenderWindow = 200;
+// sizes keep changing with subscription updates, the listing is reordered at
+// most this often so rows don't jump around on every frame
+constexpr auto kReorderPeriod = std::chrono::seconds(1);
+}  // namespace
+
+void UsageView::order() {
+  auto now = std::chrono::steady_clock::now();
+  if (m_generation != m_tree.generation()) {
+    m_generation = m_tree.generation();
+    m_dir = TopicTree::kRoot;
+    selected_ = 0;
+  } else if (m_rows.size() == m_tree.node(m_dir).m_children.size() && now - m_ordered_at < kReorderPeriod) {
+    return;
+  }
+
+  uint32_t selected_node = selected_ < m_rows.size() ? m_rows[selected_] : TopicTree::kRoot;
+  m_rows = m_tree.node(m_dir).m_children;
+  parallelSort(m_rows.begin(), m_rows.end(), [this](uint32_t a, uint32_t b) {
+    const auto& x = m_tree.node(a);
+    const auto& y = m_tree.node(b);
+    return x.m_bytes != y.m_bytes ? x.m_bytes > y.m_bytes : x.m_name < y.m_name;
+  });
+  m_ordered_at = now;
+
+  selected_ = std::min<int>(selected_, std::max<int>(0, m_rows.size() - 1));
+  for (size_t row = 0; row < m_rows.size(); ++row) {
+    if (m_rows[row] == selected_node) {
+      selected_ = row;
+      break;
+    }
+  }
+}
+
+void UsageView::enter(uint32_t dir, uint32_t select) {
+  m_dir = dir;
+  m_rows.clear();
+  selected_ = 0;
+  order();
+  for (size_t row = 0; row < m_rows.size(); ++row) {
+    if (m_rows[row] == select) {
+      selected_ = row;
+      break;
+    }
+  }
+}
+
+Element UsageView::Render() {
+  order();
+
+  const auto& dir = m_tree.node(m_dir);
+  int first = std::max(0, selected_ - kRenderWindow);
+  int last = std::min<int>(m_rows.size(), selected_ + kRenderWindow);
+
+  Elements list;
+  for (int row = first; row < last; ++row) {
+    const auto& node = m_tree.node(m_rows[row]);
+    float share = dir.m_bytes ? float(node.m_bytes) / float(dir.m_bytes) : 0.0f;
+    char percent[16];
+    snprintf(percent, sizeof(percent), "%5.1f%%", share * 100.0f);
+
+    Decorator line_decorator = node.m_children.empty() ? nothing : bold;
+    if (row == selected_) {
+      line_decorator = line_decorator | focus;
+      if (Focused())
+        line_decorator = line_decorator | inverted;
+    }
+
+    list.push_back(hbox({
+        text(formatBytes(node.m_bytes)) | size(WIDTH, EQUAL, 11),
+        text(" ["),
+        gauge(share) | size(WIDTH, EQUAL, 12),
+        text("] "),
+        text(percent) | size(WIDTH, EQUAL, 7),
+        separator(),
+        text(std::to_string(node.m_topics)) | size(WIDTH, EQUAL, 10),
+        separator(),
+        text(std::string(node.m_name) + (node.m_children.empty() ? "" : "/")) | flex,
+    }) | line_decorator);
+  }
+
+  if (list.empty())
+    list.push_back(text("(empty)"));
+
+  std::string title = "/" + m_tree.path(m_dir) + "  " + formatBytes(dir.m_bytes) + " in " +
+                      std::to_string(dir.m_topics) + " topics";
+  return window(text(title), vbox({
+                                 hbox({
+                                     text("Bytes") | size(WIDTH, EQUAL, 11),
+                                     text("  Share") | size(WIDTH, EQUAL, 23),
+                                     separator(),
+                                     text("Topics") | size(WIDTH, EQUAL, 10),
+                                     separator(),
+                                     text("Branch") | flex,
+                                 }),
+                                 separator(),
+                                 vbox(list) | yframe,
+                             }));
+}
+
+bool UsageView::OnEvent(Event event) {
+  if (!Focused())
+    return false;
+
+  order();
+  int size = m_rows.size();
+  int old_selected = selected_;
+  uint32_t old_dir = m_dir;
+
+  if (event == Event::ArrowUp || event == Event::Character('k'))
+    selected_--;
+  if (event == Event::ArrowDown || event == Event::Character('j'))
+    selected_++;
+  if (event == Event::PageDown)
+    selected_ += 10;
+  if (event == Event::PageUp)
+    selected_ -= 10;
+  if (event == Event::Home)
+    selected_ = 0;
+  if (event == Event::End)
+    selected_ = size - 1;
+
+  if (event == Event::ArrowRight || event == Event::Character('l') || event == Event::Return) {
+    if (selected_ >= 0 && selected_ < size && !m_tree.node(m_rows[selected_]).m_children.empty()) {
+      enter(m_rows[selected_], TopicTree::kRoot);
+      return true;
+    }
+  }
+  if (event == Event::ArrowLeft || event == Event::Character('h') || event == Event::Backspace) {
+    if (m_dir != TopicTree::kRoot) {
+      enter(m_tree.node(m_dir).m_parent, m_dir);
+      return true;
+    }
+  }
+
+  selected_ = std::max(0, std::min(size - 1, selected_));
+
+  if (selected_ != old_selected || m_dir != old_dir) {
+    animation::RequestAnimationFrame();
+    return true;
+  }
+
+  return false;
+}
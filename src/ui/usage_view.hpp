@@ -0,0 +1,36 @@
+#ifndef UI_USAGE_VIEW_HPP
+#define UI_USAGE_VIEW_HPP
+
+#include <chrono>
+#include <ftxui/component/component.hpp>
+#include "data/topic_tree.h"
+
+using namespace ftxui;
+
+// ncdu like listing of one branch of the topic tree at a time, children
+// ordered by the payload bytes they hold.
+class UsageView : public ComponentBase {
+ public:
+  explicit UsageView(TopicTree& tree) : m_tree(tree) {}
+  Element Render() override;
+  bool OnEvent(Event) override;
+  bool Focusable() const override {
+    return true;
+  }
+
+  int selected() const { return selected_; }
+  size_t rows() const { return m_rows.size(); }
+
+ private:
+  void order();
+  void enter(uint32_t dir, uint32_t select);
+
+  TopicTree& m_tree;
+  uint32_t m_dir{TopicTree::kRoot};
+  std::vector<uint32_t> m_rows;
+  uint64_t m_generation{~uint64_t(0)};
+  std::chrono::steady_clock::time_point m_ordered_at;
+  int selected_ = 0;
+};
+
+#endif /* end of include guard: UI_USAGE_VIEW_HPP */